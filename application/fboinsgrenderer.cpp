@@ -5,12 +5,11 @@
 #include <QOpenGLFunctions>
 
 #include "gmlibwrapper.h"
+#include "tiledrendertarget.h"
 #include "window.h"
 
-#include <scene/render/gmrendertarget.h>
 
-
-class QQuickFboInlineRenderTarget : public GMlib::RenderTarget {
+class QQuickFboInlineRenderTarget : public TiledRenderTarget {
 public:
   QQuickFboInlineRenderTarget() { _gl.initializeOpenGLFunctions(); }
   GLint _fbo;
@@ -19,8 +18,22 @@ private:
   mutable QOpenGLFunctions _gl;
 
   void doPrepare()  const override {}
-  void doBind()   const override { _gl.glBindFramebuffer(GL_FRAMEBUFFER,_fbo); }
-  void doUnbind() const override { _gl.glBindFramebuffer(GL_FRAMEBUFFER,0x0); }
+  void doBind()   const override {
+
+    _gl.glBindFramebuffer(GL_FRAMEBUFFER,_fbo);
+    if(!_tile.isValid()) return;
+
+    // Restrict output (and clears) to this view's tile of the shared FBO
+    const auto vp = glTile();
+    _gl.glViewport(vp.x(),vp.y(),vp.width(),vp.height());
+    _gl.glScissor(vp.x(),vp.y(),vp.width(),vp.height());
+    _gl.glEnable(GL_SCISSOR_TEST);
+  }
+  void doUnbind() const override {
+
+    if(_tile.isValid()) _gl.glDisable(GL_SCISSOR_TEST);
+    _gl.glBindFramebuffer(GL_FRAMEBUFFER,0x0);
+  }
   void doResize()  override {}
 };
 
@@ -31,18 +44,43 @@ public:
 
   void render() override {
 
-    if(!_rcpair_name.length()) return;
+    if(!_gmlib) return;
+    if(!_multiview && !_gmlib->isValidRCHandle(_rcpair)) return;
 
     // Pick up the FBO set by the QQuickFrameBufferObject upon the render() call
     _gl.glGetIntegerv(GL_FRAMEBUFFER_BINDING,&_rt._fbo);
+    _rt.setFramebufferSize(_size);
+
+    if(_multiview) {
 
-    // Prepare render and camera
-    auto &gmlib = GMlibWrapper::instance();
-    gmlib.render(_rcpair_name,QRect(QPoint(0,0),QSize(_size)),_rt);
+      // One FBO (one MSAA resolve, one scene graph texture) for all views;
+      // lay out the tiles and clear the atlas once
+      _tiles.resize(_views.size());
+      for( size_t i = 0; i < _views.size(); ++i )
+        _tiles[i] = TiledRenderTarget::gridTile(int(i),int(_views.size()),_size);
+
+      _gl.glClearColor(0.0f,0.0f,0.0f,1.0f);
+      _gl.glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+      _gmlib->renderViews(_views,_tiles,_rt);
+    }
+    else {
+
+      // Prepare render and camera
+      _gmlib->render(_rcpair,QRect(QPoint(0,0),QSize(_size)),_rt);
+    }
+
+    // Screenshots and recording; read back asynchronously. The view name is only built
+    // for a frame that is captured
+    if( _gmlib->isCapturing() )
+      _gmlib->captureFrame(framebufferObject(), _multiview ? QStringLiteral("views") : _gmlib->rcPair(_rcpair).name,
+                           _mirror);
+    else
+      _gmlib->pollCaptures();
 
     // Restore to QML's GLState;
     // we do not know what GMlib has done
-    _item->window()->resetOpenGLState();
+    _window->resetOpenGLState();
 
     // Not necessary, but for clarity let's restore the full GL state as we entered the render() method
     _gl.glBindFramebuffer(GL_FRAMEBUFFER,_rt._fbo);
@@ -61,18 +99,40 @@ public:
     return new QOpenGLFramebufferObject(size, format);
   }
 
+  // Called on the render thread while the GUI thread is blocked; everything render()
+  // needs from the item is copied here, render() never touches the item.
   void synchronize(QQuickFramebufferObject *item) override {
 
-    _item = static_cast<FboInSGRenderer*>(item);
-    _rcpair_name = _item->rcPairName();
+    _item   = static_cast<FboInSGRenderer*>(item);
+    _window = static_cast<Window*>(_item->window());
+    _gmlib  = _item->gmlib();
+
+    // The name -> handle lookup only happens here, and only when the item's view changes
+    _rcpair = _item->rcPairHandle();
+    if(_gmlib && !_gmlib->isValidRCHandle(_rcpair))
+      _rcpair = _item->resolveRcPairHandle();
+
+    // Multi-view: every render/camera pair of the wrapper, in handle order
+    _multiview = _item->isMultiView();
+    _mirror    = _item->mirrorVertically();
+    _views.clear();
+    if(_gmlib && _multiview)
+      for( RCPairHandle h = 0; h < _gmlib->rcPairCount(); ++h )
+        _views.push_back(h);
   }
 
   QOpenGLFunctions            _gl;
-  FboInSGRenderer*            _item;
-  Window*                     _window;
+  FboInSGRenderer*            _item {nullptr};
+  GMlibWrapper*               _gmlib {nullptr};
+  Window*                     _window {nullptr};
   QSize                       _size;
   QQuickFboInlineRenderTarget _rt;
-  QString                     _rcpair_name;
+  RCPairHandle                _rcpair {INVALID_RCPAIR_HANDLE};
+
+  bool                        _multiview {false};
+  bool                        _mirror {false};        // The FBO is shown mirrored; its rows are top down
+  std::vector<RCPairHandle>   _views;
+  std::vector<QRect>          _tiles;
 };
 
 
@@ -89,15 +149,79 @@ FboInSGRenderer::FboInSGRenderer() {
            this, &FboInSGRenderer::onWindowChanged );
 }
 
+GMlibWrapper*
+FboInSGRenderer::gmlib() const { return _gmlib; }
+
+void
+FboInSGRenderer::setGmlib(GMlibWrapper* gmlib) {
+  _gmlib = gmlib;
+  resolveRcPairHandle();
+  update();
+}
+
 const QString&
 FboInSGRenderer::rcPairName() const { return _name; }
 
 void
 FboInSGRenderer::setRcPairName(const QString& name) {
   _name = name;
+  resolveRcPairHandle();
+  update();
+}
+
+RCPairHandle
+FboInSGRenderer::rcPairHandle() const { return _handle; }
+
+RCPairHandle
+FboInSGRenderer::resolveRcPairHandle() {
+
+  _handle = _gmlib ? _gmlib->rcHandle(_name) : INVALID_RCPAIR_HANDLE;
+  return _handle;
+}
+
+bool
+FboInSGRenderer::isMultiView() const { return _multiview; }
+
+void
+FboInSGRenderer::setMultiView(bool state) {
+  _multiview = state;
+  _active_view = INVALID_RCPAIR_HANDLE;
   update();
 }
 
+RCPairHandle
+FboInSGRenderer::viewAt(const QPointF& pos, QRect& tile) const {
+
+  if(!_gmlib) return INVALID_RCPAIR_HANDLE;
+
+  const auto no_views = _gmlib->rcPairCount();
+  const auto size     = QSize(int(width()),int(height()));
+  for( RCPairHandle h = 0; h < no_views; ++h ) {
+
+    tile = TiledRenderTarget::gridTile(h,no_views,size);
+    if(tile.contains(pos.toPoint())) return h;
+  }
+
+  return INVALID_RCPAIR_HANDLE;
+}
+
+RCPairHandle
+FboInSGRenderer::inputView() const { return _multiview ? _active_view : _handle; }
+
+QMouseEvent
+FboInSGRenderer::toViewEvent(QMouseEvent* event) {
+
+  // Pick the view under the cursor on a press, or on a move with no button held; a drag,
+  // up to and including its last release, stays with the view it was pressed in
+  if(event->type() == QEvent::MouseButtonPress ||
+     (event->type() == QEvent::MouseMove && event->buttons() == Qt::NoButton))
+    _active_view = viewAt(event->localPos(),_active_tile);
+
+  return QMouseEvent( event->type(), event->localPos() - QPointF(_active_tile.topLeft()),
+                      event->windowPos(), event->screenPos(),
+                      event->button(), event->buttons(), event->modifiers() );
+}
+
 QQuickFramebufferObject::Renderer* FboInSGRenderer::createRenderer() const { return new GMlibInFboRenderer(); }
 
 void FboInSGRenderer::onWindowChanged(QQuickWindow* w) {
@@ -128,10 +252,42 @@ void FboInSGRenderer::onWindowChanged(QQuickWindow* w) {
            window, &Window::signWheelEventOccurred );
 }
 
-void FboInSGRenderer::keyPressEvent(QKeyEvent* event)           { emit signKeyPressed(_name,event); }
-void FboInSGRenderer::keyReleaseEvent(QKeyEvent* event)         { emit signKeyReleased(_name,event); }
-void FboInSGRenderer::mousePressEvent(QMouseEvent* event)       { emit signMousePressed(_name,event); }
-void FboInSGRenderer::mouseReleaseEvent(QMouseEvent* event)     { emit signMouseReleased(_name,event); }
-void FboInSGRenderer::mouseDoubleClickEvent(QMouseEvent* event) { emit signMouseDoubleClicked(_name,event); }
-void FboInSGRenderer::mouseMoveEvent(QMouseEvent* event)        { emit signMouseMoved(_name,event); }
-void FboInSGRenderer::wheelEvent(QWheelEvent* event)            { emit signWheelEventOccurred(_name,event); }
+void FboInSGRenderer::keyPressEvent(QKeyEvent* event)           { emit signKeyPressed(inputView(),event); }
+void FboInSGRenderer::keyReleaseEvent(QKeyEvent* event)         { emit signKeyReleased(inputView(),event); }
+void FboInSGRenderer::wheelEvent(QWheelEvent* event)            { emit signWheelEventOccurred(inputView(),event); }
+
+void FboInSGRenderer::mousePressEvent(QMouseEvent* event) {
+
+  if(!_multiview) { emit signMousePressed(_handle,event); return; }
+
+  auto view_event = toViewEvent(event);
+  emit signMousePressed(_active_view,&view_event);
+}
+
+void FboInSGRenderer::mouseReleaseEvent(QMouseEvent* event) {
+
+  if(!_multiview) { emit signMouseReleased(_handle,event); return; }
+
+  auto view_event = toViewEvent(event);
+  emit signMouseReleased(_active_view,&view_event);
+
+  // Last button up; release the capture, keys and wheel go to the view under the cursor
+  if(event->buttons() == Qt::NoButton)
+    _active_view = viewAt(event->localPos(),_active_tile);
+}
+
+void FboInSGRenderer::mouseDoubleClickEvent(QMouseEvent* event) {
+
+  if(!_multiview) { emit signMouseDoubleClicked(_handle,event); return; }
+
+  auto view_event = toViewEvent(event);
+  emit signMouseDoubleClicked(_active_view,&view_event);
+}
+
+void FboInSGRenderer::mouseMoveEvent(QMouseEvent* event) {
+
+  if(!_multiview) { emit signMouseMoved(_handle,event); return; }
+
+  auto view_event = toViewEvent(event);
+  emit signMouseMoved(_active_view,&view_event);
+}
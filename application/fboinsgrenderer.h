@@ -1,17 +1,32 @@
 #ifndef FBOINSGRENDERER_H
 #define FBOINSGRENDERER_H
 
+#include "gmlibwrapper.h"
+
 #include <QtQuick/QQuickFramebufferObject>
+#include <QMouseEvent>
 
 class FboInSGRenderer : public QQuickFramebufferObject {
   Q_OBJECT
+  Q_PROPERTY(GMlibWrapper* gmlib READ gmlib WRITE setGmlib)
   Q_PROPERTY(QString rcpair_name READ rcPairName WRITE setRcPairName)
+  Q_PROPERTY(bool multiview READ isMultiView WRITE setMultiView)
 public:
   FboInSGRenderer();
 
+  GMlibWrapper*     gmlib() const;
+  void              setGmlib( GMlibWrapper* gmlib );
+
   const QString&    rcPairName() const;
   void              setRcPairName( const QString& name );
 
+  RCPairHandle      rcPairHandle() const;
+  RCPairHandle      resolveRcPairHandle();
+
+  // Multi-view mode; all of the wrapper's render/camera pairs are tiled into this item's FBO
+  bool              isMultiView() const;
+  void              setMultiView( bool state );
+
   Renderer*         createRenderer() const override;
 
 private slots:
@@ -19,13 +34,13 @@ private slots:
 
 
 signals:
-  void              signKeyPressed( const QString& name, QKeyEvent* event );
-  void              signKeyReleased( const QString& name, QKeyEvent* event );
-  void              signMouseDoubleClicked( const QString& name, QMouseEvent* event );
-  void              signMouseMoved( const QString& name, QMouseEvent* event );
-  void              signMousePressed( const QString& name, QMouseEvent* event );
-  void              signMouseReleased( const QString& name, QMouseEvent* event );
-  void              signWheelEventOccurred( const QString& name, QWheelEvent* event);
+  void              signKeyPressed( int view, QKeyEvent* event );
+  void              signKeyReleased( int view, QKeyEvent* event );
+  void              signMouseDoubleClicked( int view, QMouseEvent* event );
+  void              signMouseMoved( int view, QMouseEvent* event );
+  void              signMousePressed( int view, QMouseEvent* event );
+  void              signMouseReleased( int view, QMouseEvent* event );
+  void              signWheelEventOccurred( int view, QWheelEvent* event);
 
 private:
   void              keyPressEvent(QKeyEvent *event) override;
@@ -36,7 +51,17 @@ private:
   void              mouseMoveEvent(QMouseEvent *event) override;
   void              wheelEvent(QWheelEvent *event) override;
 
+  RCPairHandle      inputView() const;
+  QMouseEvent       toViewEvent( QMouseEvent* event );
+  RCPairHandle      viewAt( const QPointF& pos, QRect& tile ) const;
+
+  GMlibWrapper*     _gmlib {nullptr};
   QString           _name {};
+  RCPairHandle      _handle {INVALID_RCPAIR_HANDLE};
+
+  bool              _multiview {false};
+  RCPairHandle      _active_view {INVALID_RCPAIR_HANDLE};   // Multi-view: view receiving input
+  QRect             _active_tile {};
 };
 
 #endif
@@ -0,0 +1,121 @@
+#include "framecapture.h"
+
+// local
+#include "imageencoder.h"
+
+// qt
+#include <QImage>
+#include <QOpenGLFramebufferObject>
+
+// stl
+#include <algorithm>
+#include <cstring>
+
+
+
+
+FrameCapture::FrameCapture( ImageEncoder& encoder, int depth )
+  : _encoder(encoder), _slots(size_t(std::max(depth,1))) {
+
+  _gl.initializeOpenGLFunctions();
+  for( auto& slot : _slots ) _gl.glGenBuffers(1,&slot.pbo);
+}
+
+FrameCapture::~FrameCapture() {
+
+  flush();
+  for( auto& slot : _slots ) _gl.glDeleteBuffers(1,&slot.pbo);
+}
+
+void FrameCapture::capture( QOpenGLFramebufferObject* fbo, const QString& path, bool droppable ) {
+
+  if( !fbo ) return;
+
+  Slot& slot = _slots[_next];
+  _next = (_next + 1) % _slots.size();
+  if( slot.fence ) retire(slot);
+
+  GLint draw_fbo = 0, read_fbo = 0;
+  _gl.glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING,&draw_fbo);
+  _gl.glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING,&read_fbo);
+
+  // glReadPixels can not read a multisampled framebuffer
+  QOpenGLFramebufferObject* source = fbo;
+  if( fbo->format().samples() > 0 ) {
+    if( !_resolve_fbo || _resolve_fbo->size() != fbo->size() )
+      _resolve_fbo.reset( new QOpenGLFramebufferObject(fbo->size()) );
+    QOpenGLFramebufferObject::blitFramebuffer(_resolve_fbo.get(), fbo);
+    source = _resolve_fbo.get();
+  }
+
+  slot.size = source->size();
+  slot.path = path;
+  slot.droppable = droppable;
+  slot.top_down = _top_down;
+  const GLsizeiptr bytes = GLsizeiptr(slot.size.width()) * slot.size.height() * 4;
+
+  _gl.glBindFramebuffer(GL_READ_FRAMEBUFFER,source->handle());
+  _gl.glReadBuffer(GL_COLOR_ATTACHMENT0);
+  _gl.glPixelStorei(GL_PACK_ALIGNMENT,4);
+  _gl.glBindBuffer(GL_PIXEL_PACK_BUFFER,slot.pbo);
+  if( slot.capacity != bytes ) {
+    _gl.glBufferData(GL_PIXEL_PACK_BUFFER,bytes,nullptr,GL_STREAM_READ);
+    slot.capacity = bytes;
+  }
+  _gl.glReadPixels(0,0,slot.size.width(),slot.size.height(),GL_RGBA,GL_UNSIGNED_BYTE,nullptr);
+  _gl.glBindBuffer(GL_PIXEL_PACK_BUFFER,0);
+  slot.fence = _gl.glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE,0);
+
+  _gl.glBindFramebuffer(GL_DRAW_FRAMEBUFFER,GLuint(draw_fbo));
+  _gl.glBindFramebuffer(GL_READ_FRAMEBUFFER,GLuint(read_fbo));
+}
+
+void FrameCapture::poll() {
+
+  // Oldest first
+  for( size_t i = 0; i < _slots.size(); ++i ) {
+    Slot& slot = _slots[(_next + i) % _slots.size()];
+    if( slot.fence && isReady(slot) ) retire(slot);
+  }
+}
+
+void FrameCapture::flush() {
+
+  for( size_t i = 0; i < _slots.size(); ++i ) {
+    Slot& slot = _slots[(_next + i) % _slots.size()];
+    if( slot.fence ) retire(slot);
+  }
+}
+
+bool FrameCapture::isReady( const Slot& slot ) {
+
+  const GLenum status = _gl.glClientWaitSync(slot.fence,0,0);
+  return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+}
+
+void FrameCapture::retire( Slot& slot ) {
+
+  // Waits only if the readback is not done yet (a capture into a busy slot, or flush)
+  while( _gl.glClientWaitSync(slot.fence,GL_SYNC_FLUSH_COMMANDS_BIT,1000000) == GL_TIMEOUT_EXPIRED ) {}
+  _gl.glDeleteSync(slot.fence);
+  slot.fence = nullptr;
+
+  QImage image(slot.size,QImage::Format_RGBA8888);
+
+  _gl.glBindBuffer(GL_PIXEL_PACK_BUFFER,slot.pbo);
+  const auto* pixels = static_cast<const uchar*>(_gl.glMapBufferRange(GL_PIXEL_PACK_BUFFER,0,slot.capacity,GL_MAP_READ_BIT));
+  if( pixels ) {
+
+    // glReadPixels returns the bottom row first; flip, unless the rows are top down already
+    const int row_bytes = slot.size.width() * 4;
+    for( int y = 0; y < slot.size.height(); ++y )
+      std::memcpy(image.scanLine(slot.top_down ? y : slot.size.height() - 1 - y),
+                  pixels + size_t(y) * size_t(row_bytes), size_t(row_bytes));
+    _gl.glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  }
+  _gl.glBindBuffer(GL_PIXEL_PACK_BUFFER,0);
+  if( !pixels ) return;
+
+  if( !slot.droppable )                            _encoder.encode(std::move(image),slot.path);
+  else if( !_encoder.tryEncode(std::move(image),slot.path) ) ++_dropped;
+}
@@ -0,0 +1,82 @@
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+
+// qt
+#include <QOpenGLExtraFunctions>
+#include <QSize>
+#include <QString>
+
+// stl
+#include <memory>
+#include <vector>
+
+class ImageEncoder;
+class QOpenGLFramebufferObject;
+
+
+
+
+/*!
+ *  Asynchronous framebuffer readback; screenshots, recording and frame dumps.
+ *
+ *  capture() reads the framebuffer into the next pixel buffer object of a ring and fences
+ *  it; glReadPixels into a PBO returns without waiting for the GPU. poll(), once per frame,
+ *  maps the buffers whose fence has signaled (normally a frame or two later), copies the
+ *  rows into an image and hands it to the ImageEncoder thread.
+ *
+ *  - Rows are flipped to top down unless the framebuffer already holds them top down
+ *    (setTopDown); GMlib's renderings are, which is why FboInSGRenderer shows its FBO
+ *    mirrored vertically.
+ *
+ *  - Multisampled framebuffers are resolved into an FBO of the capture's own first.
+ *  - Capturing into a slot that is still pending waits for it; a ring of depth frames
+ *    in flight, three by default, keeps this from happening at one capture per frame.
+ *  - Droppable captures (recording) the encoder has no room for are dropped (and counted)
+ *    instead of stalling the GL thread; other captures (screenshots, frame dumps) wait.
+ *
+ *  GL thread only, with the context current, also on destruction (flushes).
+ */
+class FrameCapture {
+public:
+  explicit FrameCapture( ImageEncoder& encoder, int depth = 3 );
+  ~FrameCapture();
+
+  FrameCapture( const FrameCapture& ) = delete;
+  FrameCapture& operator=( const FrameCapture& ) = delete;
+
+  int           dropped() const { return _dropped; }
+
+  // The rows of the next captured framebuffers are stored top down (no flip)
+  void          setTopDown( bool state ) { _top_down = state; }
+  bool          isTopDown() const { return _top_down; }
+
+  void          capture( QOpenGLFramebufferObject* fbo, const QString& path, bool droppable = false );
+  void          poll();
+  void          flush();
+
+private:
+  struct Slot {
+    GLuint      pbo      {0};
+    GLsizeiptr  capacity {0};
+    GLsync      fence    {nullptr};
+    QSize       size;
+    QString     path;
+    bool        droppable {false};
+    bool        top_down {false};
+  };
+
+  ImageEncoder&                               _encoder;
+  QOpenGLExtraFunctions                       _gl;
+  std::vector<Slot>                           _slots;
+  size_t                                      _next {0};        // Slot of the next capture
+  std::unique_ptr<QOpenGLFramebufferObject>   _resolve_fbo;
+  int                                         _dropped {0};
+  bool                                        _top_down {false};
+
+  bool          isReady( const Slot& slot );
+  void          retire( Slot& slot );
+};
+
+
+#endif // FRAMECAPTURE_H
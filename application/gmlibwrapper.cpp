@@ -1,6 +1,10 @@
 #include "gmlibwrapper.h"
 
 #include "../testtorus.h"
+#include "tiledrendertarget.h"
+#include "programbinarycache.h"
+#include "framecapture.h"
+#include "imageencoder.h"
 #include "utils.h"
 
 
@@ -9,12 +13,18 @@
 
 
 // Qt
+#include <QDateTime>
+#include <QDir>
+#include <QOpenGLFramebufferObject>
 #include <QTimerEvent>
 #include <QRectF>
 #include <QMouseEvent>
 #include <QDebug>
 
 // stl
+#include <algorithm>
+#include <cassert>
+#include <cmath>
 #include <stdexcept>
 #include <thread>
 #include <mutex>
@@ -23,37 +33,110 @@
 
 
 
-std::unique_ptr<GMlibWrapper> GMlibWrapper::_instance {nullptr};
+namespace {
+
+  // The GMlib GL backend (shader programs, default textures, ...) is process global;
+  // it is shared by all GMlibWrapper instances and must only be initialized once.
+  std::once_flag gl_manager_init_flag;
+}
 
-GMlibWrapper&
-GMlibWrapper::instance() { return *_instance; }
 
+GMlibWrapper::GMlibWrapper() : QObject(), _timer_id{0}/*, _select_renderer{nullptr}*/ {}
 
-GMlibWrapper::GMlibWrapper() : QObject(), _timer_id{0}/*, _select_renderer{nullptr}*/ {
+GMlibWrapper::~GMlibWrapper() {}
 
-  if(_instance != nullptr) {
+void GMlibWrapper::toggleSimulation() {  _run_request = RunRequest::Toggle; }
 
-    std::cerr << "This version of the GMlibWrapper only supports a single instance of the GMlibWraper..." << std::endl;
-    std::cerr << "Only one of me(0x" << this << ") please!! ^^" << std::endl;
-    assert(!_instance);
-    exit(666);
+void GMlibWrapper::requestScreenshot() {
+
+  const QString dir = captureDirectory();
+  if( !QDir().mkpath(dir) ) {
+    qWarning() << "Cannot create" << dir;
+    return;
   }
+  {
+    std::lock_guard<std::mutex> lk(_capture_mutex);
+    _screenshot_dir = dir;
+  }
+  _screenshot_frame = _frame_no + 1;
+}
 
+void GMlibWrapper::toggleRecording() {
 
-  _instance = std::unique_ptr<GMlibWrapper>(this);
+  if( _recording ) {
+    _recording = false;
+    return;
+  }
+
+  const QString dir = QString("%1/recording_%2").arg(captureDirectory()).arg(int(++_recording_no));
+  if( !QDir().mkpath(dir) ) {
+    qWarning() << "Cannot create" << dir;
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lk(_capture_mutex);
+    _recording_dir = dir;
+  }
+  _recording = true;
 }
 
-GMlibWrapper::~GMlibWrapper() {
+bool GMlibWrapper::isRecording() const { return _recording; }
+
+bool GMlibWrapper::isCapturing() const {
 
-  _instance.release();
+  return _recording || (_screenshot_frame != 0 && _screenshot_frame == _frame_no);
 }
 
-void GMlibWrapper::toggleSimulation() {  _scene->toggleRun(); }
+QString GMlibWrapper::captureDirectory() const { return QDir::currentPath() + "/captures"; }
 
+void GMlibWrapper::captureFrame( QOpenGLFramebufferObject* fbo, const QString& view, bool top_down ) {
+
+  // Every view rendered in the requested frame is part of the screenshot
+  const bool screenshot = _screenshot_frame != 0 && _screenshot_frame == _frame_no;
+  const bool recording  = _recording;
+  if( !screenshot && !recording ) {
+    pollCaptures();
+    return;
+  }
+
+  if( !_capture ) {
+    _encoder.reset( new ImageEncoder );
+    _capture.reset( new FrameCapture(*_encoder, 6) );
+  }
+  _capture->setTopDown(top_down);
 
-void GMlibWrapper::render( const QString& name, const QRect& viewport_in, GMlib::RenderTarget& target ) {
+  QString screenshot_dir, recording_dir;
+  {
+    std::lock_guard<std::mutex> lk(_capture_mutex);
+    screenshot_dir = _screenshot_dir;
+    recording_dir  = _recording_dir;
+  }
+
+  // Screenshots wait for the encoder rather than being dropped
+  if( screenshot )
+    _capture->capture( fbo, QString("%1/%2_%3.png").arg( screenshot_dir, view,
+                       QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss-zzz") ) );
+
+  // Raw RGBA frames; PNG encoding would not keep up with the frame rate. Droppable, so
+  // recording never stalls the interactive frame rate
+  if( recording )
+    _capture->capture( fbo, QString("%1/%2_%3_%4x%5.raw").arg( recording_dir, view )
+                       .arg( qulonglong(_frame_no.load()), 6, 10, QChar('0') )
+                       .arg( fbo->width() ).arg( fbo->height() ), true );
+
+  _capture->poll();
+}
 
-  auto&        rc_pair = rcPair(name);
+void GMlibWrapper::pollCaptures() {
+
+  // Readbacks still in flight after the last capture
+  if( _capture ) _capture->poll();
+}
+
+
+void GMlibWrapper::render( RCPairHandle handle, const QRect& viewport_in, GMlib::RenderTarget& target ) {
+
+  auto&        rc_pair = rcPair(handle);
   auto&         camera = rc_pair.camera;
   auto&       renderer = rc_pair.renderer;
   auto&       viewport = rc_pair.viewport;
@@ -72,39 +155,169 @@ void GMlibWrapper::render( const QString& name, const QRect& viewport_in, GMlib:
   renderer->render(target);
 }
 
+void GMlibWrapper::renderViews( const std::vector<RCPairHandle>& handles, const std::vector<QRect>& tiles,
+                                TiledRenderTarget& target ) {
+
+  assert(handles.size() == tiles.size());
+
+  // The scene itself (matrices, bounding spheres, edited objects) is prepared once per
+  // simulation step, and shared by all views. Only the per-view work is repeated here:
+  // each renderer culls against its own camera frustum and draws into its tile.
+  for( size_t i = 0; i < handles.size(); ++i ) {
+
+    if(!isValidRCHandle(handles[i]) || tiles[i].isEmpty()) continue;
+
+    target.setTile(tiles[i]);
+    render( handles[i], QRect(QPoint(0,0),tiles[i].size()), target );
+  }
+
+  target.clearTile();
+}
+
 
 void GMlibWrapper::timerEvent(QTimerEvent* e) {
 
   e->accept();
 
-  _scene->simulate();
+  // The scene is owned by the scene graph's synchronization point; only request a
+  // simulation step here. Under the threaded render loop the render thread may be
+  // drawing the scene at this very moment.
+  _simulation_pending = true;
+  emit signFrameReady();
+}
+
+void GMlibWrapper::synchronizeFrame() {
+
+  // The GUI thread is blocked and the render thread has not yet started drawing;
+  // this is the only place where the scene is mutated while rendering is active.
+  // Everything drawn until the next call is a consistent snapshot of this state.
+  applyRunRequest();
+
+  if( _simulation_pending.exchange(false) ) {
+
+    // Frame callback pacing: the step is the time the last frame was presented for, so
+    // simulated time advances with the displayed frames; otherwise the scene's own clock
+    if( _pacing_mode == PacingMode::FrameCallback ) {
+      _scene->setFixedDt(_frame_step);
+      _scene->enabledFixedDt();
+    }
+    else
+      _scene->disabledFixedDt();
+
+    _scene->simulate();
+    if( _scene->isRunning() )
+      simulateScenario();
+  }
+
   prepare();
+  ++_frame_no;
 }
 
+void GMlibWrapper::applyRunRequest() {
+
+  switch( _run_request.exchange(RunRequest::None) ) {
+    case RunRequest::Start:   if( !_scene->isRunning() ) _scene->start(); break;
+    case RunRequest::Stop:    if(  _scene->isRunning() ) _scene->stop();  break;
+    case RunRequest::Toggle:  _scene->toggleRun();                        break;
+    case RunRequest::None:
+    default:                                                              break;
+  }
+}
+
+
+void GMlibWrapper::onAfterAnimating() {
+
+  if( !_started || _pacing_mode != PacingMode::FrameCallback )
+    return;
+
+  // Exactly one simulation step for the frame about to be synchronized
+  _simulation_pending = true;
+}
+
+void GMlibWrapper::onFrameSwapped() {
+
+  if( !_frame_clock.isValid() ) {
+    _frame_clock.start();
+    return;
+  }
+
+  const auto dt       = double(_frame_clock.nsecsElapsed()) * 1e-9;
+  const auto interval = _frame_interval.load();
+  _frame_clock.restart();
+
+  // Hitches (dropped vsyncs, stalls) do not contribute to the refresh interval estimate;
+  // the estimate converges within a second to the display rate; 60, 120, 144 Hz, ...
+  if( dt > 1.5 * interval )
+    ++_dropped_frames;
+  if( dt < 3.0 * interval )
+    _frame_interval = interval + 0.1 * (dt - interval);
+
+  // The next simulation step; the presented frame in whole refresh intervals (one, or more
+  // after a dropped frame), at most four so a stall does not turn into a jump
+  const auto refresh = _frame_interval.load();
+  _frame_step = refresh * std::min(std::max(std::round(dt / refresh), 1.0), 4.0);
+
+  // Keep the frame callbacks coming
+  if( _started && _pacing_mode == PacingMode::FrameCallback )
+    emit signFrameReady();
+}
+
+GMlibWrapper::PacingMode GMlibWrapper::pacingMode() const { return _pacing_mode; }
+
+void GMlibWrapper::setPacingMode(PacingMode mode) {
+
+  if( mode == _pacing_mode )
+    return;
+
+  const bool started = _started;
+  if( started ) stop();
+  _pacing_mode = mode;
+  if( started ) start();
+}
+
+double GMlibWrapper::frameInterval() const { return _frame_interval; }
+
+double GMlibWrapper::refreshRate() const { return 1.0 / _frame_interval; }
+
+unsigned long GMlibWrapper::droppedFrames() const { return _dropped_frames; }
+
 
 void GMlibWrapper::start() {
 
-  if( _timer_id || _scene->isRunning() )
+  if( _started )
     return;
 
-  _timer_id = startTimer(16, Qt::PreciseTimer);
-  _scene->start();
+  _started = true;
+  if( _pacing_mode == PacingMode::Timer )
+    _timer_id = startTimer(16, Qt::PreciseTimer);
+  _run_request = RunRequest::Start;
+
+  emit signFrameReady();
 }
 
 void GMlibWrapper::stop() {
 
-  if( !_timer_id || !_scene->isRunning() )
+  if( !_started )
     return;
 
-  _scene->stop();
-  killTimer(_timer_id);
-  _timer_id = 0;
+  _started = false;
+  if( _timer_id ) {
+    killTimer(_timer_id);
+    _timer_id = 0;
+  }
+  _run_request = RunRequest::Stop;
 }
 
 void GMlibWrapper::initialize() {
 
-  // Setup and initialized GMlib GL backend
-  GMlib::GL::OpenGLManager::init();
+  // Setup and initialized GMlib GL backend (once per process); shader programs are
+  // loaded from the program binary cache where possible
+  std::call_once( gl_manager_init_flag, [](){
+    ProgramBinaryCache::install();
+    GMlib::GL::OpenGLManager::init();
+    qDebug() << "Shader programs; cached:" << ProgramBinaryCache::hits()
+             << "compiled:" << ProgramBinaryCache::misses();
+  } );
 
   // Setup and init the GMlib GMWindow
   _scene = std::make_shared<GMlib::Scene>();
@@ -116,18 +329,27 @@ void GMlibWrapper::initialize() {
 
 void GMlibWrapper::cleanUp() {
 
+  // Rendering has stopped; apply any pending run state request directly
   stop();
+  applyRunRequest();
+  if( _scene->isRunning() )
+    _scene->stop();
 
   cleanupScenario();
 
+  // Pending captures are written out
+  _capture.reset();
+  _encoder.reset();
+
   _select_renderer.reset();
 
   for( auto& rc_pair : _rc_pairs ) {
 
-    rc_pair.second.renderer->releaseCamera();
-    _scene->removeCamera( rc_pair.second.camera.get() );
+    rc_pair.renderer->releaseCamera();
+    _scene->removeCamera( rc_pair.camera.get() );
   }
   _rc_pairs.clear();
+  _rc_handles.clear();
 
   _scene->clear();
   _scene.reset();
@@ -137,15 +359,11 @@ void GMlibWrapper::cleanUp() {
 }
 
 GMlib::SceneObject*
-GMlibWrapper::findSceneObject(const QString& rc_name, const GMlib::Point<int,2>& pos) {
+GMlibWrapper::findSceneObject(RCPairHandle handle, const GMlib::Point<int,2>& pos) {
 
-
-  if(!_rc_pairs.count(rc_name.toStdString()))
-    throw std::invalid_argument("[][]Render/Camera pair '" + rc_name.toStdString() + "'  does not exist in [" + __FILE__ + " on line " + std::to_string(__LINE__) + "]!");
-
-  auto rc_pair = _rc_pairs.at(rc_name.toStdString());
-  auto cam = rc_pair.camera;
-  auto viewport = rc_pair.viewport;
+  const auto& rc_pair  = rcPair(handle);
+  const auto& cam      = rc_pair.camera;
+  const auto& viewport = rc_pair.viewport;
   GMlib::Vector<int,2> size( viewport.width(), viewport.height() );
 
   GMlib::SceneObject* sel_obj = nullptr;
@@ -173,29 +391,72 @@ GMlibWrapper::findSceneObject(const QString& rc_name, const GMlib::Point<int,2>&
   return sel_obj;
 }
 
+RCPairHandle
+GMlibWrapper::rcHandle(const QString& name) const {
+
+  auto itr = _rc_handles.find(name.toStdString());
+  return itr != _rc_handles.end() ? itr->second : INVALID_RCPAIR_HANDLE;
+}
+
+bool
+GMlibWrapper::isValidRCHandle(RCPairHandle handle) const {
+
+  return handle >= 0 && handle < int(_rc_pairs.size());
+}
+
+int
+GMlibWrapper::rcPairCount() const {
+
+  return int(_rc_pairs.size());
+}
+
+RenderCamPair&
+GMlibWrapper::rcPair(RCPairHandle handle) {
+
+  if(!isValidRCHandle(handle)) throw std::invalid_argument("[][]Render/Camera pair handle " + std::to_string(handle) + " does not exist!");
+  return _rc_pairs[size_t(handle)];
+}
+
+const RenderCamPair&
+GMlibWrapper::rcPair(RCPairHandle handle) const {
+
+  if(!isValidRCHandle(handle)) throw std::invalid_argument("[][]Render/Camera pair handle " + std::to_string(handle) + " does not exist!");
+  return _rc_pairs[size_t(handle)];
+}
+
 RenderCamPair&
 GMlibWrapper::rcPair(const QString& name) {
 
-  if(!_rc_pairs.count(name.toStdString())) throw std::invalid_argument("[][]Render/Camera pair '" + name.toStdString() + "'  does not exist!");
-  return _rc_pairs.at(name.toStdString());
+  auto handle = rcHandle(name);
+  if(!isValidRCHandle(handle)) throw std::invalid_argument("[][]Render/Camera pair '" + name.toStdString() + "'  does not exist!");
+  return _rc_pairs[size_t(handle)];
 }
 
 const RenderCamPair&
 GMlibWrapper::rcPair(const QString& name) const {
 
-  if(!_rc_pairs.count(name.toStdString())) throw std::invalid_argument("[][]Render/Camera pair '" + name.toStdString() + "'  does not exist!");
-  return _rc_pairs.at(name.toStdString());
+  auto handle = rcHandle(name);
+  if(!isValidRCHandle(handle)) throw std::invalid_argument("[][]Render/Camera pair '" + name.toStdString() + "'  does not exist!");
+  return _rc_pairs[size_t(handle)];
 }
 
 RenderCamPair& GMlibWrapper::createRCPair(const QString& name) {
 
   auto rc_pair = RenderCamPair {};
 
+  rc_pair.name     = name;
   rc_pair.renderer = std::make_shared<GMlib::DefaultRenderer>();
   rc_pair.camera   = std::make_shared<GMlib::Camera>();
   rc_pair.renderer->setCamera(rc_pair.camera.get());
 
-  return _rc_pairs[name.toStdString()] = rc_pair;
+  // Re-creating a pair under an existing name replaces it, but keeps its handle
+  auto handle = rcHandle(name);
+  if(isValidRCHandle(handle))
+    return _rc_pairs[size_t(handle)] = rc_pair;
+
+  _rc_handles[name.toStdString()] = RCPairHandle(_rc_pairs.size());
+  _rc_pairs.push_back(rc_pair);
+  return _rc_pairs.back();
 }
 
 void
@@ -203,7 +464,7 @@ GMlibWrapper::updateRCPairNameModel() {
 
   QStringList names;
   for( auto& rc_pair : _rc_pairs )
-    names << QString(rc_pair.first.c_str());
+    names << rc_pair.name;
 
   std::reverse(names.begin(),names.end());
 
@@ -228,4 +489,12 @@ GMlibWrapper::camera(const QString& name) const {
   return rcPair(name).camera;
 }
 
+const std::shared_ptr<GMlib::Camera>&
+GMlibWrapper::camera(RCPairHandle handle) const {
+
+  return rcPair(handle).camera;
+}
+
 void  GMlibWrapper::prepare() {  _scene->prepare(); }
+
+unsigned long GMlibWrapper::frameNumber() const { return _frame_no; }
@@ -3,6 +3,9 @@
 
 class TestTorus;
 class GLContextSurfaceWrapper;
+class TiledRenderTarget;
+class ImageEncoder;
+class FrameCapture;
 
 // gmlib
 #include <core/types/gmpoint.h>
@@ -26,6 +29,7 @@ namespace GMlib {
 #include <QSize>
 #include <QRectF>
 #include <QStringListModel>
+#include <QElapsedTimer>
 class QOpenGLContext;
 class QOpenGLFramebufferObject;
 class QMouseEvent;
@@ -34,17 +38,27 @@ class QWheelEvent;
 
 
 // stl
+#include <atomic>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 
 
 struct RenderCamPair {
   RenderCamPair() {}
+  QString                                     name     {};
   std::shared_ptr<GMlib::DefaultRenderer>     renderer { nullptr };
   std::shared_ptr<GMlib::Camera>              camera   { nullptr };
   QRect                                       viewport { QRect(0,0,200,200) };
 };
 
+// Render/camera pair handle; an index into the GMlibWrapper's dense rc-pair registry.
+// Resolve a name to a handle once (rcHandle) and use the handle on the hot paths.
+using RCPairHandle = int;
+constexpr RCPairHandle INVALID_RCPAIR_HANDLE {-1};
+
 
 
 
@@ -52,46 +66,126 @@ struct RenderCamPair {
 class GMlibWrapper : public QObject {
   Q_OBJECT
 public:
+  // Simulation pacing
+  //  - Timer:          simulation steps are requested by a 16ms timer
+  //  - FrameCallback:  one simulation step per displayed frame; driven by the window's
+  //                    afterAnimating() and frameSwapped() signals (vsync when swap interval is 1),
+  //                    the step being the measured time the previous frame was presented for
+  enum class PacingMode { Timer, FrameCallback };
+
   explicit GMlibWrapper();
   ~GMlibWrapper();
 
   void                                              start();
   void                                              stop();
 
+  PacingMode                                        pacingMode() const;
+  void                                              setPacingMode( PacingMode mode );
+  double                                            frameInterval() const;      // Measured; seconds
+  double                                            refreshRate() const;        // Measured; Hz
+  unsigned long                                     droppedFrames() const;
+
   const std::shared_ptr<GMlib::Scene>&              scene() const;
   const std::shared_ptr<GMlib::Camera>&             camera(const QString& name ) const;
+  const std::shared_ptr<GMlib::Camera>&             camera(RCPairHandle handle ) const;
 
   void                                              initialize();
   void                                              cleanUp();
 
-  GMlib::SceneObject*                               findSceneObject( const QString& rc_name, const GMlib::Point<int,2>& pos );
+  GMlib::SceneObject*                               findSceneObject( RCPairHandle handle, const GMlib::Point<int,2>& pos );
   QStringListModel&                                 rcNameModel();
 
+  RCPairHandle                                      rcHandle(const QString& name) const;
+  bool                                              isValidRCHandle(RCPairHandle handle) const;
+  int                                               rcPairCount() const;
+  RenderCamPair&                                    rcPair(RCPairHandle handle);
+  const RenderCamPair&                              rcPair(RCPairHandle handle) const;
   RenderCamPair&                                    rcPair(const QString& name);
   const RenderCamPair&                              rcPair(const QString& name) const;
-  RenderCamPair&                                    createRCPair( const QString& name );
+  RenderCamPair&                                    createRCPair( const QString& name );   // Stays valid as pairs are added
   void                                              updateRCPairNameModel();
 
-  void                                              render( const QString& name, const QRect& viewport,
+  void                                              render( RCPairHandle handle, const QRect& viewport,
                                                             GMlib::RenderTarget& target );
+  void                                              renderViews( const std::vector<RCPairHandle>& handles,
+                                                                 const std::vector<QRect>& tiles,
+                                                                 TiledRenderTarget& target );
 
   void                                              prepare();
 
+  unsigned long                                     frameNumber() const;
+
+  // Screenshots and recording; render thread, after the view is rendered into fbo.
+  // Captures are read back asynchronously and written to captureDirectory(); top_down if
+  // fbo holds its rows top down (an FBO shown mirrored vertically). Without a capture in
+  // this frame (isCapturing()), pollCaptures() finishes earlier readbacks
+  void                                              captureFrame( QOpenGLFramebufferObject* fbo, const QString& view,
+                                                                  bool top_down );
+  void                                              pollCaptures();
+  QString                                           captureDirectory() const;
+  bool                                              isRecording() const;
+  bool                                              isCapturing() const;
+
 public slots:
   void                                              toggleSimulation();
 
+  // Capture requests; any thread
+  void                                              requestScreenshot();
+  void                                              toggleRecording();
+
+  // Frame handoff; must be called while the GUI thread is blocked, i.e.,
+  // from QQuickWindow::beforeSynchronizing on a Qt::DirectConnection
+  void                                              synchronizeFrame();
+
+  // Frame callbacks; QQuickWindow::afterAnimating (GUI thread) and
+  // QQuickWindow::frameSwapped (render thread, Qt::DirectConnection)
+  void                                              onAfterAnimating();
+  void                                              onFrameSwapped();
+
 protected:
   void                                              timerEvent(QTimerEvent *e) override;
 
   virtual void                                      initializeScenario() = 0;
   virtual void                                      cleanupScenario() = 0;
 
+  // Called after each simulation step, at the synchronization point; the scene may be
+  // inspected and mutated
+  virtual void                                      simulateScenario() {}
+
 private:
+  enum class RunRequest { None, Start, Stop, Toggle };
+  void                                              applyRunRequest();
+
   int                                               _timer_id;
+  // Written by the GUI thread, read by the render thread (onFrameSwapped, synchronizeFrame)
+  std::atomic<bool>                                 _started {false};
+  std::atomic<PacingMode>                           _pacing_mode {PacingMode::Timer};
+
+  // Frame interval measurement; render thread
+  QElapsedTimer                                     _frame_clock;
+  std::atomic<double>                               _frame_interval {1.0/60.0};   // Refresh interval estimate
+  std::atomic<double>                               _frame_step {1.0/60.0};       // Last presented frame; whole refresh intervals
+  std::atomic<unsigned long>                        _dropped_frames {0};
+
+  // GUI thread -> scene synchronization point requests
+  std::atomic<bool>                                 _simulation_pending {false};
+  std::atomic<RunRequest>                           _run_request {RunRequest::None};
+  std::atomic<unsigned long>                        _frame_no {0};
 
   std::shared_ptr<GMlib::Scene>                     _scene;
 
-  std::unordered_map<std::string, RenderCamPair>    _rc_pairs;
+  // Frame capture; the encoder and PBO ring are created on first use (render thread)
+  std::atomic<unsigned long>                        _screenshot_frame {0};    // Frame to capture; 0 for none
+  std::atomic<bool>                                 _recording {false};
+  std::atomic<int>                                  _recording_no {0};
+  mutable std::mutex                                _capture_mutex;
+  QString                                           _screenshot_dir;           // Made on request
+  QString                                           _recording_dir;
+  std::unique_ptr<ImageEncoder>                     _encoder;
+  std::unique_ptr<FrameCapture>                     _capture;
+
+  std::deque<RenderCamPair>                         _rc_pairs;      // Indexed by RCPairHandle; stable addresses
+  std::unordered_map<std::string, RCPairHandle>     _rc_handles;    // Name -> handle; only used for resolving
   std::shared_ptr<GMlib::DefaultSelectRenderer>     _select_renderer;
 
   int                                               _replot_low_medium_high {1};
@@ -105,14 +199,6 @@ private:
 
 signals:
   void                                              signFrameReady();
-
-
-
-  // "Singleton instance"
-private:
-  static std::unique_ptr<GMlibWrapper>              _instance;
-public:
-  static GMlibWrapper&                              instance();
 };
 
 
@@ -3,11 +3,15 @@
 // local
 #include "window.h"
 #include "gmlibwrapper.h"
+#include "programbinarycache.h"
 
 // hidmanager
 #include "../hidmanager/defaulthidmanager.h"
 #include "../hidmanager/hidmanagertreemodel.h"
 
+// work
+#include "../work/memorybudget.h"
+
 // qt
 #include <QQmlContext>
 #include <QQuickItem>
@@ -29,6 +33,17 @@ GuiApplication::GuiApplication(int& argc, char **argv) : QGuiApplication(argc, a
 
   qRegisterMetaType<HidInputEvent::HidInputParams> ("HidInputEvent::HidInputParams");
 
+  // Memory budget of the rebuildable caches; --memory-budget=<MiB>
+  for( const QString& arg : arguments() )
+    if( arg.startsWith("--memory-budget=") ) {
+      bool ok = false;
+      const qulonglong mib = arg.mid(int(qstrlen("--memory-budget="))).toULongLong(&ok);
+      if( ok ) MemoryBudget::shared().setCap( size_t(mib) << 20 );
+    }
+
+  // Shader program binary cache; --no-program-cache compiles every program
+  ProgramBinaryCache::setEnabled( !arguments().contains("--no-program-cache") );
+
   connect( &_window, &Window::sceneGraphInitialized,
            this,     &GuiApplication::onSceneGraphInitialized,
            Qt::DirectConnection );
@@ -43,6 +58,7 @@ GuiApplication::GuiApplication(int& argc, char **argv) : QGuiApplication(argc, a
   connect( this, &QGuiApplication::lastWindowClosed,
            this, &QGuiApplication::quit );
 
+  _window.rootContext()->setContextProperty( "scenario", &_scenario );
   _window.rootContext()->setContextProperty( "rc_name_model", &_scenario.rcNameModel() );
   _window.rootContext()->setContextProperty( "hidmanager_model", _hidmanager.getModel() );
   _window.setSource(QUrl("qrc:///qml/main.qml"));
@@ -81,6 +97,8 @@ GuiApplication::onSceneGraphInitialized() {
 
 void GuiApplication::onSceneGraphInvalidated() {
 
+  // The journal refers to scene objects
+  _hidmanager.clearEditJournal();
   _scenario.cleanUp();
 }
 
@@ -97,9 +115,20 @@ GuiApplication::afterOnSceneGraphInitialized() {
   connect( &_window, &Window::signMouseReleased,      &_hidmanager, &StandardHidManager::registerMouseReleaseEvent );
   connect( &_window, &Window::signWheelEventOccurred, &_hidmanager, &StandardHidManager::registerWheelEvent );
 
-  // Handle HID OpenGL actions; needs to have the OGL context bound;
-  // QQuickWindow's beforeRendering singnal provides that on a DirectConnection
-  connect( &_window, &Window::beforeRendering,        &_hidmanager, &DefaultHidManager::triggerOGLActions,
+  // Frame handoff; all scene mutation happens at the scene graph synchronization point:
+  // QQuickWindow's beforeSynchronizing signal is emitted, on a DirectConnection, with the
+  // OGL context bound and the GUI thread blocked. In order; deferred HID actions, the
+  // simulation step and scene preparation, and deferred GL replots of edited objects.
+  // The render thread then draws this state while the GUI thread carries on.
+  connect( &_window, &Window::beforeSynchronizing,    &_hidmanager, &DefaultHidManager::triggerDeferredActions,
+           Qt::DirectConnection );
+  connect( &_window, &Window::beforeSynchronizing,    &_scenario,   &GMlibWrapper::synchronizeFrame,
+           Qt::DirectConnection );
+  connect( &_window, &Window::beforeSynchronizing,    &_scenario,   &Scenario::callDefferedGL,
+           Qt::DirectConnection );
+
+  // Uploads streamed during the frame are fenced once its commands are issued
+  connect( &_window, &Window::afterRendering,         &_scenario,   &Scenario::endUploadFrame,
            Qt::DirectConnection );
 
   // Register an application close event in the hidmanager;
@@ -109,6 +138,15 @@ GuiApplication::afterOnSceneGraphInitialized() {
   _hidmanager.registerHidAction( "Application", "Quit", "Close application!", &_window, SLOT(close()));
   _hidmanager.registerHidMapping( ha_id_var_close_app, new KeyPressInput( Qt::Key_Q, Qt::ControlModifier) );
 
+  // Screenshot of every view; recording of raw frames, both into ./captures
+  QString ha_id_var_screenshot =
+  _hidmanager.registerHidAction( "Application", "Screenshot", "Save a screenshot of the views", &_scenario, SLOT(requestScreenshot()));
+  _hidmanager.registerHidMapping( ha_id_var_screenshot, new KeyPressInput( Qt::Key_F12 ) );
+
+  QString ha_id_var_recording =
+  _hidmanager.registerHidAction( "Application", "Toggle: Recording", "Start/stop recording the views", &_scenario, SLOT(toggleRecording()));
+  _hidmanager.registerHidMapping( ha_id_var_recording, new KeyPressInput( Qt::Key_F12, Qt::ShiftModifier) );
+
   // Connect some application spesific inputs.
   connect( &_hidmanager, &DefaultHidManager::signToggleSimulation,
            &_scenario,   &GMlibWrapper::toggleSimulation );
@@ -119,11 +157,16 @@ GuiApplication::afterOnSceneGraphInitialized() {
   // Update RCPair name model
   _scenario.updateRCPairNameModel();
 
+  // Simulation pacing; one simulation step per displayed frame,
+  // unless the timer driven pacing is asked for
+  connect( &_window, &Window::afterAnimating,         &_scenario,   &GMlibWrapper::onAfterAnimating );
+  connect( &_window, &Window::frameSwapped,           &_scenario,   &GMlibWrapper::onFrameSwapped,
+           Qt::DirectConnection );
+  _scenario.setPacingMode( arguments().contains("--timer-pacing") ? GMlibWrapper::PacingMode::Timer
+                                                                   : GMlibWrapper::PacingMode::FrameCallback );
+
   // Start simulator
   _scenario.start();
-
-
-  connect( &_window, &Window::beforeRendering, &_scenario, &Scenario::callDefferedGL, Qt::DirectConnection );
 }
 
 const GuiApplication& GuiApplication::instance() {  return *_instance; }
@@ -0,0 +1,181 @@
+#include "headlessapplication.h"
+
+// local
+#include "tiledrendertarget.h"
+#include "programbinarycache.h"
+
+// qt
+#include <QDebug>
+#include <QDir>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLFunctions>
+#include <QSurfaceFormat>
+
+// stl
+#include <algorithm>
+
+
+
+namespace {
+
+  // Renders into a given FBO; the whole FBO, or a tile of it
+  class OffscreenRenderTarget : public TiledRenderTarget {
+  public:
+    explicit OffscreenRenderTarget( GLuint fbo ) : _fbo(fbo) { _gl.initializeOpenGLFunctions(); }
+
+  private:
+    GLuint                    _fbo;
+    mutable QOpenGLFunctions  _gl;
+
+    void doPrepare()  const override {}
+    void doBind()     const override {
+
+      _gl.glBindFramebuffer(GL_FRAMEBUFFER,_fbo);
+      const auto vp = glTile();
+      _gl.glViewport(vp.x(),vp.y(),vp.width(),vp.height());
+    }
+    void doUnbind()   const override { _gl.glBindFramebuffer(GL_FRAMEBUFFER,0x0); }
+    void doResize()   override {}
+  };
+
+  QString option( const QStringList& args, const QString& name ) {
+
+    for( const QString& arg : args )
+      if( arg.startsWith(name + "=") ) return arg.mid(name.size() + 1);
+    return QString();
+  }
+}
+
+
+
+HeadlessApplication::HeadlessApplication(int& argc, char** argv) : QGuiApplication(argc, argv) {
+
+  const QStringList args = arguments();
+
+  const QStringList size = option(args, "--size").split('x');
+  if( size.size() == 2 && size[0].toInt() > 0 && size[1].toInt() > 0 )
+    _size = QSize(size[0].toInt(), size[1].toInt());
+
+  if( !option(args, "--views").isEmpty() )   _views   = option(args, "--views").split(',', QString::SkipEmptyParts);
+  if( !option(args, "--frames").isEmpty() )  _frames  = std::max(option(args, "--frames").toInt(), 1);
+  if( !option(args, "--samples").isEmpty() ) _samples = std::max(option(args, "--samples").toInt(), 0);
+  if( !option(args, "--out").isEmpty() )     _out_dir = option(args, "--out");
+
+  ProgramBinaryCache::setEnabled( !args.contains("--no-program-cache") );
+}
+
+HeadlessApplication::~HeadlessApplication() {
+
+  if( _context.isValid() && _context.makeCurrent(&_surface) ) {
+    _capture.reset();
+    if( _scenario.scene() ) _scenario.cleanUp();
+    _fbo.reset();
+    _context.doneCurrent();
+  }
+}
+
+bool HeadlessApplication::createContext() {
+
+  QSurfaceFormat format;
+  if(QOpenGLContext::openGLModuleType() == QOpenGLContext::LibGL) {
+
+    format.setVersion(4,0);                                   // GMlib is compatible with OpenGL >= 3.3
+    format.setProfile(QSurfaceFormat::CompatibilityProfile);
+    format.setOption(QSurfaceFormat::DeprecatedFunctions);
+  }
+  format.setDepthBufferSize(24);
+  format.setStencilBufferSize(8);
+
+  _context.setFormat(format);
+  if( !_context.create() ) return false;
+
+  _surface.setFormat(_context.format());
+  _surface.create();
+  return _surface.isValid() && _context.makeCurrent(&_surface);
+}
+
+int HeadlessApplication::run() {
+
+  // Nothing below works without a context; stop here, and say where to look
+  if( !createContext() ) {
+    qCritical().noquote() << "Headless: no offscreen OpenGL context on the" << platformName() << "platform."
+                          << "Set QT_QPA_PLATFORM (eglfs, or another platform with EGL) and EGL_PLATFORM"
+                          << "(surfaceless for Mesa/llvmpipe), or LIBGL_ALWAYS_SOFTWARE=1 to force llvmpipe.";
+    return 1;
+  }
+  if( _context.format().version() < qMakePair(3,3) ) {
+    qCritical() << "Headless: OpenGL" << _context.format().majorVersion() << "." << _context.format().minorVersion()
+                << "context; GMlib needs OpenGL 3.3";
+    return 1;
+  }
+  qDebug() << "GL context: " << _context.format();
+
+  if( !QDir().mkpath(_out_dir) ) {
+    qCritical() << "Headless: cannot create" << _out_dir;
+    return 1;
+  }
+
+  // Init GMlibWrapper and the scenario, as on scene graph initialization
+  _scenario.initialize();
+  _scenario.initializeScenario();
+  _scenario.prepare();
+
+  if( _views.isEmpty() )
+    for( RCPairHandle h = 0; h < _scenario.rcPairCount(); ++h ) _views << _scenario.rcPair(h).name;
+
+  QOpenGLFramebufferObjectFormat format;
+  format.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+  format.setSamples(_samples);
+  _fbo.reset( new QOpenGLFramebufferObject(_size, format) );
+  _capture.reset( new FrameCapture(_encoder, 3 * std::max(int(_views.size()),1)) );   // Two frames in flight
+  _capture->setTopDown(true);   // As GMlib renders into the windowed FBO, which is shown mirrored
+
+  // One simulation step per frame, as with frame callback pacing
+  _scenario.setPacingMode( GMlibWrapper::PacingMode::FrameCallback );
+  _scenario.start();
+
+  for( int frame = 0; frame < _frames; ++frame ) {
+
+    if( frame > 0 ) _scenario.onAfterAnimating();
+    _scenario.synchronizeFrame();
+    _scenario.callDefferedGL();
+
+    renderFrame(frame);
+    _capture->poll();
+    _scenario.endUploadFrame();
+  }
+
+  _scenario.stop();
+  _capture->flush();
+  _encoder.finish();
+
+  qDebug() << "Headless:" << _encoder.written() << "images written to" << _out_dir
+           << "," << _encoder.failed() << "failed";
+  return _encoder.failed() == 0 ? 0 : 1;
+}
+
+void HeadlessApplication::renderFrame( int frame ) {
+
+  QOpenGLFunctions* gl = _context.functions();
+  OffscreenRenderTarget target(_fbo->handle());
+  target.setFramebufferSize(_size);
+
+  for( const QString& view : _views ) {
+
+    const RCPairHandle handle = _scenario.rcHandle(view);
+    if( !_scenario.isValidRCHandle(handle) ) {
+      qWarning() << "Headless: no view" << view;
+      continue;
+    }
+
+    _fbo->bind();
+    gl->glViewport(0,0,_size.width(),_size.height());
+    gl->glClearColor(0.0f,0.0f,0.0f,1.0f);
+    gl->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+    _scenario.render(handle, QRect(QPoint(0,0),_size), target);
+
+    // Read back asynchronously; the encoding happens on the encoder thread
+    _capture->capture( _fbo.get(), QString("%1/%2_%3.png").arg(_out_dir, view).arg(frame, 4, 10, QChar('0')) );
+  }
+}
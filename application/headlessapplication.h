@@ -0,0 +1,69 @@
+#ifndef HEADLESSAPPLICATION_H
+#define HEADLESSAPPLICATION_H
+
+
+#include "framecapture.h"
+#include "imageencoder.h"
+#include "../scenario.h"
+
+// qt
+#include <QGuiApplication>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QSize>
+#include <QStringList>
+
+// stl
+#include <memory>
+
+class QOpenGLFramebufferObject;
+
+
+
+
+/*!
+ *  Batch rendering without a display (--headless); thumbnails and regression images.
+ *
+ *  The scenario is rendered through GMlibWrapper::render, as in the windowed application,
+ *  but into an FBO of an offscreen context (QOffscreenSurface; GL through EGL on the
+ *  eglfs platform with Mesa's surfaceless EGL platform, llvmpipe without a GPU, unless
+ *  QT_QPA_PLATFORM and EGL_PLATFORM say otherwise; see main.cpp). Without a context it
+ *  stops with an error. Every frame renders each requested view and reads it back through the
+ *  FrameCapture PBO ring, so rendering continues while earlier frames are read back and
+ *  encoded; <out>/<view>_<frame>.png.
+ *
+ *  Options:
+ *    --size=<w>x<h>       Image size (512x512)
+ *    --views=<a>,<b>,...  Render/camera pairs by name (all)
+ *    --frames=<n>         Simulation steps, one image per view each (1)
+ *    --samples=<n>        MSAA samples (4)
+ *    --out=<dir>          Output directory (.)
+ */
+class HeadlessApplication : public QGuiApplication {
+public:
+  explicit HeadlessApplication(int& argc, char** argv);
+  ~HeadlessApplication();
+
+  // Renders all frames; the exit code
+  int                                         run();
+
+private:
+  QOffscreenSurface                           _surface;
+  QOpenGLContext                              _context;
+  Scenario                                    _scenario;
+  ImageEncoder                                _encoder;
+
+  std::unique_ptr<QOpenGLFramebufferObject>   _fbo;           // Rendered to; multisampled
+  std::unique_ptr<FrameCapture>               _capture;
+
+  QSize                                       _size    {512,512};
+  QStringList                                 _views;
+  int                                         _frames  {1};
+  int                                         _samples {4};
+  QString                                     _out_dir {"."};
+
+  bool                                        createContext();
+  void                                        renderFrame( int frame );
+};
+
+#endif // HEADLESSAPPLICATION_H
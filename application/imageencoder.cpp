@@ -0,0 +1,100 @@
+#include "imageencoder.h"
+
+// qt
+#include <QDebug>
+#include <QSaveFile>
+
+// stl
+#include <algorithm>
+
+
+
+
+ImageEncoder::ImageEncoder( int max_pending )
+  : _max_pending(std::max(max_pending,1)), _thread([this]{ work(); }) {}
+
+ImageEncoder::~ImageEncoder() {
+
+  finish();
+  {
+    std::lock_guard<std::mutex> lk(_mutex);
+    _stop = true;
+  }
+  _work.notify_all();
+  _thread.join();
+}
+
+void ImageEncoder::encode( QImage image, const QString& path ) {
+
+  std::unique_lock<std::mutex> lk(_mutex);
+  _progress.wait( lk, [this]{ return int(_queue.size()) < _max_pending; } );
+  _queue.emplace_back( std::move(image), path );
+  lk.unlock();
+  _work.notify_one();
+}
+
+bool ImageEncoder::tryEncode( QImage image, const QString& path ) {
+
+  std::unique_lock<std::mutex> lk(_mutex);
+  if( int(_queue.size()) >= _max_pending ) return false;
+  _queue.emplace_back( std::move(image), path );
+  lk.unlock();
+  _work.notify_one();
+  return true;
+}
+
+void ImageEncoder::finish() {
+
+  std::unique_lock<std::mutex> lk(_mutex);
+  _progress.wait( lk, [this]{ return _queue.empty() && _busy == 0; } );
+}
+
+int ImageEncoder::written() const {
+
+  std::lock_guard<std::mutex> lk(_mutex);
+  return _written;
+}
+
+int ImageEncoder::failed() const {
+
+  std::lock_guard<std::mutex> lk(_mutex);
+  return _failed;
+}
+
+void ImageEncoder::work() {
+
+  std::unique_lock<std::mutex> lk(_mutex);
+  for(;;) {
+
+    _work.wait( lk, [this]{ return _stop || !_queue.empty(); } );
+    if( _queue.empty() ) return;
+
+    auto item = std::move(_queue.front());
+    _queue.pop_front();
+    ++_busy;
+    lk.unlock();
+    _progress.notify_all();
+
+    const bool ok = write(item.first, item.second);
+    if( !ok ) qWarning() << "Failed to write image" << item.second;
+
+    lk.lock();
+    --_busy;
+    ++(ok ? _written : _failed);
+    _progress.notify_all();
+  }
+}
+
+bool ImageEncoder::write( const QImage& image, const QString& path ) {
+
+  if( !path.endsWith(".raw", Qt::CaseInsensitive) )
+    return image.save(path);
+
+  QSaveFile file(path);
+  if( !file.open(QIODevice::WriteOnly) ) return false;
+
+  const int row_bytes = image.width() * image.depth() / 8;
+  for( int y = 0; y < image.height(); ++y )
+    if( file.write(reinterpret_cast<const char*>(image.constScanLine(y)), row_bytes) != row_bytes ) return false;
+  return file.commit();
+}
@@ -0,0 +1,61 @@
+#ifndef IMAGEENCODER_H
+#define IMAGEENCODER_H
+
+
+// qt
+#include <QImage>
+#include <QString>
+
+// stl
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+
+
+/*!
+ *  Background image writer; rendered frames are handed over and encoded (PNG, JPEG, ...
+ *  by the file suffix, as QImage::save) on a thread of its own, so the GL thread only
+ *  pays for the readback. A ".raw" suffix writes the pixels as they are, rows top to
+ *  bottom without padding; the cheapest format for recording.
+ *
+ *  - encode() blocks while max_pending images are queued, which bounds the memory held
+ *    by frames rendered faster than they are written. tryEncode() drops the image
+ *    instead, for callers that must not stall (interactive recording).
+ *  - finish() waits until every queued image is written; the destructor finishes.
+ */
+class ImageEncoder {
+public:
+  explicit ImageEncoder( int max_pending = 8 );
+  ~ImageEncoder();
+
+  ImageEncoder( const ImageEncoder& ) = delete;
+  ImageEncoder& operator=( const ImageEncoder& ) = delete;
+
+  void          encode( QImage image, const QString& path );
+  bool          tryEncode( QImage image, const QString& path );
+  void          finish();
+
+  int           written() const;
+  int           failed() const;
+
+private:
+  const int                             _max_pending;
+  mutable std::mutex                    _mutex;
+  std::condition_variable               _work;        // Queued image or stop
+  std::condition_variable               _progress;    // Image taken or written
+  std::deque<std::pair<QImage,QString>> _queue;
+  int                                   _busy    {0};
+  int                                   _written {0};
+  int                                   _failed  {0};
+  bool                                  _stop    {false};
+  std::thread                           _thread;
+
+  void          work();
+  static bool   write( const QImage& image, const QString& path );
+};
+
+
+#endif // IMAGEENCODER_H
@@ -1,5 +1,6 @@
 // local
 #include "guiapplication.h"
+#include "headlessapplication.h"
 
 // gmlib
 #include <core/gmglobal.h>
@@ -8,6 +9,8 @@
 #include <QDebug>
 
 // stl
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 
@@ -40,6 +43,22 @@ int main(int argc, char *argv[]) try {
   else
     qDebug() << QString( "GMlib version: %1" ).arg( GM_VERSION_STR ).toStdString().c_str();
 
+  // Batch rendering without a display
+  if( std::find_if( argv, argv + argc, [](const char* arg){ return std::strcmp(arg,"--headless") == 0; } ) != argv + argc ) {
+
+    // GL through EGL, no X server or display. Qt 5's offscreen platform makes its contexts
+    // through GLX and needs an X server; eglfs without a device integration only opens an
+    // EGL display, and Mesa's surfaceless EGL platform gives contexts and pbuffers (the
+    // QOffscreenSurface) without one, rendered by llvmpipe when there is no GPU.
+    // Each may be overridden from the environment
+    if( qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM") )           qputenv("QT_QPA_PLATFORM", "eglfs");
+    if( qEnvironmentVariableIsEmpty("QT_QPA_EGLFS_INTEGRATION") )  qputenv("QT_QPA_EGLFS_INTEGRATION", "none");
+    if( qEnvironmentVariableIsEmpty("EGL_PLATFORM") )              qputenv("EGL_PLATFORM", "surfaceless");
+
+    HeadlessApplication a(argc, argv);
+    return a.run();
+  }
+
   // Create the application object
   GuiApplication a(argc, argv);
 
@@ -0,0 +1,352 @@
+#include "programbinarycache.h"
+
+// work
+#include "../work/threadpool.h"
+
+// gmlib
+#include <opengl/gmopengl.h>
+
+// qt
+#include <QByteArray>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+// stl
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+
+
+
+namespace {
+
+  struct ShaderRecord {
+    std::string   source;
+    bool          pending {false};    // Compile deferred to link
+  };
+
+  struct ProgramRecord {
+    std::vector<GLuint>   shaders;    // In attach order
+    std::string           bindings;   // Attribute and fragment data locations
+  };
+
+  struct State {
+    bool                                      enabled   {true};
+    bool                                      installed {false};
+    QString                                   dir;
+    std::string                               driver;
+    std::unordered_map<GLuint,ShaderRecord>   shaders;
+    std::unordered_map<GLuint,ProgramRecord>  programs;
+    int                                       hits   {0};
+    int                                       misses {0};
+
+    // The GLEW entry points replaced by the hooks
+    PFNGLSHADERSOURCEPROC           shaderSource        {nullptr};
+    PFNGLCOMPILESHADERPROC          compileShader       {nullptr};
+    PFNGLGETSHADERIVPROC            getShaderiv         {nullptr};
+    PFNGLGETSHADERINFOLOGPROC       getShaderInfoLog    {nullptr};
+    PFNGLATTACHSHADERPROC           attachShader        {nullptr};
+    PFNGLDETACHSHADERPROC           detachShader        {nullptr};
+    PFNGLBINDATTRIBLOCATIONPROC     bindAttribLocation  {nullptr};
+    PFNGLBINDFRAGDATALOCATIONPROC   bindFragDataLocation{nullptr};
+    PFNGLLINKPROGRAMPROC            linkProgram         {nullptr};
+    PFNGLDELETESHADERPROC           deleteShader        {nullptr};
+    PFNGLDELETEPROGRAMPROC          deleteProgram       {nullptr};
+  };
+
+  State& state() {
+    static State s;
+    return s;
+  }
+
+  const quint32 FileMagic {0x42504d47};   // "GMPB"
+
+  std::uint64_t fnv1a( const std::string& data, std::uint64_t h = 1469598103934665603ull ) {
+
+    for( unsigned char c : data ) h = (h ^ c) * 1099511628211ull;
+    return h;
+  }
+
+  std::string glString( GLenum name ) {
+
+    const GLubyte* s = ::glGetString(name);
+    return s ? std::string(reinterpret_cast<const char*>(s)) : std::string();
+  }
+
+  QString binaryPath( const ProgramRecord& rec ) {
+
+    auto& st = state();
+    std::uint64_t h = fnv1a(st.driver);
+    for( GLuint sh : rec.shaders ) {
+      auto it = st.shaders.find(sh);
+      h = fnv1a(it != st.shaders.end() ? it->second.source : std::string(), h);
+      h = fnv1a(std::string(1, '\0'), h);
+    }
+    h = fnv1a(rec.bindings, h);
+    return st.dir + QString("/%1.bin").arg(qulonglong(h), 16, 16, QChar('0'));
+  }
+
+  bool linked( GLuint program ) {
+
+    GLint status = GL_FALSE;
+    ::glGetProgramiv(program, GL_LINK_STATUS, &status);
+    return status == GL_TRUE;
+  }
+
+  bool loadBinary( GLuint program, const QString& path ) {
+
+    QFile file(path);
+    if( !file.open(QIODevice::ReadOnly) ) return false;
+
+    const QByteArray data = file.readAll();
+    if( data.size() < 8 ) return false;
+
+    quint32 magic, format;
+    std::copy_n(data.constData(),     4, reinterpret_cast<char*>(&magic));
+    std::copy_n(data.constData() + 4, 4, reinterpret_cast<char*>(&format));
+    if( magic != FileMagic ) return false;
+
+    ::glProgramBinary(program, GLenum(format), data.constData() + 8, GLsizei(data.size() - 8));
+    return linked(program);
+  }
+
+  void storeBinary( GLuint program, const QString& path ) {
+
+    GLint length = 0;
+    ::glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if( length <= 0 ) return;
+
+    QByteArray data(8 + length, Qt::Uninitialized);
+    GLenum format = 0;
+    ::glGetProgramBinary(program, length, nullptr, &format, data.data() + 8);
+    const quint32 magic = FileMagic, format32 = quint32(format);
+    std::copy_n(reinterpret_cast<const char*>(&magic),    4, data.data());
+    std::copy_n(reinterpret_cast<const char*>(&format32), 4, data.data() + 4);
+
+    // Off the GL thread; a partly written file is never visible under its name
+    ThreadPool::shared().enqueue([path, data] {
+      QSaveFile file(path);
+      if( file.open(QIODevice::WriteOnly) && file.write(data) == data.size() )
+        file.commit();
+    });
+  }
+
+  void compilePending( GLuint shader ) {
+
+    auto& st = state();
+    auto it = st.shaders.find(shader);
+    if( it == st.shaders.end() || !it->second.pending ) return;
+
+    it->second.pending = false;
+    st.compileShader(shader);
+  }
+
+  void logFailure( GLuint program, const ProgramRecord& rec ) {
+
+    auto& st = state();
+    for( GLuint sh : rec.shaders ) {
+      GLint ok = GL_FALSE, length = 0;
+      st.getShaderiv(sh, GL_COMPILE_STATUS, &ok);
+      if( ok == GL_TRUE ) continue;
+      st.getShaderiv(sh, GL_INFO_LOG_LENGTH, &length);
+      std::string log(size_t(std::max(length, 1)), '\0');
+      st.getShaderInfoLog(sh, length, nullptr, &log[0]);
+      qWarning() << "Shader compile failed:" << log.c_str();
+    }
+    GLint length = 0;
+    ::glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+    std::string log(size_t(std::max(length, 1)), '\0');
+    ::glGetProgramInfoLog(program, length, nullptr, &log[0]);
+    qWarning() << "Program link failed:" << log.c_str();
+  }
+
+
+
+  // Hooks
+
+  void GLAPIENTRY hookShaderSource( GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length ) {
+
+    std::string source;
+    for( GLsizei i = 0; i < count; ++i )
+      source.append(string[i], length && length[i] >= 0 ? size_t(length[i]) : std::char_traits<char>::length(string[i]));
+    state().shaders[shader].source = std::move(source);
+    state().shaderSource(shader, count, string, length);
+  }
+
+  void GLAPIENTRY hookCompileShader( GLuint shader ) {
+
+    state().shaders[shader].pending = true;
+  }
+
+  void GLAPIENTRY hookGetShaderiv( GLuint shader, GLenum pname, GLint* params ) {
+
+    auto& st = state();
+    auto it = st.shaders.find(shader);
+    if( it != st.shaders.end() && it->second.pending ) {
+      if( pname == GL_COMPILE_STATUS )   { *params = GL_TRUE; return; }
+      if( pname == GL_INFO_LOG_LENGTH )  { *params = 0;       return; }
+    }
+    st.getShaderiv(shader, pname, params);
+  }
+
+  void GLAPIENTRY hookGetShaderInfoLog( GLuint shader, GLsizei max_length, GLsizei* length, GLchar* log ) {
+
+    auto& st = state();
+    auto it = st.shaders.find(shader);
+    if( it != st.shaders.end() && it->second.pending ) {
+      if( length ) *length = 0;
+      if( log && max_length > 0 ) log[0] = '\0';
+      return;
+    }
+    st.getShaderInfoLog(shader, max_length, length, log);
+  }
+
+  void GLAPIENTRY hookAttachShader( GLuint program, GLuint shader ) {
+
+    state().programs[program].shaders.push_back(shader);
+    state().attachShader(program, shader);
+  }
+
+  void GLAPIENTRY hookDetachShader( GLuint program, GLuint shader ) {
+
+    auto& shaders = state().programs[program].shaders;
+    shaders.erase(std::remove(shaders.begin(), shaders.end(), shader), shaders.end());
+    state().detachShader(program, shader);
+  }
+
+  void GLAPIENTRY hookBindAttribLocation( GLuint program, GLuint index, const GLchar* name ) {
+
+    state().programs[program].bindings += "a" + std::to_string(index) + name + ";";
+    state().bindAttribLocation(program, index, name);
+  }
+
+  void GLAPIENTRY hookBindFragDataLocation( GLuint program, GLuint color, const GLchar* name ) {
+
+    state().programs[program].bindings += "f" + std::to_string(color) + name + ";";
+    state().bindFragDataLocation(program, color, name);
+  }
+
+  void GLAPIENTRY hookLinkProgram( GLuint program ) {
+
+    auto& st  = state();
+    auto& rec = st.programs[program];
+    const QString path = binaryPath(rec);
+
+    if( loadBinary(program, path) ) {
+      ++st.hits;
+      return;
+    }
+
+    // Miss or rejected binary; compile everything first, so the driver may do it in parallel
+    ++st.misses;
+    for( GLuint sh : rec.shaders ) compilePending(sh);
+    ::glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    st.linkProgram(program);
+
+    if( linked(program) ) storeBinary(program, path);
+    else                  logFailure(program, rec);
+  }
+
+  void GLAPIENTRY hookDeleteShader( GLuint shader ) {
+
+    state().shaders.erase(shader);
+    state().deleteShader(shader);
+  }
+
+  void GLAPIENTRY hookDeleteProgram( GLuint program ) {
+
+    state().programs.erase(program);
+    state().deleteProgram(program);
+  }
+
+}  // END anonymous namespace
+
+
+
+
+
+void ProgramBinaryCache::setDirectory( const QString& dir ) { state().dir = dir; }
+
+QString ProgramBinaryCache::directory() {
+
+  auto& st = state();
+  if( st.dir.isEmpty() )
+    st.dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/programs";
+  return st.dir;
+}
+
+void ProgramBinaryCache::setEnabled( bool enabled ) { state().enabled = enabled; }
+
+bool ProgramBinaryCache::isEnabled() { return state().enabled; }
+
+int ProgramBinaryCache::hits() { return state().hits; }
+
+int ProgramBinaryCache::misses() { return state().misses; }
+
+bool ProgramBinaryCache::install() {
+
+  auto& st = state();
+  if( !st.enabled || st.installed ) return false;
+  if( !(GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary) ) return false;
+
+  GLint no_formats = 0;
+  ::glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &no_formats);
+  if( no_formats <= 0 ) return false;
+
+  if( !QDir().mkpath(directory()) ) return false;
+
+  st.driver = glString(GL_VENDOR) + '\n' + glString(GL_RENDERER) + '\n'
+            + glString(GL_VERSION) + '\n' + glString(GL_SHADING_LANGUAGE_VERSION);
+
+#ifdef GL_KHR_parallel_shader_compile
+  if( GLEW_KHR_parallel_shader_compile ) ::glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+#endif
+
+  st.shaderSource         = __glewShaderSource;          __glewShaderSource          = hookShaderSource;
+  st.compileShader        = __glewCompileShader;         __glewCompileShader         = hookCompileShader;
+  st.getShaderiv          = __glewGetShaderiv;           __glewGetShaderiv           = hookGetShaderiv;
+  st.getShaderInfoLog     = __glewGetShaderInfoLog;      __glewGetShaderInfoLog      = hookGetShaderInfoLog;
+  st.attachShader         = __glewAttachShader;          __glewAttachShader          = hookAttachShader;
+  st.detachShader         = __glewDetachShader;          __glewDetachShader          = hookDetachShader;
+  st.bindAttribLocation   = __glewBindAttribLocation;    __glewBindAttribLocation    = hookBindAttribLocation;
+  st.bindFragDataLocation = __glewBindFragDataLocation;  __glewBindFragDataLocation  = hookBindFragDataLocation;
+  st.linkProgram          = __glewLinkProgram;           __glewLinkProgram           = hookLinkProgram;
+  st.deleteShader         = __glewDeleteShader;          __glewDeleteShader          = hookDeleteShader;
+  st.deleteProgram        = __glewDeleteProgram;         __glewDeleteProgram         = hookDeleteProgram;
+
+  st.installed = true;
+  return true;
+}
+
+void ProgramBinaryCache::uninstall() {
+
+  auto& st = state();
+  if( !st.installed ) return;
+
+  // Shaders still deferred (never linked, or linked from a binary) are compiled now, as
+  // they may be queried or linked again through the real entry points
+  for( auto& s : st.shaders ) compilePending(s.first);
+
+  __glewShaderSource         = st.shaderSource;
+  __glewCompileShader        = st.compileShader;
+  __glewGetShaderiv          = st.getShaderiv;
+  __glewGetShaderInfoLog     = st.getShaderInfoLog;
+  __glewAttachShader         = st.attachShader;
+  __glewDetachShader         = st.detachShader;
+  __glewBindAttribLocation   = st.bindAttribLocation;
+  __glewBindFragDataLocation = st.bindFragDataLocation;
+  __glewLinkProgram          = st.linkProgram;
+  __glewDeleteShader         = st.deleteShader;
+  __glewDeleteProgram        = st.deleteProgram;
+
+  st.shaders.clear();
+  st.programs.clear();
+  st.installed = false;
+}
@@ -0,0 +1,48 @@
+#ifndef PROGRAMBINARYCACHE_H
+#define PROGRAMBINARYCACHE_H
+
+
+// qt
+#include <QString>
+
+
+
+/*!
+ *  On-disk cache of linked shader program binaries (GL 4.1 / ARB_get_program_binary).
+ *
+ *  GMlib compiles and links its programs inside OpenGLManager::init(); the cache is
+ *  installed before that call, and left installed so programs linked later are cached
+ *  too. It hooks the GLEW shader/program entry points:
+ *
+ *  - Shader compiles are deferred to link time; until then a shader reports itself
+ *    compiled. A program's key is a hash of the driver (vendor, renderer, GL and GLSL
+ *    versions), its shader sources and its attribute/fragment data bindings.
+ *  - On link the binary stored under the key is loaded with glProgramBinary. On a miss,
+ *    or if the driver rejects the binary (invalidation), the attached shaders are
+ *    compiled (in parallel with KHR_parallel_shader_compile) and the program is linked;
+ *    the new binary is written to disk on a background thread.
+ *  - Binaries live in <cache location>/programs, one file per key.
+ *
+ *  All hooked calls must come from the thread (and context) that called install().
+ */
+class ProgramBinaryCache {
+public:
+  // Cache directory; the default is QStandardPaths::CacheLocation/programs
+  static void       setDirectory( const QString& dir );
+  static QString    directory();
+
+  // Disabled caches install nothing (--no-program-cache)
+  static void       setEnabled( bool enabled );
+  static bool       isEnabled();
+
+  // With the context current; false if the driver has no program binary support
+  static bool       install();
+  // Restores the GLEW entry points; deferred shaders are compiled first
+  static void       uninstall();
+
+  static int        hits();
+  static int        misses();
+};
+
+
+#endif // PROGRAMBINARYCACHE_H
@@ -18,7 +18,9 @@ Item {
 
     anchors.fill: parent
 
+    gmlib: scenario
     rcpair_name: rc_pair_cb.currentText
+    multiview: multiview_cb.checked
 
     ComboBox {
       id: rc_pair_cb
@@ -34,6 +36,17 @@ Item {
       textRole: "display"
     }
 
+    CheckBox {
+      id: multiview_cb
+      anchors.verticalCenter: rc_pair_cb.verticalCenter
+      anchors.left: rc_pair_cb.right
+      anchors.margins: 5
+
+      opacity: 0.7
+
+      text: "Multi-view"
+    }
+
     Button {
       text: "?"
       anchors.top: parent.top
@@ -46,6 +59,19 @@ Item {
       onClicked: hid_bind_view.toggle()
     }
 
+    Text {
+      id: memory_usage
+      anchors.bottom: parent.bottom
+      anchors.left: parent.left
+      anchors.margins: 5
+
+      opacity: 0.7
+      color: "white"
+      font.pixelSize: 11
+
+      text: scenario.memoryUsage
+    }
+
     HidBindingView {
       id: hid_bind_view
       anchors.fill: parent
@@ -0,0 +1,62 @@
+#ifndef TILEDRENDERTARGET_H
+#define TILEDRENDERTARGET_H
+
+
+// gmlib
+#include <scene/render/gmrendertarget.h>
+
+// qt
+#include <QRect>
+#include <QSize>
+
+// stl
+#include <cmath>
+
+
+
+/*!
+ *  A render target which is a sub rectangle (tile) of a shared framebuffer.
+ *
+ *  Tiles are given in item coordinates (origin top-left, as Qt Quick lays them out).
+ *  The item shows its FBO mirrored vertically (FboInSGRenderer), so FBO row y is item
+ *  row y and a tile is its own glViewport() rectangle; no flip, or the rows of a grid of
+ *  tiles would swap against the input routing (FboInSGRenderer::viewAt).
+ *  An invalid tile covers the whole framebuffer.
+ */
+class TiledRenderTarget : public GMlib::RenderTarget {
+public:
+  void            setFramebufferSize( const QSize& size ) { _fb_size = size; }
+  const QSize&    framebufferSize() const { return _fb_size; }
+
+  void            setTile( const QRect& tile ) { _tile = tile; }
+  void            clearTile() { _tile = QRect(); }
+  const QRect&    tile() const { return _tile; }
+
+  // Tile as glViewport() rectangle of the (vertically mirrored) framebuffer
+  QRect           glTile() const {
+
+    if(!_tile.isValid()) return QRect(QPoint(0,0),_fb_size);
+    return _tile;
+  }
+
+  // Grid layout of no_tiles equally sized tiles covering a framebuffer of the given size
+  static QRect    gridTile( int i, int no_tiles, const QSize& size ) {
+
+    if(no_tiles < 1) return QRect();
+
+    const auto cols = int(std::ceil(std::sqrt(double(no_tiles))));
+    const auto rows = (no_tiles + cols - 1) / cols;
+    const auto w    = size.width() / cols;
+    const auto h    = size.height() / rows;
+
+    return QRect( (i % cols) * w, (i / cols) * h, w, h );
+  }
+
+protected:
+  QSize           _fb_size {};
+  QRect           _tile    {};
+};
+
+
+
+#endif // TILEDRENDERTARGET_H
@@ -20,13 +20,13 @@ signals:
   void      signFrameReady();
 
   // Relay singals from qml side
-  void      signKeyPressed( const QString& name, QKeyEvent* event );
-  void      signKeyReleased( const QString& name, QKeyEvent* event );
-  void      signMouseDoubleClicked( const QString& name, QMouseEvent* event );
-  void      signMouseMoved( const QString& name, QMouseEvent* event );
-  void      signMousePressed( const QString& name, QMouseEvent* event );
-  void      signMouseReleased( const QString& name, QMouseEvent* event );
-  void      signWheelEventOccurred( const QString& name, QWheelEvent* event );
+  void      signKeyPressed( int view, QKeyEvent* event );
+  void      signKeyReleased( int view, QKeyEvent* event );
+  void      signMouseDoubleClicked( int view, QMouseEvent* event );
+  void      signMouseMoved( int view, QMouseEvent* event );
+  void      signMousePressed( int view, QMouseEvent* event );
+  void      signMouseReleased( int view, QMouseEvent* event );
+  void      signWheelEventOccurred( int view, QWheelEvent* event );
 };
 
 #endif // WINDOW_H
@@ -2,6 +2,11 @@
 
 // local
 #include "../application/gmlibwrapper.h"
+#include "../work/myerbscurve.h"
+#include "../work/myerbssurf.h"
+#include "../work/mybspline.h"
+#include "../work/controlnetselector.h"
+#include "../work/editjournal.h"
 #include "hidaction.h"
 
 // gmlib
@@ -25,7 +30,7 @@ using namespace GMlib;
 
 
 DefaultHidManager::DefaultHidManager(QObject* parent)
-  : StandardHidManager(parent), _gmlib{nullptr} {}
+  : StandardHidManager(parent), _gmlib{nullptr}, _journal{new EditJournal} {}
 
 DefaultHidManager::~DefaultHidManager() {
 
@@ -34,19 +39,29 @@ DefaultHidManager::~DefaultHidManager() {
 
 void DefaultHidManager::triggerAction(const HidAction* action, const HidInputEvent::HidInputParams& params ) {
 
-  if(action->getCustomTrigger() == OGL_TRIGGER)
-    _ogl_actions.emplace(action,params);
+  const auto trigger = action->getCustomTrigger();
+  if(trigger == OGL_TRIGGER || trigger == SYNC_TRIGGER) {
+
+    std::lock_guard<std::mutex> lk(_deferred_actions_mutex);
+    _deferred_actions.emplace(action,params);
+  }
   else
     HidManager::triggerAction(action,params);
 }
 
-void DefaultHidManager::triggerOGLActions() {
+void DefaultHidManager::triggerDeferredActions() {
+
+  std::queue<std::pair<const HidAction*,HidInputEvent::HidInputParams>> actions;
+  {
+    std::lock_guard<std::mutex> lk(_deferred_actions_mutex);
+    std::swap(actions,_deferred_actions);
+  }
 
-  while(!_ogl_actions.empty()) {
+  while(!actions.empty()) {
 
-    auto action = _ogl_actions.front();
+    auto action = actions.front();
     HidManager::triggerAction(action.first,action.second);
-    _ogl_actions.pop();
+    actions.pop();
   }
 }
 
@@ -87,8 +102,15 @@ void DefaultHidManager::heSelectors() {
 
   const Array<SceneObject*> &sel_objs = scene()->getSelectedObjects();
 
-  for( int i = 0; i < sel_objs.getSize(); i++ )
-    sel_objs(i)->toggleSelectors();
+  for( int i = 0; i < sel_objs.getSize(); i++ ) {
+
+    // One batched selector for the whole control net
+    MyB_spline *bsObj = dynamic_cast<MyB_spline*>( sel_objs(i) );
+    if( bsObj )
+      ControlNetSelector::toggle( bsObj );
+    else
+      sel_objs(i)->toggleSelectors();
+  }
 }
 
 
@@ -112,8 +134,26 @@ void DefaultHidManager::heEdit() {
     // Arc
     PArc<float> *acObj = dynamic_cast<PArc<float>*>( sel_obj );
 
+    // ERBS over MyB_spline local curves (tabulated blending)
+    MyERBSCurve *mecObj = dynamic_cast<MyERBSCurve*>( sel_obj );
+    MyERBSSurf *mesObj = dynamic_cast<MyERBSSurf*>( sel_obj );
+
     // ERBS
-    if( ecObj ) {
+    if( mecObj ) {
+
+      if( mecObj->isLocalCurvesVisible() )
+        mecObj->hideLocalCurves();
+      else
+        mecObj->showLocalCurves();
+    }
+    else if( mesObj ) {
+
+      if( mesObj->isLocalPatchesVisible() )
+        mesObj->hideLocalPatches();
+      else
+        mesObj->showLocalPatches();
+    }
+    else if( ecObj ) {
 
       if( ecObj->isLocalCurvesVisible() )
         ecObj->hideLocalCurves();
@@ -198,11 +238,14 @@ void DefaultHidManager::heEdit() {
 
 void DefaultHidManager::heLockTo(const HidInputEvent::HidInputParams& params) {
 
-  auto view_name = viewNameFromParams(params);
-  auto pos       = toGMlibViewPoint(view_name, posFromParams(params));
+  auto view      = viewFromParams(params);
+  auto pos       = toGMlibViewPoint(view, posFromParams(params));
 
-  auto cam     = findCamera(view_name);
-  auto sel_obj = findSceneObject(view_name,pos);
+  auto cam     = findCamera(view);
+  if( !cam )
+    return;
+
+  auto sel_obj = findSceneObject(view,pos);
 
   if( sel_obj )
     cam->lock( sel_obj );
@@ -216,11 +259,11 @@ void DefaultHidManager::heLockTo(const HidInputEvent::HidInputParams& params) {
 
 void DefaultHidManager::heMoveCamera(const HidInputEvent::HidInputParams& params) {
 
-  auto view_name = viewNameFromParams(params);
-  auto pos       = toGMlibViewPoint(view_name, posFromParams(params));
-  auto prev      = toGMlibViewPoint(view_name, prevPosFromParams(params));
+  auto view      = viewFromParams(params);
+  auto pos       = toGMlibViewPoint(view, posFromParams(params));
+  auto prev      = toGMlibViewPoint(view, prevPosFromParams(params));
 
-  auto *cam = findCamera(view_name);
+  auto *cam = findCamera(view);
   if( !cam ) return;
 
   const float scale = cameraSpeedScale( cam );
@@ -231,11 +274,11 @@ void DefaultHidManager::heMoveCamera(const HidInputEvent::HidInputParams& params
 
 void DefaultHidManager::heMoveSelectedObjects( const HidInputEvent::HidInputParams& params ) {
 
-  auto view_name = viewNameFromParams(params);
-  auto pos       = toGMlibViewPoint(view_name, posFromParams(params));
-  auto prev      = toGMlibViewPoint(view_name, prevPosFromParams(params));
+  auto view      = viewFromParams(params);
+  auto pos       = toGMlibViewPoint(view, posFromParams(params));
+  auto prev      = toGMlibViewPoint(view, prevPosFromParams(params));
 
-  Camera *cam = findCamera(view_name);
+  Camera *cam = findCamera(view);
   if( !cam )
     return;
 
@@ -252,20 +295,35 @@ void DefaultHidManager::heMoveSelectedObjects( const HidInputEvent::HidInputPara
 
     if( deltav.getLength() > SNAP && deltav.getLength() < 1000.0f ) {
 
-      if( obj->getTypeId() != GM_SO_TYPE_SELECTOR )
+      ControlNetSelector *net = dynamic_cast<ControlNetSelector*>( obj );
+      if( net ) {
+        const std::vector<int> indices = net->selectedIndices();
+        std::vector<EditJournal::Point> before;
+        before.reserve( indices.size() );
+        for( int idx : indices )
+          before.push_back( net->control(idx) );
+        net->moveSelected(deltav);
+        _journal->recordControls( net, indices, before );
+      }
+      else if( obj->getTypeId() != GM_SO_TYPE_SELECTOR ) {
+        const EditJournal::Frame before = EditJournal::frameOf( obj );
         obj->translateGlobal( deltav );
-      else if( obj->getTypeId()== GM_SO_TYPE_SELECTOR )
+        _journal->recordTransform( obj, before );
+      }
+      else if( obj->getTypeId()== GM_SO_TYPE_SELECTOR ) {
         obj->editPos(deltav);
+        _journal->recordSelector( obj, deltav );
+      }
     }
   }
 }
 
 void DefaultHidManager::hePanHorizontal(const HidInputEvent::HidInputParams& params) {
 
-  auto view_name   = viewNameFromParams(params);
+  auto view        = viewFromParams(params);
   auto wheel_delta = wheelDeltaFromParams(params);
 
-  Camera *cam = findCamera(view_name);
+  Camera *cam = findCamera(view);
   if( cam )
     cam->move(
       Vector<float,2>(
@@ -276,10 +334,10 @@ void DefaultHidManager::hePanHorizontal(const HidInputEvent::HidInputParams& par
 
 void DefaultHidManager::hePanVertical(const HidInputEvent::HidInputParams& params) {
 
-  auto view_name   = viewNameFromParams(params);
+  auto view        = viewFromParams(params);
   auto wheel_delta = wheelDeltaFromParams(params);
 
-  Camera *cam = findCamera(view_name);
+  Camera *cam = findCamera(view);
   if( cam )
     cam->move(
       Vector<float,2>(
@@ -302,19 +360,27 @@ void DefaultHidManager::heReplotQuick(int factor) {
     if( curve ) {
 
       GMlib::PERBSCurve<float> *erbs = dynamic_cast<GMlib::PERBSCurve<float>*>(curve);
+      MyERBSCurve *my_erbs = dynamic_cast<MyERBSCurve*>(curve);
       if( erbs )
         erbs->sample( (erbs->getLocalCurves().getDim()-1)*factor + 1, 1 );
+      else if( my_erbs )
+        my_erbs->sample( (my_erbs->getNumLocalCurves()-1)*factor + 1, 1 );
       else
         curve->sample( factor*factor*100, 2 );
     }
     else if( surf ) {
 
       GMlib::PERBSSurf<float> *erbs = dynamic_cast<GMlib::PERBSSurf<float>*>(surf);
+      MyERBSSurf *my_erbs = dynamic_cast<MyERBSSurf*>(surf);
       if( erbs )
         erbs->sample(
           (erbs->getLocalPatches().getDim1()-1)*factor + 1,
           (erbs->getLocalPatches().getDim2()-1)*factor + 1,
           2, 2 );
+      else if( my_erbs )
+        my_erbs->sampleAsync(
+          (my_erbs->getNumLocalPatchesU()-1)*factor + 1,
+          (my_erbs->getNumLocalPatchesV()-1)*factor + 1 );
       else {
         surf->sample( 10*factor, 10*factor, 2, 2 );
       }
@@ -339,11 +405,11 @@ void DefaultHidManager::heReplotQuickMedium() {
 
 void DefaultHidManager::heRotateSelectedObjects(const HidInputEvent::HidInputParams& params) {
 
-  auto view_name = viewNameFromParams(params);
-  auto pos       = toGMlibViewPoint(view_name, posFromParams(params));
-  auto prev      = toGMlibViewPoint(view_name, prevPosFromParams(params));
+  auto view      = viewFromParams(params);
+  auto pos       = toGMlibViewPoint(view, posFromParams(params));
+  auto prev      = toGMlibViewPoint(view, prevPosFromParams(params));
 
-  Camera *cam = findCamera(view_name);
+  Camera *cam = findCamera(view);
   if( !cam )
     return;
 
@@ -365,6 +431,7 @@ void DefaultHidManager::heRotateSelectedObjects(const HidInputEvent::HidInputPar
   for( int i = 0; i < objs.getSize(); ++i )
     if( objs(i)->getTypeId() != GM_SO_TYPE_SELECTOR )
       if( std::abs(pos(0)-prev(0)) > POS_TOLERANCE || std::abs(pos(1)-prev(1)) > POS_TOLERANCE ){
+          const EditJournal::Frame before = EditJournal::frameOf( objs(i) );
           if(no_objs==1 && objs(i)->isLocal())
               objs(i)->rotateGlobal(ang, rot_v);
           else {
@@ -372,16 +439,17 @@ void DefaultHidManager::heRotateSelectedObjects(const HidInputEvent::HidInputPar
               objs(i)->rotateGlobal(ang, rot_v);
               objs(i)->move(-mv_v);
           }
+          _journal->recordTransform( objs(i), before );
       }
 }
 
 void DefaultHidManager::heScaleSelectedObjects(const HidInputEvent::HidInputParams& params) {
 
-  auto view_name = viewNameFromParams(params);
-  auto pos       = toGMlibViewPoint(view_name, posFromParams(params));
-  auto prev      = toGMlibViewPoint(view_name, prevPosFromParams(params));
+  auto view      = viewFromParams(params);
+  auto pos       = toGMlibViewPoint(view, posFromParams(params));
+  auto prev      = toGMlibViewPoint(view, prevPosFromParams(params));
 
-  Camera *cam = findCamera(view_name);
+  Camera *cam = findCamera(view);
   if( !cam )
     return;
 
@@ -396,8 +464,12 @@ void DefaultHidManager::heScaleSelectedObjects(const HidInputEvent::HidInputPara
       ( ( pos(1) - prev(1) ) * dh ) * cam->getUp() );
 
 
-    if( deltav.getLength() < 1000.0f )
-      obj->scale( Vector<float,3>( 1.0f + deltav(1) ) );
+    if( deltav.getLength() < 1000.0f ) {
+      const EditJournal::Frame before = EditJournal::frameOf( obj );
+      const Vector<float,3> factor( 1.0f + deltav(1) );
+      obj->scale( factor );
+      _journal->recordTransform( obj, before, factor );
+    }
   }
 }
 
@@ -410,13 +482,26 @@ void DefaultHidManager::heSelectAllObjects() {
 
 void DefaultHidManager::heSelectObject(const HidInputEvent::HidInputParams& params) {
 
-  auto view_name = viewNameFromParams(params);
-  auto pos       = toGMlibViewPoint(view_name, posFromParams(params));
+  auto view      = viewFromParams(params);
+  auto pos       = toGMlibViewPoint(view, posFromParams(params));
 
-  auto obj = findSceneObject(view_name,pos);
+  auto obj = findSceneObject(view,pos);
   if( !obj )
     return;
 
+  // Control net; select the control under the cursor
+  ControlNetSelector *net = dynamic_cast<ControlNetSelector*>( obj );
+  if( net ) {
+
+    auto cam = findCamera(view);
+    const int k = cam ? net->pick( cam, pos ) : -1;
+    heDeSelectAllObjects();
+    net->clearControlSelection();
+    net->selectControl( k, true );
+    net->setSelected( k >= 0 );
+    return;
+  }
+
   // Preserver object selection
   auto selected = obj->isSelected();
   heDeSelectAllObjects();
@@ -426,10 +511,25 @@ void DefaultHidManager::heSelectObject(const HidInputEvent::HidInputParams& para
 
 void DefaultHidManager::heSelectObjects(const HidInputEvent::HidInputParams& params) {
 
-  auto view_name = viewNameFromParams(params);
-  auto pos       = toGMlibViewPoint(view_name, posFromParams(params));
+  auto view      = viewFromParams(params);
+  auto pos       = toGMlibViewPoint(view, posFromParams(params));
 
-  if( auto obj = findSceneObject(view_name,pos) ) obj->toggleSelected();
+  auto obj = findSceneObject(view,pos);
+  if( !obj )
+    return;
+
+  // Control net; toggle the control under the cursor
+  ControlNetSelector *net = dynamic_cast<ControlNetSelector*>( obj );
+  if( net ) {
+
+    auto cam = findCamera(view);
+    const int k = cam ? net->pick( cam, pos ) : -1;
+    net->selectControl( k, !net->isControlSelected(k) );
+    net->setSelected( net->selectedControls() > 0 );
+    return;
+  }
+
+  obj->toggleSelected();
 
 //  if(obj) obj->toggleSelected();
 }
@@ -475,15 +575,30 @@ void DefaultHidManager::heToggleSelectAllObjects() {
     heSelectAllObjects();
 }
 
+void DefaultHidManager::clearEditJournal() {
+
+  _journal->clear();
+}
+
+void DefaultHidManager::heUndo() {
+
+  _journal->undo();
+}
+
+void DefaultHidManager::heRedo() {
+
+  _journal->redo();
+}
+
 void DefaultHidManager::heZoom(const HidInputEvent::HidInputParams& params) {
 
-  auto view_name   = viewNameFromParams(params);
+  auto view        = viewFromParams(params);
   auto wheel_delta = wheelDeltaFromParams(params);
 
   // Qt comp scale
   wheel_delta /= 8;
 
-  Camera *cam    = findCamera(view_name);
+  Camera *cam    = findCamera(view);
   Camera *isocam = dynamic_cast<IsoCamera*>( cam );
 
   if( isocam ) {
@@ -504,6 +619,9 @@ void DefaultHidManager::heZoom(const HidInputEvent::HidInputParams& params) {
 void DefaultHidManager::heLeftMouseReleaseStuff() {
 
   //  _move_border = false;
+
+  // A drag is one undo step
+  _journal->endGesture();
 }
 
 void DefaultHidManager::heOpenCloseHidHelp() {
@@ -511,9 +629,12 @@ void DefaultHidManager::heOpenCloseHidHelp() {
   emit signOpenCloseHidHelp();
 }
 
-Camera* DefaultHidManager::findCamera( const QString& view_name ) const {
+Camera* DefaultHidManager::findCamera( int view ) const {
+
+  if( !_gmlib->isValidRCHandle(view) )
+    return nullptr;
 
-  return _gmlib->camera(view_name).get();
+  return _gmlib->camera(view).get();
 }
 
 
@@ -540,15 +661,20 @@ Scene* DefaultHidManager::scene() const {
   return _gmlib->scene().get();
 }
 
-SceneObject* DefaultHidManager::findSceneObject( const QString& view_name, const GMlib::Point<int,2>& pos  ) {
+SceneObject* DefaultHidManager::findSceneObject( int view, const GMlib::Point<int,2>& pos  ) {
 
+  if( !_gmlib->isValidRCHandle(view) )
+    return nullptr;
 
-  return _gmlib->findSceneObject( view_name, pos );
+  return _gmlib->findSceneObject( view, pos );
 }
 
-GMlib::Point<int,2> DefaultHidManager::toGMlibViewPoint(const QString& view_name, const QPoint &pos) {
+GMlib::Point<int,2> DefaultHidManager::toGMlibViewPoint(int view, const QPoint &pos) {
+
+  auto cam = findCamera(view);
+  if( !cam )
+    return Vector<int,2>( int(pos.x()), int(pos.y()) );
 
-  auto cam = findCamera(view_name);
   return Vector<int,2>( int(pos.x()), cam->getViewportH() - int(pos.y()) - 1 );
 }
 
@@ -563,25 +689,29 @@ void DefaultHidManager::setupDefaultHidBindings() {
                         "Move the camera. "
                         "If not locked to the scene, it will pan the camera in the view plane. "
                         "If locked it will rotate the camera about the center of the scene." ,
-                        this, SLOT(heMoveCamera(HidInputEvent::HidInputParams)) );
+                        this, SLOT(heMoveCamera(HidInputEvent::HidInputParams)),
+                        SYNC_TRIGGER);
 
   QString ha_id_view_pan_h =
       registerHidAction("View",
                         "Pan Horizontally",
                         "Pan horizontally",
-                        this, SLOT(hePanHorizontal(HidInputEvent::HidInputParams)) );
+                        this, SLOT(hePanHorizontal(HidInputEvent::HidInputParams)),
+                        SYNC_TRIGGER);
 
   QString ha_id_view_pan_v =
       registerHidAction("View",
                         "Pan Vertically",
                         "Pan vertically",
-                        this, SLOT(hePanVertical(HidInputEvent::HidInputParams)) );
+                        this, SLOT(hePanVertical(HidInputEvent::HidInputParams)),
+                        SYNC_TRIGGER);
 
   QString ha_id_view_zoom=
       registerHidAction("View",
                         "Zoom",
                         "Zoom",
-                        this, SLOT(heZoom(HidInputEvent::HidInputParams)) );
+                        this, SLOT(heZoom(HidInputEvent::HidInputParams)),
+                        SYNC_TRIGGER);
 
   QString ha_id_view_lock_to =
       registerHidAction("View",
@@ -595,7 +725,8 @@ void DefaultHidManager::setupDefaultHidBindings() {
       registerHidAction("Object transformation",
                         "Scale Objects",
                         "Scale objects",
-                        this, SLOT(heScaleSelectedObjects(HidInputEvent::HidInputParams)) );
+                        this, SLOT(heScaleSelectedObjects(HidInputEvent::HidInputParams)),
+                        SYNC_TRIGGER);
 
   QString ha_id_objtrans_move =
       registerHidAction("Object transformation",
@@ -608,14 +739,16 @@ void DefaultHidManager::setupDefaultHidBindings() {
       registerHidAction("Object transformation",
                         "Rotate Objects",
                         "Rotate objects",
-                        this, SLOT(heRotateSelectedObjects(HidInputEvent::HidInputParams)) );
+                        this, SLOT(heRotateSelectedObjects(HidInputEvent::HidInputParams)),
+                        SYNC_TRIGGER);
 
   // Object Selection
   QString ha_id_objsel_toggle_all =
       registerHidAction("Object selection",
                         "Toggle: (de)select all objects",
                         "Toggle selection on all objects",
-                        this, SLOT(heToggleSelectAllObjects()) );
+                        this, SLOT(heToggleSelectAllObjects()),
+                        SYNC_TRIGGER);
 
   QString ha_id_objsel_select =
       registerHidAction("Object selection",
@@ -688,6 +821,20 @@ void DefaultHidManager::setupDefaultHidBindings() {
                          this, SLOT(heReplotQuickLow()),
                          OGL_TRIGGER);
 
+  QString ha_id_objint_undo =
+      registerHidAction( "Object interaction",
+                         "Undo",
+                         "Undo the last move, rotation, scaling or control point edit",
+                         this, SLOT(heUndo()),
+                         SYNC_TRIGGER);
+
+  QString ha_id_objint_redo =
+      registerHidAction( "Object interaction",
+                         "Redo",
+                         "Redo the last undone edit",
+                         this, SLOT(heRedo()),
+                         SYNC_TRIGGER);
+
 
   // Rendering
   QString ha_id_render_toggle_shademode =
@@ -716,7 +863,8 @@ void DefaultHidManager::setupDefaultHidBindings() {
       registerHidAction( "Various",
                          "Left Mouse Release",
                          "Stuff that happens on left mouse release",
-                         this, SLOT(heLeftMouseReleaseStuff()) );
+                         this, SLOT(heLeftMouseReleaseStuff()),
+                         SYNC_TRIGGER);
 
 
 
@@ -731,6 +879,8 @@ void DefaultHidManager::setupDefaultHidBindings() {
   registerHidMapping( ha_id_objint_replot_high,           new KeyPressInput( Qt::Key_P, Qt::ShiftModifier ) );
   registerHidMapping( ha_id_objint_replot_med,            new KeyPressInput( Qt::Key_P ) );
   registerHidMapping( ha_id_objint_replot_low,            new KeyPressInput( Qt::Key_P, Qt::ControlModifier) );
+  registerHidMapping( ha_id_objint_undo,                  new KeyPressInput( Qt::Key_U, Qt::ControlModifier) );
+  registerHidMapping( ha_id_objint_redo,                  new KeyPressInput( Qt::Key_Y, Qt::ControlModifier) );
   registerHidMapping( ha_id_sim_toggle,                   new KeyPressInput( Qt::Key_R ) );
   registerHidMapping( ha_id_render_toggle_shademode,      new KeyPressInput( Qt::Key_Z ) );
 
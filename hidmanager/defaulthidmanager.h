@@ -4,10 +4,13 @@
 #include "standardhidmanager.h"
 
 
+#include <memory>
+#include <mutex>
 #include <queue>
 
 // local
 class GMlibWrapper;
+class EditJournal;
 
 
 class DefaultHidManager : public StandardHidManager {
@@ -16,14 +19,21 @@ public:
   explicit DefaultHidManager( QObject* parent = Q_NULLPTR );
   virtual ~DefaultHidManager() override;
 
-  static const unsigned int   OGL_TRIGGER {8};
+  // Deferred triggers; actions are queued and executed at the next scene graph
+  // synchronization point, where the GUI thread is blocked (scene access is exclusive)
+  // and the OpenGL context is bound.
+  static const unsigned int   OGL_TRIGGER {8};    // Needs the OpenGL context (and scene access)
+  static const unsigned int   SYNC_TRIGGER {16};  // Mutates the scene (cameras, objects)
 
   void                        setupDefaultHidBindings();
 
   void                        init( GMlibWrapper& gmlib );
 
+  // Forget the undo history; before the edited objects are removed or the scene is cleared
+  void                        clearEditJournal();
+
 public slots:
-  void                        triggerOGLActions();
+  void                        triggerDeferredActions();
 
 protected:
   void                        triggerAction(const HidAction *action, const HidInputEvent::HidInputParams &params) override;
@@ -57,6 +67,8 @@ public slots:
   virtual void                      heToggleObjectDisplayMode();
   virtual void                      heToggleSimulation();
   virtual void                      heToggleSelectAllObjects();
+  virtual void                      heUndo();
+  virtual void                      heRedo();
 //  virtual void                      heUnlockCamera();
   virtual void                      heZoom( const HidInputEvent::HidInputParams& params );
 
@@ -64,16 +76,18 @@ public slots:
   virtual void                      heOpenCloseHidHelp();
 
 private:
-  GMlib::Camera*                    findCamera( const QString& view_name ) const;
+  GMlib::Camera*                    findCamera( int view ) const;
   float                             cameraSpeedScale( GMlib::Camera* cam ) const;
   GMlib::Scene*                     scene() const;
-  GMlib::SceneObject*               findSceneObject(const QString& view_name, const GMlib::Point<int,2>& pos);
+  GMlib::SceneObject*               findSceneObject(int view, const GMlib::Point<int,2>& pos);
 
-  GMlib::Point<int,2>               toGMlibViewPoint(const QString& view_name, const QPoint& pos);
+  GMlib::Point<int,2>               toGMlibViewPoint(int view, const QPoint& pos);
 
   GMlibWrapper*                     _gmlib;
+  std::unique_ptr<EditJournal>      _journal;
 
-  std::queue<std::pair<const HidAction*,HidInputEvent::HidInputParams>>   _ogl_actions;
+  std::queue<std::pair<const HidAction*,HidInputEvent::HidInputParams>>   _deferred_actions;
+  std::mutex                                                              _deferred_actions_mutex;
 
 
 };
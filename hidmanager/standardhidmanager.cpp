@@ -30,10 +30,10 @@ StandardHidManager::StandardHidManager( QObject* parent )
 }
 
 
-void StandardHidManager::registerKeyPressEvent(const QString& name, QKeyEvent *e) {
+void StandardHidManager::registerKeyPressEvent(int view, QKeyEvent *e) {
 
 //  std::lock_guard<std::mutex> lk(_input_mutex);
-  registerRCPairName( name );
+  registerRCPairHandle( view );
   registerKey( Qt::Key(e->key()), e->modifiers() );
   registerKeyEventType( KEY_PRESS );
   generateEvent();
@@ -48,10 +48,10 @@ void StandardHidManager::registerWindowPosition( const QPoint& pos ) {
 }
 
 
-void StandardHidManager::registerKeyReleaseEvent(const QString& name, QKeyEvent *e) {
+void StandardHidManager::registerKeyReleaseEvent(int view, QKeyEvent *e) {
 
 //  std::lock_guard<std::mutex> lk(_input_mutex);
-  registerRCPairName( name );
+  registerRCPairHandle( view );
   unregisterKey( Qt::Key(e->key()), e->modifiers() );
   registerKeyEventType( KEY_RELEASE );
 
@@ -59,10 +59,10 @@ void StandardHidManager::registerKeyReleaseEvent(const QString& name, QKeyEvent
 }
 
 
-void StandardHidManager::registerMouseDoubleClickEvent(const QString& name, QMouseEvent* e ) {
+void StandardHidManager::registerMouseDoubleClickEvent(int view, QMouseEvent* e ) {
 
 //  std::lock_guard<std::mutex> lk(_input_mutex);
-  registerRCPairName( name );
+  registerRCPairHandle( view );
   registerWindowPosition( e->pos() );
   registerMouseButtons( e->buttons(), e->modifiers() );
   registerMouseEventType( MOUSE_DBL_CLICK );
@@ -71,10 +71,10 @@ void StandardHidManager::registerMouseDoubleClickEvent(const QString& name, QMou
 }
 
 
-void StandardHidManager::registerMouseMoveEvent(const QString& name, QMouseEvent* e) {
+void StandardHidManager::registerMouseMoveEvent(int view, QMouseEvent* e) {
 
 //  std::lock_guard<std::mutex> lk(_input_mutex);
-  registerRCPairName( name );
+  registerRCPairHandle( view );
   registerWindowPosition( e->pos() );
   registerMouseEventType( MOUSE_MOVE );
 
@@ -82,10 +82,10 @@ void StandardHidManager::registerMouseMoveEvent(const QString& name, QMouseEvent
 }
 
 
-void StandardHidManager::registerMousePressEvent(const QString& name, QMouseEvent* e) {
+void StandardHidManager::registerMousePressEvent(int view, QMouseEvent* e) {
 
 //  std::lock_guard<std::mutex> lk(_input_mutex);
-  registerRCPairName( name );
+  registerRCPairHandle( view );
   registerWindowPosition( e->pos() );
   registerMouseButtons( e->buttons(), e->modifiers() );
   registerMouseEventType( MOUSE_CLICK );
@@ -94,10 +94,10 @@ void StandardHidManager::registerMousePressEvent(const QString& name, QMouseEven
 }
 
 
-void StandardHidManager::registerMouseReleaseEvent(const QString& name, QMouseEvent* e){
+void StandardHidManager::registerMouseReleaseEvent(int view, QMouseEvent* e){
 
 //  std::lock_guard<std::mutex> lk(_input_mutex);
-  registerRCPairName( name );
+  registerRCPairHandle( view );
   registerWindowPosition( e->pos() );
   registerMouseButtons( e->buttons(), e->modifiers() );
   registerMouseEventType( MOUSE_RELEASE );
@@ -158,10 +158,10 @@ void StandardHidManager::registerWheelData(bool state, int delta) {
 }
 
 
-void StandardHidManager::registerWheelEvent(const QString& name, QWheelEvent *e) {
+void StandardHidManager::registerWheelEvent(int view, QWheelEvent *e) {
 
   // Save position and wheel delta
-  registerRCPairName( name );
+  registerRCPairHandle( view );
   registerWindowPosition( e->pos() );
   registerWheelData( true, e->angleDelta().y() );
 
@@ -169,9 +169,9 @@ void StandardHidManager::registerWheelEvent(const QString& name, QWheelEvent *e)
 }
 
 
-QString
-StandardHidManager::viewNameFromParams(const HidInputEvent::HidInputParams& params) {
-  return params["view_name"].toString();
+int
+StandardHidManager::viewFromParams(const HidInputEvent::HidInputParams& params) {
+  return params.value(QStringLiteral("view"),-1).toInt();
 }
 
 
@@ -227,8 +227,7 @@ bool StandardHidManager::isMouseButtonRegistered(Qt::MouseButton button) const {
 
 void StandardHidManager::generateEvent() {
 
-  HidInputEvent::HidInputParams params;
-  params["view_name"] = QVariant( _reg_rcpair_name );
+  HidInputEvent::HidInputParams params {_reg_view_params};
 
   HidInputEvent::HidInputParams key_params {params};
 
@@ -287,8 +286,12 @@ void StandardHidManager::generateEvent() {
 }
 
 
-void StandardHidManager::registerRCPairName(const QString& name) {
-  _reg_rcpair_name = name;
+void StandardHidManager::registerRCPairHandle(int view) {
+
+  // The events share the view parameter; only set again when the view changes
+  if( view == _reg_rcpair && !_reg_view_params.isEmpty() ) return;
+  _reg_rcpair = view;
+  _reg_view_params[QStringLiteral("view")] = QVariant( _reg_rcpair );
 }
 
 
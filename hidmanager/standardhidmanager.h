@@ -27,16 +27,16 @@ public:
   // Standard Hid manager setup
 
 public slots:
-  virtual void                registerMousePressEvent( const QString& name, QMouseEvent* event );
-  virtual void                registerMouseReleaseEvent( const QString& name, QMouseEvent* event );
-  virtual void                registerMouseDoubleClickEvent(  const QString& name, QMouseEvent* event );
-  virtual void                registerMouseMoveEvent( const QString& name, QMouseEvent* event );
-  virtual void                registerKeyPressEvent( const QString& name, QKeyEvent* event );
-  virtual void                registerKeyReleaseEvent( const QString& name,  QKeyEvent* event );
-  virtual void                registerWheelEvent( const QString& name, QWheelEvent* event );
+  virtual void                registerMousePressEvent( int view, QMouseEvent* event );
+  virtual void                registerMouseReleaseEvent( int view, QMouseEvent* event );
+  virtual void                registerMouseDoubleClickEvent(  int view, QMouseEvent* event );
+  virtual void                registerMouseMoveEvent( int view, QMouseEvent* event );
+  virtual void                registerKeyPressEvent( int view, QKeyEvent* event );
+  virtual void                registerKeyReleaseEvent( int view, QKeyEvent* event );
+  virtual void                registerWheelEvent( int view, QWheelEvent* event );
 
 protected:
-  static QString              viewNameFromParams( const HidInputEvent::HidInputParams& params );
+  static int                  viewFromParams( const HidInputEvent::HidInputParams& params );
   static QPoint               posFromParams( const HidInputEvent::HidInputParams& params );
   static QPoint               prevPosFromParams( const HidInputEvent::HidInputParams& params );
   static int                  wheelDeltaFromParams( const HidInputEvent::HidInputParams& params );
@@ -68,7 +68,7 @@ private:
                                                     Qt::KeyboardModifiers modifiers );
   void                        registerWheelData( bool state, int delta );
   void                        registerWindowPosition(const QPoint& pos );
-  void                        registerRCPairName( const QString& name );
+  void                        registerRCPairHandle( int view );
 
   KeyInput::Keymap            _reg_keymap;
   Qt::KeyboardModifiers       _reg_keymods;
@@ -79,7 +79,8 @@ private:
   bool                        _reg_wheel_state;
   int                         _reg_wheel_delta;
 
-  QString                     _reg_rcpair_name    = {""};    // Current view name
+  int                         _reg_rcpair         = {-1};    // Current view (render/camera pair handle)
+  HidInputEvent::HidInputParams _reg_view_params;              // The "view" parameter of _reg_rcpair; set when the view changes
   QPoint                      _reg_view_pos       = {0,0};
   QPoint                      _reg_view_prev_pos  = {0,0};
 
@@ -9,6 +9,7 @@
 #include <scene/light/gmpointlight.h>
 #include <scene/sceneobjects/gmpathtrack.h>
 #include <scene/sceneobjects/gmpathtrackarrows.h>
+#include <parametrics/surfaces/gmptorus.h>
 
 // qt
 #include <QQuickItem>
@@ -17,6 +18,17 @@
 #include "work/mybspline.h"
 #include "work/closedsubdivisioncurve.h"
 #include "work/torusknot.h"
+#include "work/myclosedbspline.h"
+#include "work/streamingfitter.h"
+#include "work/curvaturecombvisualizer.h"
+#include "work/myerbscurve.h"
+#include "work/myerbssurf.h"
+#include "work/beziertriangles.h"
+#include "work/quantizedvisualizers.h"
+#include "work/collisiondetector.h"
+#include "work/distancefield.h"
+#include "work/memorybudget.h"
+#include "work/streamring.h"
 
 template <typename T>
 inline std::ostream &operator<<(std::ostream &out, const std::vector<T> &v)
@@ -31,6 +43,9 @@ inline std::ostream &operator<<(std::ostream &out, const std::vector<T> &v)
 void Scenario::initializeScenario()
 {
 
+  // Streaming uploads; 4 MiB per frame in flight
+  StreamRing::initShared(size_t(4) << 20);
+
   // Insert a light
   GMlib::Point<GLfloat, 3> init_light_pos(2.0, 4.0, 10);
   GMlib::PointLight *light = new GMlib::PointLight(GMlib::GMcolor::white(), GMlib::GMcolor::white(),
@@ -70,8 +85,10 @@ void Scenario::initializeScenario()
 
   // Create B-spline curve
   auto myBspline = new MyB_spline(controlPoints);
+  myBspline->setUniformSpeed(true);
   myBspline->toggleDefaultVisualizer();
-  myBspline->sample(100);
+  myBspline->insertVisualizer(new CurvatureCombVisualizer);
+  myBspline->sample(100, 3); // Curvature combs need the 2nd (and for torsion the 3rd) derivative
 
   // 2
   GMlib::DVector<GMlib::Vector<float, 3>> rectPoints(4, GMlib::Vector<float, 3>(0.0f, 0.0f, 0.0f));
@@ -85,17 +102,130 @@ void Scenario::initializeScenario()
 
   // 3
   auto torusKnot = new TorusKnot();
+  torusKnot->setUniformSpeed(true); // Equally spaced samples; no bunching on the outer loops
   torusKnot->toggleDefaultVisualizer();
-  torusKnot->sample(500);
+  torusKnot->insertVisualizer(new CurvatureCombVisualizer(0.1f));
+  torusKnot->sample(350, 3);
+
+  // 4
+  // Closed scan contour; a noisy, lumpy ellipse fitted by a periodic B-spline
+  const int scanSize = 2000;
+  GMlib::DVector<GMlib::Vector<float, 3>> scanPoints(scanSize);
+  for (int i = 0; i < scanSize; ++i) {
+    const float a = 2.0f * float(M_PI) * i / scanSize;
+    const float r = 1.0f + 0.15f * std::sin(5.0f * a) + 0.01f * std::sin(97.0f * a); // Lumps plus "noise"
+    scanPoints[i] = GMlib::Vector<float, 3>(3.0f + 1.5f * r * std::cos(a), r * std::sin(a), 0.0f);
+  }
+  auto contour = new MyClosedB_spline(scanPoints, 60);
+  contour->toggleDefaultVisualizer();
+  contour->sample(300);
+
+  // 5
+  // Streamed input; a digitizer trace fitted on the fly (recursive least squares)
+  auto stream = new MyB_spline(GMlib::DVector<GMlib::Vector<float, 3>>(3, GMlib::Vector<float, 3>(0.0f, 0.0f, 0.0f)));
+  StreamingFitter fitter(stream, 0.25f);
+  fitter.setSpansChanged([stream](float, float) { stream->setEditDone(); }); // Deferred (partial) replot
+  for (int i = 0; i < 3000; ++i) {
+    const float a = 0.004f * i;
+    fitter.addPoint(GMlib::Vector<float, 3>(-4.0f + 0.3f * a * std::cos(3.0f * a), 0.3f * a * std::sin(3.0f * a), 0.0f));
+  }
+  stream->insertVisualizer(new QuantizedCurveVisualizer); // Replots stream through the StreamRing
+  stream->sample(fitter.sampleCount(8), 1);                // Fixed spacing; a longer trace only adds samples
+
+  // 6
+  // ERBS curve over the torus knot; MyB_spline local curves blended by the tabulated ERBS function
+  auto erbsKnot = new MyERBSCurve(torusKnot, 24);
+  erbsKnot->translate(GMlib::Vector<float, 3>(0.0f, 0.0f, 4.0f));
+  erbsKnot->insertVisualizer(new QuantizedCurveVisualizer); // 12 byte vertices, tangent shaded
+  erbsKnot->sampleQuantized(24 * 10 + 1);                   // Encoded as evaluated; no float samples
+
+  // 7
+  // ERBS surface over a torus; bicubic local patches, tessellated in parallel tiles straight
+  // into 12 byte vertices (16 bit positions, octahedral normals) decoded in the vertex shader
+  GMlib::PTorus<float> torus(3.0f, 1.0f, 1.0f);
+  auto erbsTorus = new MyERBSSurf(&torus, 12, 8);
+  erbsTorus->translate(GMlib::Vector<float, 3>(0.0f, -10.0f, 0.0f));
+  erbsTorus->insertVisualizer(new QuantizedSurfaceVisualizer);
+  erbsTorus->sampleQuantized(12 * 10 + 1, 8 * 10 + 1);
+
+  // 8
+  // Pyramid of four cubic Bezier triangles, the faces bulged by their inner control point;
+  // tessellated as one batch into one quantized mesh
+  const GMlib::Vector<float, 3> apex(0.0f, 0.0f, 2.0f);
+  std::vector<BezierTriangles::Net> faces;
+  for (int f = 0; f < 4; ++f) {
+    const float a0 = 0.5f * float(M_PI) * f, a1 = 0.5f * float(M_PI) * (f + 1);
+    const GMlib::Vector<float, 3> b(2.0f * std::cos(a0), 2.0f * std::sin(a0), 0.0f);
+    const GMlib::Vector<float, 3> c(2.0f * std::cos(a1), 2.0f * std::sin(a1), 0.0f);
+
+    BezierTriangles::Net net(BezierTriangleTessellator::netSize(3));
+    int n = 0;
+    for (int i = 3; i >= 0; --i)
+      for (int j = 3 - i; j >= 0; --j, ++n) {
+        const int k = 3 - i - j;
+        net[n] = (apex * float(i) + b * float(j) + c * float(k)) * (1.0f / 3.0f); // Flat face
+        if (i > 0 && j > 0 && k > 0)
+          net[n] += GMlib::Vector<float, 3>(b(0) + c(0), b(1) + c(1), 1.0f) * 0.3f; // Outwards
+      }
+    faces.push_back(net);
+  }
+  auto pyramid = new BezierTriangles(faces, 3, 4);
+  pyramid->translate(GMlib::Vector<float, 3>(0.0f, 8.0f, 0.0f));
+  pyramid->insertVisualizer(new QuantizedSurfaceVisualizer);
 
   // Comment out what shouldn't be rendered
   this->scene()->insert(myBspline);
   this->scene()->insert(rect);
   this->scene()->insert(torusKnot);
+  this->scene()->insert(contour);
+  this->scene()->insert(stream);
+  this->scene()->insert(erbsKnot);
+  this->scene()->insert(erbsTorus);
+  this->scene()->insert(pyramid);
+
+  // Contacts between the objects above, e.g. when one is moved onto another
+  _collisions = std::make_shared<CollisionDetector>(0.05f);
+  _collisions->add(myBspline, 200);
+  _collisions->add(torusKnot, 700);
+  _collisions->add(contour, 600);
+  _collisions->add(erbsKnot, 700);
+  _collisions->add(erbsTorus, 60, 40);
+  _collisions->setCallback([this](const CollisionDetector::Contact& c, CollisionDetector::State state) {
+    emit signContact(c.a->getName(), c.b->getName(), state == CollisionDetector::State::Began);
+  });
+
+  // Signed distance field around the closed curves in the xy plane (the rectangle and the
+  // scan contour); 1/64 cells over [-2,5] x [-2,2]
+  _clearance = std::make_shared<DistanceField>(DistanceField::Point(-2.0f, -2.0f, 0.0f), 1.0f / 64, 7 * 64, 4 * 64);
+  _clearance_curves = {rect, contour};
+  buildClearance();
+}
+
+void Scenario::buildClearance()
+{
+  _clearance->clearSegments();
+  for (auto curve : _clearance_curves)
+    _clearance->addCurve(*curve, 1000);
+  _clearance->build(true);
+}
+
+float Scenario::clearance(const GMlib::Point<float, 3> &p) const
+{
+  return _clearance ? _clearance->sample(DistanceField::Point(p)) : std::numeric_limits<float>::infinity();
 }
 
 void Scenario::cleanupScenario()
 {
+  _collisions.reset();
+  _clearance.reset();
+  _clearance_curves.clear();
+  StreamRing::releaseShared();
+}
+
+void Scenario::simulateScenario()
+{
+  if (_collisions)
+    _collisions->update();
 }
 
 void Scenario::callDefferedGL()
@@ -107,4 +237,61 @@ void Scenario::callDefferedGL()
   for (int i = 0; i < e_obj.getSize(); i++)
     if (e_obj(i)->isVisible())
       e_obj[i]->replot();
+
+  // Edited geometry (a moved control point or local patch, a refit); the object and the
+  // objects it is a part of are sampled again
+  if (_collisions)
+    for (int i = 0; i < e_obj.getSize(); i++)
+      for (const GMlib::SceneObject *obj = e_obj(i); obj; obj = obj->getParent())
+        _collisions->refresh(obj);
+
+  // The distance field is rebuilt as a whole, once however many of its curves moved
+  if (_clearance) {
+    bool rebuild = false;
+    for (int i = 0; i < e_obj.getSize(); i++)
+      for (const GMlib::SceneObject *obj = e_obj(i); obj; obj = obj->getParent())
+        rebuild |= std::find(_clearance_curves.begin(), _clearance_curves.end(), obj) != _clearance_curves.end();
+    if (rebuild)
+      buildClearance();
+  }
+
+  // Caches are only evicted here, where nothing else touches them
+  MemoryBudget::shared().collect();
+  updateMemoryUsage();
+}
+
+void Scenario::endUploadFrame()
+{
+  if (StreamRing *ring = StreamRing::shared())
+    ring->endFrame();
+}
+
+QString Scenario::memoryUsage() const
+{
+  std::lock_guard<std::mutex> lk(_memory_usage_mutex);
+  return _memory_usage;
+}
+
+void Scenario::updateMemoryUsage()
+{
+  const auto mib = [](size_t bytes) { return QString::number(bytes / double(1 << 20), 'f', 1); };
+
+  // Only rebuilt (and emitted) when the budget changed since the last frame
+  MemoryBudget &budget = MemoryBudget::shared();
+  const std::uint64_t version = budget.version();
+  if (version == _memory_usage_version)
+    return;
+  _memory_usage_version = version;
+
+  QString text = QString("Memory: %1 / %2 MiB").arg(mib(budget.used()), mib(budget.cap()));
+  for (const auto &u : budget.usage())
+    text += QString("\n  %1: %2 MiB").arg(QString::fromStdString(u.first), mib(u.second));
+
+  {
+    std::lock_guard<std::mutex> lk(_memory_usage_mutex);
+    if (text == _memory_usage)
+      return;
+    _memory_usage = text;
+  }
+  emit signMemoryUsageChanged();
 }
@@ -6,22 +6,68 @@
 
 // qt
 #include <QObject>
+#include <QString>
+
+// stl
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class CollisionDetector;
+class DistanceField;
+
+namespace GMlib {
+
+  template<typename T, int n>
+  class PCurve;
+}
 
 
 
 
 class Scenario : public GMlibWrapper {
   Q_OBJECT
+  Q_PROPERTY(QString memoryUsage READ memoryUsage NOTIFY signMemoryUsageChanged)
 public:
   using GMlibWrapper::GMlibWrapper;
 
   void    initializeScenario() override;
   void    cleanupScenario() override;
 
+  // Memory budget use, total and per subsystem; for the overlay
+  QString memoryUsage() const;
+
+  // Signed distance in the xy plane to the closed planar curves (negative inside), for
+  // offsets and proximity queries; clamped to the field's grid. Render thread, as
+  // callDefferedGL(), which rebuilds the field when one of the curves is edited.
+  float   clearance(const GMlib::Point<float,3>& p) const;
+
 public slots:
   void    callDefferedGL();
+  void    endUploadFrame();
+
+signals:
+  void    signMemoryUsageChanged();
+
+  // A contact between two scene objects (GMlib names) began or ended; emitted from the
+  // simulation step, so connections to other threads are queued
+  void    signContact(unsigned int a, unsigned int b, bool began);
+
+protected:
+  void    simulateScenario() override;
 
 private:
+  std::shared_ptr<CollisionDetector>  _collisions;
+  std::shared_ptr<DistanceField>      _clearance;
+  std::vector<GMlib::PCurve<float,3>*> _clearance_curves;
+
+  mutable std::mutex                  _memory_usage_mutex;
+  QString                             _memory_usage;
+  std::uint64_t                       _memory_usage_version {~std::uint64_t(0)};   // Budget version of _memory_usage; render thread
+
+  void    updateMemoryUsage();
+  void    buildClearance();
 };
 
 
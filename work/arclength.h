@@ -0,0 +1,187 @@
+#ifndef ARC_LENGTH_H
+#define ARC_LENGTH_H
+
+#include <core/containers/gmdvector.h>
+#include <core/types/gmpoint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <vector>
+
+/*!
+ *  ArcLength<T>
+ *
+ *  Arc length service for analytic parametric curves.
+ *
+ *  - The parameter domain is split into pieces; the curve's spans (e.g. knot spans),
+ *    each subdivided a number of times.
+ *  - The length of each piece is integrated by Gauss-Legendre quadrature over the
+ *    curve's speed |c'(t)|; the cumulative lengths form a monotone lookup table.
+ *  - A distance-to-parameter query finds its piece by binary search, O(log n), and
+ *    inverts s(t) inside the piece by a safeguarded Newton iteration seeded by linear
+ *    interpolation in the table.
+ */
+template <typename T>
+class ArcLength {
+public:
+  using SpeedFunction = std::function<T(T)>;
+
+  // Build the table; breaks are the span boundaries t_0 < t_1 < ... < t_n
+  void build(SpeedFunction speed, const std::vector<T>& breaks, int subdivisions = 4) {
+
+    _speed = std::move(speed);
+    _t.clear();
+    _s.clear();
+
+    if(breaks.size() < 2) return;
+
+    const int sub = std::max(subdivisions, 1);
+    _t.reserve((breaks.size() - 1) * size_t(sub) + 1);
+    for(size_t i = 0; i + 1 < breaks.size(); ++i) {
+
+      if(breaks[i + 1] <= breaks[i]) continue;   // Repeated knots
+      for(int j = 0; j < sub; ++j)
+        _t.push_back(breaks[i] + (breaks[i + 1] - breaks[i]) * T(j) / T(sub));
+    }
+    _t.push_back(breaks.back());
+
+    _s.resize(_t.size());
+    _s[0] = T(0);
+    for(size_t k = 1; k < _t.size(); ++k)
+      _s[k] = _s[k - 1] + integrate(_t[k - 1], _t[k]);
+  }
+
+  // Uniform spans over [a, b]
+  void build(SpeedFunction speed, T a, T b, int spans, int subdivisions = 4) {
+
+    std::vector<T> breaks(size_t(std::max(spans, 1)) + 1);
+    for(size_t i = 0; i < breaks.size(); ++i)
+      breaks[i] = a + (b - a) * T(i) / T(breaks.size() - 1);
+
+    build(std::move(speed), breaks, subdivisions);
+  }
+
+  bool isValid() const { return _t.size() > 1; }
+
+  T length() const { return isValid() ? _s.back() : T(0); }
+
+  T startParameter() const { return _t.front(); }
+  T endParameter() const { return _t.back(); }
+
+  // Arc length from the start of the domain to t
+  T length(T t) const {
+
+    const auto k = piece(t, _t);
+    return _s[k] + integrate(_t[k], std::min(std::max(t, _t[k]), _t[k + 1]));
+  }
+
+  // Parameter value at arc length s, s in [0, length()]
+  T parameter(T s) const {
+
+    if(s <= T(0))     return _t.front();
+    if(s >= length()) return _t.back();
+
+    const auto k = piece(s, _s);
+    T a = _t[k], b = _t[k + 1];
+    const T s0 = _s[k], ds = s - s0;
+
+    // Seed; linear in the table
+    T t = a + (b - a) * ds / (_s[k + 1] - s0);
+
+    // Newton on f(t) = s(t) - s, safeguarded by bisection on the bracket [a, b]
+    const T tol = (b - a) * T(1e-6);
+    for(int i = 0; i < MaxNewtonIterations; ++i) {
+
+      const T f = integrate(_t[k], t) - ds;
+      if(f == T(0)) return t;       // Exact, e.g. the seed at constant speed
+      if(f > T(0)) b = t; else a = t;
+
+      const T v = _speed(t);
+      T tn = (v > T(0)) ? t - f / v : T(0.5) * (a + b);
+      if(tn < a || tn > b) tn = T(0.5) * (a + b);
+
+      const bool done = std::abs(tn - t) < tol;
+      t = tn;
+      if(done) break;
+    }
+
+    return t;
+  }
+
+  // m parameter values giving equal arc length distances between consecutive samples
+  std::vector<T> uniformParameters(int m) const {
+
+    std::vector<T> t(size_t(std::max(m, 2)));
+    for(size_t i = 0; i < t.size(); ++i)
+      t[i] = parameter(length() * T(i) / T(t.size() - 1));
+    return t;
+  }
+
+  /*!
+   *  toUniformSpeed(p, dt_du, d)
+   *
+   *  - Converts the position and derivatives p[0..d] of c(t) into those of the
+   *    reparametrized curve c(t(u)), where dt/du = dt_du / |c'(t)|; i.e. a curve
+   *    with constant speed dt_du.
+   *  - Supports d <= 3.
+   */
+  template <int n>
+  static void toUniformSpeed(GMlib::DVector<GMlib::Vector<T,n>>& p, T dt_du, int d) {
+
+    if(d < 1) return;
+
+    const GMlib::Vector<T,n> c1 = p[1];
+    const T speed = c1.getLength();
+    if(speed <= T(0)) return;
+
+    const T s2 = speed * speed, s4 = s2 * s2;
+    const T q  = dt_du / speed;                 // dt/du
+    p[1] = c1 * q;
+
+    if(d > 1) {
+      const GMlib::Vector<T,n> c2 = p[2];
+      const T c12 = c1 * c2;
+      const T dq  = -dt_du * dt_du * c12 / s4;  // d^2t/du^2
+      p[2] = c2 * (q * q) + c1 * dq;
+
+      if(d > 2) {
+        // d^3t/du^3 = -dt_du^2 d/dt[(c'.c'') / |c'|^4] dt/du
+        const T g   = (c2 * c2 + c1 * p[3]) / s4 - T(4) * c12 * c12 / (s4 * s2);
+        const T ddq = -dt_du * dt_du * g * q;
+        p[3] = p[3] * (q * q * q) + c2 * (T(3) * q * dq) + c1 * ddq;
+      }
+    }
+  }
+
+private:
+  static constexpr int MaxNewtonIterations = 8;
+
+  SpeedFunction   _speed;
+  std::vector<T>  _t;       // Piece boundaries (parameter)
+  std::vector<T>  _s;       // Cumulative arc length at the piece boundaries; monotone
+
+  // Index k of the piece with v[k] <= x < v[k+1]
+  static size_t piece(T x, const std::vector<T>& v) {
+
+    auto itr = std::upper_bound(v.begin(), v.end(), x);
+    auto k   = size_t(std::max<std::ptrdiff_t>(itr - v.begin() - 1, 0));
+    return std::min(k, v.size() - 2);
+  }
+
+  // 5-point Gauss-Legendre quadrature of the speed over [a, b]; exact for polynomials of degree 9
+  T integrate(T a, T b) const {
+
+    static const T x[5] = { T(0), T(-0.5384693101056831), T(0.5384693101056831),
+                            T(-0.9061798459386640), T(0.9061798459386640) };
+    static const T w[5] = { T(0.5688888888888889), T(0.4786286704993665), T(0.4786286704993665),
+                            T(0.2369268850561891), T(0.2369268850561891) };
+
+    const T h = T(0.5) * (b - a), m = T(0.5) * (a + b);
+    T sum = T(0);
+    for(int i = 0; i < 5; ++i) sum += w[i] * _speed(m + h * x[i]);
+    return sum * h;
+  }
+};
+
+#endif // ARC_LENGTH_H
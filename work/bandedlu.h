@@ -0,0 +1,106 @@
+#ifndef BANDED_LU_H
+#define BANDED_LU_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+/*!
+ *  BandedLU<T>
+ *
+ *  LU factorization and solver for banded n x n matrices; kl sub- and ku super-diagonals.
+ *
+ *  - Only the band is stored, n * (kl + ku + 1) values, and factorization and solve
+ *    run in O(n * kl * ku) and O(n * (kl + ku)); linear in n for a fixed bandwidth.
+ *  - No pivoting; the factors fill exactly the band. Meant for systems that need no
+ *    pivoting, such as B-spline collocation matrices (totally positive, de Boor) and
+ *    diagonally dominant systems.
+ */
+template <typename T>
+class BandedLU {
+public:
+  BandedLU() = default;
+  BandedLU(int n, int kl, int ku) { resize(n, kl, ku); }
+
+  void resize(int n, int kl, int ku) {
+
+    _n  = n;
+    _kl = kl;
+    _ku = ku;
+    _a.assign(size_t(n) * size_t(width()), T(0));
+    _factorized = false;
+  }
+
+  int  size() const { return _n; }
+  bool isFactorized() const { return _factorized; }
+
+  // Element (i, j); must be inside the band, i - kl <= j <= i + ku
+  T&       operator()(int i, int j)       { return _a[index(i, j)]; }
+  const T& operator()(int i, int j) const { return _a[index(i, j)]; }
+
+  bool inBand(int i, int j) const { return j >= i - _kl && j <= i + _ku; }
+
+  /*!
+   *  factorize()
+   *
+   *  - In place Doolittle factorization; L (unit lower) and U share the band storage.
+   *  - Returns false if a pivot vanishes (the matrix needs pivoting or is singular).
+   */
+  bool factorize() {
+
+    for(int k = 0; k < _n; ++k) {
+
+      const T pivot = (*this)(k, k);
+      if(std::abs(pivot) <= std::numeric_limits<T>::min()) return _factorized = false;
+
+      const int i_end = std::min(k + _kl, _n - 1);
+      const int j_end = std::min(k + _ku, _n - 1);
+      for(int i = k + 1; i <= i_end; ++i) {
+
+        const T l = (*this)(i, k) / pivot;
+        (*this)(i, k) = l;
+        for(int j = k + 1; j <= j_end; ++j)
+          (*this)(i, j) -= l * (*this)(k, j);
+      }
+    }
+
+    return _factorized = true;
+  }
+
+  /*!
+   *  solve(b)
+   *
+   *  - Solves A x = b in place for a factorized matrix; b holds n right hand sides.
+   *  - V is any type with V * T and V -= V, e.g. T itself or GMlib::Vector<T,n>;
+   *    all coordinates of a point set are solved in one sweep.
+   */
+  template <typename V>
+  void solve(V* b) const {
+
+    // Forward substitution; L y = b
+    for(int i = 1; i < _n; ++i)
+      for(int j = std::max(0, i - _kl); j < i; ++j)
+        b[i] -= b[j] * (*this)(i, j);
+
+    // Back substitution; U x = y
+    for(int i = _n - 1; i >= 0; --i) {
+      const int j_end = std::min(i + _ku, _n - 1);
+      for(int j = i + 1; j <= j_end; ++j)
+        b[i] -= b[j] * (*this)(i, j);
+      b[i] = b[i] * (T(1) / (*this)(i, i));
+    }
+  }
+
+private:
+  int             _n  {0};
+  int             _kl {0};
+  int             _ku {0};
+  std::vector<T>  _a;               // Row major band; row i holds columns i - kl, ..., i + ku
+  bool            _factorized {false};
+
+  int    width() const { return _kl + _ku + 1; }
+  size_t index(int i, int j) const { return size_t(i) * size_t(width()) + size_t(j - i + _kl); }
+};
+
+#endif // BANDED_LU_H
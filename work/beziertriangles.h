@@ -0,0 +1,79 @@
+#ifndef BEZIER_TRIANGLES_H
+#define BEZIER_TRIANGLES_H
+
+#include "beziertriangletessellator.h"
+#include "quantizedvisualizers.h"
+
+// gmlib
+#include <scene/gmsceneobject.h>
+
+#include <utility>
+#include <vector>
+
+/*!
+ *  BezierTriangles
+ *
+ *  A surface of Bezier triangles of one degree (a triangulated patch layout), drawn from
+ *  one quantized mesh; all triangles are tessellated as one batch by
+ *  BezierTriangleTessellator, one matrix product against the shared Bernstein table.
+ *
+ *  - Nets are netSize(degree) points in the tessellator's order; neighbouring triangles
+ *    join where their boundary rows of the nets agree.
+ *  - setControlPoint() only marks the surface; the next localSimulate() tessellates and
+ *    uploads the mesh to the QuantizedSurfaceVisualizers, once however many points moved.
+ *  - The bounding sphere is the one of the nets' box, which holds the triangles.
+ */
+class BezierTriangles : public GMlib::SceneObject {
+  GM_SCENEOBJECT(BezierTriangles)
+public:
+  using Point = BezierTriangleTessellator::Point;
+  using Net   = BezierTriangleTessellator::Net;
+
+  // Triangles of the given degree; 2^level segments per edge, level at most
+  // BezierTriangleTessellator::MaxLevel
+  BezierTriangles(std::vector<Net> nets, int degree, int level = 3)
+    : _nets(std::move(nets)), _degree(degree), _level(level) {}
+
+  int         getNumTriangles() const { return int(_nets.size()); }
+  int         getDegree() const { return _degree; }
+  int         getLevel() const { return _level; }
+  const Net&  getNet(int t) const { return _nets[size_t(t)]; }
+
+  void setLevel(int level) { _level = level; _dirty = true; }
+  void setControlPoint(int t, int i, const Point& p) { _nets[size_t(t)][i] = p; _dirty = true; }
+
+  // Tessellate and upload now; render thread, as localSimulate()
+  void replot() {
+
+    _dirty = false;
+    if(_nets.empty()) return;
+
+    std::vector<const Net*> nets;
+    nets.reserve(_nets.size());
+    for(const Net& net : _nets) nets.push_back(&net);
+    BezierTriangleTessellator::tessellate(nets, _degree, _level, _mesh);
+
+    const quantized::Box& box = _mesh.box;
+    const Point offset(box.offset[0], box.offset[1], box.offset[2]);
+    const Point extent(box.extent[0], box.extent[1], box.extent[2]);
+    setSurroundingSphere(GMlib::Sphere<float,3>(offset + extent * 0.5f, extent.getLength() * 0.5f));
+
+    // The indices only depend on the segments per edge and the number of triangles
+    const int segments = BezierTriangleTessellator::table(_degree, _level)->segments;
+    GMlib::Array<GMlib::Visualizer*>& visus = getVisualizers();
+    for(int i = 0; i < visus.getSize(); ++i)
+      if(auto visu = dynamic_cast<QuantizedSurfaceVisualizer*>(visus[i])) visu->upload(_mesh, segments, int(_nets.size()));
+  }
+
+protected:
+  void localSimulate(double /*dt*/) override { if(_dirty) replot(); }
+
+private:
+  std::vector<Net>  _nets;
+  int               _degree;
+  int               _level;
+  bool              _dirty {true};
+  quantized::Mesh   _mesh;            // Reused between replots
+};
+
+#endif // BEZIER_TRIANGLES_H
@@ -0,0 +1,287 @@
+#ifndef BEZIER_TRIANGLE_TESSELLATOR_H
+#define BEZIER_TRIANGLE_TESSELLATOR_H
+
+#include <core/containers/gmdvector.h>
+#include <core/types/gmpoint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "memorybudget.h"
+#include "parallelfor.h"
+#include "quantizedvertex.h"
+
+/*!
+ *  BezierTriangleTessellator
+ *
+ *  Indexed meshes of Bezier triangles of degree d, sampled on a uniform barycentric grid
+ *  with 2^level segments per edge.
+ *
+ *  - The control net is ordered row by row from the first corner: for i = d, ..., 0 and
+ *    j = d - i, ..., 0 the point c_ijk, k = d - i - j. The domain is (u, v, w), w = 1 - u - v,
+ *    and the corners u = 1, v = 1, w = 1 are c_d00, c_0d0, c_00d.
+ *  - The Bernstein polynomials B_ijk(u, v, w) and their derivatives along u and v (w
+ *    dependent) are tabulated once per (degree, level) at all grid vertices, V x N matrices
+ *    with N = (d + 1)(d + 2) / 2. table() caches them, together with the triangle indices,
+ *    for every triangle of the same degree; tables are immutable once built.
+ *  - The level is clamped to MaxLevel. The cache is one MemoryBudget account; under memory
+ *    pressure all tables are dropped and rebuilt on their next use. table() hands out
+ *    shared pointers, so a tessellation in progress keeps its table.
+ *  - All vertices are then one matrix product P = B C with the net C as an N x 3 matrix.
+ *    A batch of K nets is one product against an N x 3K matrix, row by row in parallel.
+ *  - Normals are S_u x S_v, normalized; they point along (c_0d0 - c_d00) x (c_00d - c_d00)
+ *    for a flat net.
+ *  - A quantized::Mesh output gets 12 byte vertices written directly; the box is the
+ *    bounding box of the nets, which holds the triangles (convex hull property).
+ */
+class BezierTriangleTessellator {
+public:
+  using Point = GMlib::Vector<float,3>;
+  using Net   = GMlib::DVector<Point>;
+
+  struct Table {
+    int                        degree, level, segments;
+    int                        vertices, points;   // V, N
+    std::vector<float>         b, bu, bv;          // V x N, row major
+    std::vector<unsigned int>  indices;            // 3 per triangle, counter-clockwise in (u, v)
+  };
+
+  // Several triangles in one mesh; triangle t owns vertices [t V, (t + 1) V)
+  struct Mesh {
+    std::vector<float>         positions;   // x, y, z per vertex
+    std::vector<float>         normals;
+    std::vector<unsigned int>  indices;
+  };
+
+  static constexpr int MaxLevel = 8;   // 256 segments per edge, 33k vertices per triangle
+
+  static int netSize(int degree) { return (degree + 1) * (degree + 2) / 2; }
+
+  // Shared table for (degree, level), built on first use
+  static std::shared_ptr<const Table> table(int degree, int level) {
+
+    degree = std::max(degree, 0);
+    level  = std::min(std::max(level, 0), int(MaxLevel));
+
+    Cache& cache = Cache::shared();
+    std::lock_guard<std::mutex> lk(cache.mutex);
+    auto& t = cache.tables[std::make_pair(degree, level)];
+    if(!t) {
+      t = build(degree, level);
+      cache.bytes += sizeof(Table) + sizeof(float) * (t->b.size() + t->bu.size() + t->bv.size())
+                     + sizeof(unsigned int) * t->indices.size();
+      cache.account.charge(cache.bytes);
+    }
+    cache.account.touch();
+    return t;
+  }
+
+  // Tessellate one net of degree d (netSize(d) points)
+  static void tessellate(const Net& net, int degree, int level, Mesh& mesh) {
+
+    tessellate(std::vector<const Net*>(1, &net), degree, level, mesh);
+  }
+
+  static void tessellate(const Net& net, int degree, int level, quantized::Mesh& mesh) {
+
+    tessellate(std::vector<const Net*>(1, &net), degree, level, mesh);
+  }
+
+  // Tessellate a batch of nets of the same degree into one mesh
+  static void tessellate(const std::vector<const Net*>& nets, int degree, int level, Mesh& mesh) {
+
+    const auto   ptr = table(degree, level);
+    const Table& tab = *ptr;
+    const size_t V   = size_t(tab.vertices);
+
+    mesh.positions.resize(V * nets.size() * 3);
+    mesh.normals.resize(V * nets.size() * 3);
+    evaluate(nets, tab, [&mesh](size_t v, const float* p, const float* n) {
+      for(size_t c = 0; c < 3; ++c) {
+        mesh.positions[3 * v + c] = p[c];
+        mesh.normals[3 * v + c]   = n[c];
+      }
+    });
+    indices(tab, int(nets.size()), mesh.indices);
+  }
+
+  // Tessellate a batch of nets of the same degree into one quantized mesh
+  static void tessellate(const std::vector<const Net*>& nets, int degree, int level, quantized::Mesh& mesh) {
+
+    const auto   ptr = table(degree, level);
+    const Table& tab = *ptr;
+    const size_t V   = size_t(tab.vertices);
+
+    std::vector<Point> points;
+    for(const Net* net : nets)
+      for(int n = 0; n < net->getDim(); ++n) points.push_back((*net)[n]);
+    mesh.box = quantized::Box::fromPoints(points.begin(), points.end());
+
+    mesh.vertices.resize(V * nets.size());
+    const quantized::Box& box = mesh.box;
+    evaluate(nets, tab, [&mesh, &box](size_t v, const float* p, const float* n) {
+      mesh.vertices[v] = quantized::encode(box, Point(p[0], p[1], p[2]), Point(n[0], n[1], n[2]));
+    });
+    indices(tab, int(nets.size()), mesh.indices);
+  }
+
+private:
+  // The tables built so far and their footprint
+  struct Cache {
+    std::mutex                                                  mutex;
+    std::map<std::pair<int,int>, std::shared_ptr<const Table>>  tables;
+    size_t                                                      bytes {0};
+    MemoryBudget::Account                                       account;
+
+    // Opened here, so the budget outlives the cache
+    Cache() {
+      account.open("Bezier triangle tables", 1.0, [this] {
+        std::lock_guard<std::mutex> lk(mutex);
+        tables.clear();
+        bytes = 0;
+        account.charge(0);
+      });
+    }
+
+    static Cache& shared() {
+      static Cache cache;
+      return cache;
+    }
+  };
+
+  // P = B C, row by row in parallel; write(v, position, normal) for vertex v = k V + r of net k
+  template <typename Write>
+  static void evaluate(const std::vector<const Net*>& nets, const Table& tab, Write write) {
+
+    const int K = int(nets.size());
+    const int N = tab.points, V = tab.vertices, W = 3 * K;
+
+    // C: N x 3K, the nets side by side
+    std::vector<float> C(size_t(N) * size_t(W));
+    for(int k = 0; k < K; ++k)
+      for(int n = 0; n < N; ++n)
+        for(int c = 0; c < 3; ++c) C[size_t(n) * size_t(W) + size_t(3 * k + c)] = (*nets[size_t(k)])[n][c];
+
+    parallelFor(0, V, [&](int first, int last) {
+
+      std::vector<float> p(static_cast<size_t>(W)), pu(static_cast<size_t>(W)), pv(static_cast<size_t>(W));
+      for(int r = first; r < last; ++r) {
+
+        std::fill(p.begin(), p.end(), 0.0f);
+        std::fill(pu.begin(), pu.end(), 0.0f);
+        std::fill(pv.begin(), pv.end(), 0.0f);
+
+        const float* b  = &tab.b[size_t(r) * size_t(N)];
+        const float* bu = &tab.bu[size_t(r) * size_t(N)];
+        const float* bv = &tab.bv[size_t(r) * size_t(N)];
+        for(int n = 0; n < N; ++n) {
+          const float* c = &C[size_t(n) * size_t(W)];
+          for(int x = 0; x < W; ++x) {
+            p[size_t(x)]  += b[n] * c[x];
+            pu[size_t(x)] += bu[n] * c[x];
+            pv[size_t(x)] += bv[n] * c[x];
+          }
+        }
+
+        for(int k = 0; k < K; ++k) {
+
+          const float* u = &pu[size_t(3 * k)];
+          const float* v = &pv[size_t(3 * k)];
+          float nrm[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+          const float len = std::sqrt(nrm[0] * nrm[0] + nrm[1] * nrm[1] + nrm[2] * nrm[2]);
+          if(len > 0.0f) for(float& x : nrm) x /= len;
+
+          write(size_t(k) * size_t(V) + size_t(r), &p[size_t(3 * k)], nrm);
+        }
+      }
+    }, 256 / std::max(K, 1) + 1);
+  }
+
+  static void indices(const Table& tab, int K, std::vector<unsigned int>& out) {
+
+    const size_t I = tab.indices.size();
+    out.resize(I * size_t(K));
+    for(int k = 0; k < K; ++k)
+      for(size_t i = 0; i < I; ++i) out[size_t(k) * I + i] = tab.indices[i] + unsigned(k * tab.vertices);
+  }
+
+  // Degree and level as clamped by table()
+  static std::shared_ptr<Table> build(int degree, int level) {
+
+    std::shared_ptr<Table> t = std::make_shared<Table>();
+    const int d = degree;
+    const int s = 1 << level;
+
+    t->degree   = d;
+    t->level    = level;
+    t->segments = s;
+    t->vertices = (s + 1) * (s + 2) / 2;
+    t->points   = netSize(d);
+
+    // Multinomial coefficients d! / (i! j! k!) in net order
+    std::vector<double> fact(size_t(d) + 1, 1.0);
+    for(int i = 1; i <= d; ++i) fact[size_t(i)] = fact[size_t(i - 1)] * i;
+
+    std::vector<int>    ei, ej, ek;
+    std::vector<double> coef;
+    for(int i = d; i >= 0; --i)
+      for(int j = d - i; j >= 0; --j) {
+        const int k = d - i - j;
+        ei.push_back(i);
+        ej.push_back(j);
+        ek.push_back(k);
+        coef.push_back(fact[size_t(d)] / (fact[size_t(i)] * fact[size_t(j)] * fact[size_t(k)]));
+      }
+
+    // x^e for e in [0, d]
+    auto powers = [d](double x, std::vector<double>& pw) {
+      pw.assign(size_t(d) + 1, 1.0);
+      for(int e = 1; e <= d; ++e) pw[size_t(e)] = pw[size_t(e - 1)] * x;
+    };
+
+    const size_t N = size_t(t->points);
+    t->b.resize(size_t(t->vertices) * N);
+    t->bu.resize(size_t(t->vertices) * N);
+    t->bv.resize(size_t(t->vertices) * N);
+
+    // Vertex (a, b), a + b <= s, at u = a / s, v = b / s; row a starts at a (s + 1) - a (a - 1) / 2
+    std::vector<double> pu, pv, pw;
+    size_t r = 0;
+    for(int a = 0; a <= s; ++a)
+      for(int b = 0; b <= s - a; ++b, ++r) {
+
+        const double u = double(a) / s, v = double(b) / s, w = double(s - a - b) / s;
+        powers(u, pu);
+        powers(v, pv);
+        powers(w, pw);
+
+        for(size_t n = 0; n < N; ++n) {
+          const int i = ei[n], j = ej[n], k = ek[n];
+          const double c = coef[n];
+          const double du = (i > 0 ? i * pu[size_t(i - 1)] : 0.0) * pw[size_t(k)] - (k > 0 ? k * pw[size_t(k - 1)] : 0.0) * pu[size_t(i)];
+          const double dv = (j > 0 ? j * pv[size_t(j - 1)] : 0.0) * pw[size_t(k)] - (k > 0 ? k * pw[size_t(k - 1)] : 0.0) * pv[size_t(j)];
+          t->b[r * N + n]  = float(c * pu[size_t(i)] * pv[size_t(j)] * pw[size_t(k)]);
+          t->bu[r * N + n] = float(c * du * pv[size_t(j)]);
+          t->bv[r * N + n] = float(c * dv * pu[size_t(i)]);
+        }
+      }
+
+    auto index = [s](int a, int b) { return unsigned(a * (s + 1) - a * (a - 1) / 2 + b); };
+    t->indices.reserve(size_t(s) * size_t(s) * 3);
+    for(int a = 0; a < s; ++a)
+      for(int b = 0; b < s - a; ++b) {
+        t->indices.insert(t->indices.end(), { index(a, b), index(a + 1, b), index(a, b + 1) });
+        if(b + 1 < s - a)
+          t->indices.insert(t->indices.end(), { index(a + 1, b), index(a + 1, b + 1), index(a, b + 1) });
+      }
+
+    return t;
+  }
+};
+
+#endif // BEZIER_TRIANGLE_TESSELLATOR_H
@@ -0,0 +1,150 @@
+#ifndef BSPLINE_BASIS_H
+#define BSPLINE_BASIS_H
+
+#include <algorithm>
+
+/*!
+ *  B-spline basis function helpers (span local; The NURBS Book, A2.1 and A2.3).
+ *
+ *  - Knots is any random access container of T (GMlib::DVector<T>, std::vector<T>, ...).
+ *  - n is the number of control points, p the polynomial degree; the knot vector
+ *    holds n + p + 1 knots.
+ *  - Only the p + 1 non-zero basis functions of a span are evaluated, so an evaluation
+ *    costs O(p^2) regardless of the number of control points.
+ */
+namespace bspline {
+
+  constexpr int MaxDegree = 7;
+  constexpr int MaxDerivatives = 3;
+
+  /*!
+   *  findSpan(knots, n, p, t, left)
+   *
+   *  - Returns the index i, p <= i < n, of the knot span [t_i, t_{i+1}) containing t.
+   *  - Binary search; O(log n).
+   *  - With left == true, a parameter value on an interior knot is assigned to the span
+   *    ending at that knot (left-hand limits).
+   */
+  template <typename T, typename Knots>
+  int findSpan(const Knots& knots, int n, int p, T t, bool left = false) {
+
+    if(t >= knots[n]) return n - 1;
+    if(t <= knots[p]) return p;
+
+    int lo = p, hi = n;
+    while(hi - lo > 1) {
+      const int mid = (lo + hi) / 2;
+      if(t < knots[mid]) hi = mid;
+      else               lo = mid;
+    }
+
+    if(left)
+      while(lo > p && t == knots[lo]) --lo;
+
+    return lo;
+  }
+
+  /*!
+   *  basisFuns(knots, span, p, t, N)
+   *
+   *  - Evaluates the p + 1 non-zero basis functions N_{span-p}, ..., N_{span} at t into N.
+   */
+  template <typename T, typename Knots>
+  void basisFuns(const Knots& knots, int span, int p, T t, T* N) {
+
+    T left[MaxDegree + 1], right[MaxDegree + 1];
+
+    N[0] = T(1);
+    for(int j = 1; j <= p; ++j) {
+
+      left[j]  = t - knots[span + 1 - j];
+      right[j] = knots[span + j] - t;
+
+      T saved = T(0);
+      for(int r = 0; r < j; ++r) {
+        const T tmp = N[r] / (right[r + 1] + left[j - r]);
+        N[r] = saved + right[r + 1] * tmp;
+        saved = left[j - r] * tmp;
+      }
+      N[j] = saved;
+    }
+  }
+
+  /*!
+   *  basisFunsDerivs(knots, span, p, t, d, ders)
+   *
+   *  - Evaluates the non-zero basis functions and their derivatives up to order d at t.
+   *  - ders[k][j] is the k-th derivative of N_{span-p+j}; derivatives of order > p are zero.
+   */
+  template <typename T, typename Knots>
+  void basisFunsDerivs(const Knots& knots, int span, int p, T t, int d,
+                       T ders[MaxDerivatives + 1][MaxDegree + 1]) {
+
+    T ndu[MaxDegree + 1][MaxDegree + 1];
+    T a[2][MaxDegree + 1];
+    T left[MaxDegree + 1], right[MaxDegree + 1];
+
+    ndu[0][0] = T(1);
+    for(int j = 1; j <= p; ++j) {
+
+      left[j]  = t - knots[span + 1 - j];
+      right[j] = knots[span + j] - t;
+
+      T saved = T(0);
+      for(int r = 0; r < j; ++r) {
+        ndu[j][r] = right[r + 1] + left[j - r];
+        const T tmp = ndu[r][j - 1] / ndu[j][r];
+        ndu[r][j] = saved + right[r + 1] * tmp;
+        saved = left[j - r] * tmp;
+      }
+      ndu[j][j] = saved;
+    }
+
+    for(int j = 0; j <= p; ++j) ders[0][j] = ndu[j][p];
+
+    for(int r = 0; r <= p; ++r) {
+
+      int s1 = 0, s2 = 1;
+      a[0][0] = T(1);
+
+      for(int k = 1; k <= std::min(d, p); ++k) {
+
+        T dd = T(0);
+        const int rk = r - k, pk = p - k;
+
+        if(r >= k) {
+          a[s2][0] = a[s1][0] / ndu[pk + 1][rk];
+          dd = a[s2][0] * ndu[rk][pk];
+        }
+
+        const int j1 = (rk >= -1) ? 1 : -rk;
+        const int j2 = (r - 1 <= pk) ? k - 1 : p - r;
+        for(int j = j1; j <= j2; ++j) {
+          a[s2][j] = (a[s1][j] - a[s1][j - 1]) / ndu[pk + 1][rk + j];
+          dd += a[s2][j] * ndu[rk + j][pk];
+        }
+
+        if(r <= pk) {
+          a[s2][k] = -a[s1][k - 1] / ndu[pk + 1][r];
+          dd += a[s2][k] * ndu[r][pk];
+        }
+
+        ders[k][r] = dd;
+        std::swap(s1, s2);
+      }
+    }
+
+    // Multiply through by the correct factors: p! / (p-k)!
+    T f = T(p);
+    for(int k = 1; k <= std::min(d, p); ++k) {
+      for(int j = 0; j <= p; ++j) ders[k][j] *= f;
+      f *= T(p - k);
+    }
+
+    for(int k = p + 1; k <= d; ++k)
+      for(int j = 0; j <= p; ++j) ders[k][j] = T(0);
+  }
+
+} // END namespace bspline
+
+#endif // BSPLINE_BASIS_H
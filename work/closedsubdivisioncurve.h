@@ -4,6 +4,12 @@
 #include <parametrics/gmpcurve.h>
 #include <core/containers/gmdvector.h>
 
+#include <atomic>
+#include <mutex>
+
+#include "sharedcontrolpoints.h"
+#include "memorybudget.h"
+
 // ClosedSubdivisionCurve class definition inheriting from GMlib::PCurve
 class ClosedSubdivisionCurve : public GMlib::PCurve<float, 3> {
   GM_SCENEOBJECT(ClosedSubdivisionCurve)
@@ -20,6 +26,21 @@ public:
     laneRiesenfeldSubdivision();
   }
 
+  // Constructor: Share the control polygon of another curve (copy-on-write)
+  ClosedSubdivisionCurve(const SharedControlPoints<float, 3> &controlPts, int degree)
+      : _controlPoints(controlPts), _degree(degree) {
+
+    this->setDomain(0.0f, 1.0f);
+    laneRiesenfeldSubdivision();
+  }
+
+  // Copy constructor: the copy gets its own lock and memory budget account
+  ClosedSubdivisionCurve(const ClosedSubdivisionCurve &copy)
+      : GMlib::PCurve<float, 3>(copy), _controlPoints(copy._controlPoints), _degree(copy._degree) {
+
+    laneRiesenfeldSubdivision();
+  }
+
   // Destructor (default)
   ~ClosedSubdivisionCurve() override = default;
 
@@ -29,13 +50,29 @@ public:
   float getEndP() const override { return 1.0f; }
   bool isClosed() const override { return true; } // Mark as a closed curve
 
+  const SharedControlPoints<float, 3> &getControlPoints() const { return _controlPoints; }
+
+protected:
+  // Sample the curve; touches the subdivided points in the memory budget
+  void resample(GMlib::DVector<GMlib::DVector<GMlib::Vector<float, 3>>> &p, int m, int d, float start, float end) override;
+
 private:
-  GMlib::DVector<GMlib::Vector<float, 3>> _controlPoints; // Original control polygon
-  mutable GMlib::DVector<GMlib::Vector<float, 3>> _subdividedPoints; // Subdivided points
+  SharedControlPoints<float, 3> _controlPoints; // Original control polygon; shared, never written
+  mutable GMlib::DVector<GMlib::Vector<float, 3>> _subdividedPoints; // Subdivided points, n 2^degree
   int _degree; // Number of subdivision iterations
 
+  // The subdivided points are evicted under memory pressure and rebuilt on the next eval
+  mutable std::atomic<bool> _subdivided {false};
+  mutable std::mutex _subdivisionMutex;
+  mutable MemoryBudget::Account _subdivisionBudget;
+
   // Perform Lane-Riesenfeld subdivision to refine the curve
-  void laneRiesenfeldSubdivision();
+  void laneRiesenfeldSubdivision() const;
+
+  // Rebuild the subdivided points if they were evicted
+  void ensureSubdivided() const {
+    if (!_subdivided.load(std::memory_order_acquire)) laneRiesenfeldSubdivision();
+  }
 };
 
 /*!
@@ -47,6 +84,8 @@ private:
  */
 void ClosedSubdivisionCurve::eval(float t, int d, bool /*left*/) const {
 
+  ensureSubdivided();
+
   // Ensure _p has space for position and derivatives
   this->_p.setDim(d + 1);
 
@@ -77,10 +116,13 @@ void ClosedSubdivisionCurve::eval(float t, int d, bool /*left*/) const {
  *  - Inserts **midpoints** and applies **averaging passes** to generate a smooth result.
  *  - Ensures closure by explicitly setting the last point equal to the first.
  */
-void ClosedSubdivisionCurve::laneRiesenfeldSubdivision() {
+void ClosedSubdivisionCurve::laneRiesenfeldSubdivision() const {
+
+  std::lock_guard<std::mutex> lock(_subdivisionMutex);
+  if (_subdivided.load(std::memory_order_relaxed)) return; // Rebuilt by another thread
 
   // Start with the original control points
-  GMlib::DVector<GMlib::Vector<float, 3>> points = _controlPoints;
+  GMlib::DVector<GMlib::Vector<float, 3>> points = _controlPoints.toDVector();
 
   // Perform _degree_ iterations of Lane-Riesenfeld subdivision
   for (int iter = 0; iter < _degree; ++iter) {
@@ -117,6 +159,29 @@ void ClosedSubdivisionCurve::laneRiesenfeldSubdivision() {
   if (_subdividedPoints.getDim() > 1) {
     _subdividedPoints[_subdividedPoints.getDim() - 1] = _subdividedPoints[0];
   }
+
+  // Charge the budget; a rebuild costs about _degree averaging passes per point
+  if (!_subdivisionBudget.isOpen())
+    _subdivisionBudget.open("Subdivision", 1.0 + _degree, [this]() {
+      std::lock_guard<std::mutex> lock(_subdivisionMutex);
+      _subdivided.store(false, std::memory_order_release);
+      _subdividedPoints = GMlib::DVector<GMlib::Vector<float, 3>>();
+      _subdivisionBudget.charge(0);
+    });
+  _subdivisionBudget.charge(size_t(_subdividedPoints.getDim()) * sizeof(GMlib::Vector<float, 3>));
+  _subdivided.store(true, std::memory_order_release);
+}
+
+/*!
+ *  resample(...)
+ *
+ *  - Marks the subdivided points as used before PCurve samples the curve.
+ */
+void ClosedSubdivisionCurve::resample(GMlib::DVector<GMlib::DVector<GMlib::Vector<float, 3>>> &p, int m, int d,
+                                      float start, float end) {
+
+  _subdivisionBudget.touch();
+  GMlib::PCurve<float, 3>::resample(p, m, d, start, end);
 }
 
 #endif // CLOSED_SUBDIVISION_CURVE_H
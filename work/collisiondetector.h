@@ -0,0 +1,490 @@
+#ifndef COLLISION_DETECTOR_H
+#define COLLISION_DETECTOR_H
+
+#include <parametrics/gmpcurve.h>
+#include <parametrics/gmpsurf.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "parallelfor.h"
+
+/*!
+ *  CollisionDetector
+ *
+ *  Contacts between moving scene objects, for scenarios to react to; update() once per
+ *  simulation step.
+ *
+ *  - Every object is registered with samples of its geometry in its local frame (the
+ *    PCurve/PSurf overloads sample the object itself); the samples are placed in the scene
+ *    by the object's global matrix every step. After the geometry changes (a control net
+ *    edit, a refit), refresh() re-samples a PCurve/PSurf, setSamples() replaces them.
+ *  - The geometry tested is the segments between the samples: the polyline of a curve, the
+ *    edges of a surface's sample grid, single points for plain samples. Curves are tested
+ *    exactly up to their polylines; a surface is its wireframe, so a curve passing through
+ *    a grid face without coming near its edges is missed. Sample surfaces finer than the
+ *    contact distance where that matters.
+ *  - Broad phase: incremental sweep-and-prune. The world AABBs (local sample box through the
+ *    global matrix, padded by half the contact distance) are kept as sorted endpoint lists
+ *    on x, y and z. Objects move little between steps, so the lists are re-sorted by
+ *    insertion sort in about O(n + swaps); every swap of a min and a max endpoint updates
+ *    the pair's count of overlapping axes, and pairs with three form the candidate set.
+ *  - Narrow phase: for each candidate pair the segments of one object inside the other's box
+ *    are bucketed by their midpoints in a grid with cells of the contact distance plus half
+ *    the longest segment of either object; the other object's segments probe the 27 cells
+ *    around their midpoints with exact segment-segment distances. Pairs run in parallel
+ *    on the shared ThreadPool.
+ *  - Pairs closer than the contact distance are in contact; the callback is told when a
+ *    contact begins and ends, contacts() lists the current ones.
+ */
+class CollisionDetector {
+public:
+  using Point = GMlib::Point<float,3>;
+
+  enum class State { Began, Ended };
+
+  struct Contact {
+    GMlib::SceneObject*  a;
+    GMlib::SceneObject*  b;
+    Point                point;      // Midway between the closest points
+    float                distance;
+  };
+
+  using Callback = std::function<void(const Contact&, State)>;
+
+  explicit CollisionDetector(float contact_distance = 0.05f) : _contact_distance(contact_distance) {}
+
+  void  setContactDistance(float d) { _contact_distance = std::max(d, 1e-6f); }
+  float contactDistance() const { return _contact_distance; }
+
+  void  setCallback(Callback callback) { _callback = std::move(callback); }
+
+  // Register obj with samples of its geometry in its local frame; tested as points
+  void add(GMlib::SceneObject* obj, std::vector<Point> samples) {
+
+    std::vector<Edge> edges(samples.size());
+    for(size_t k = 0; k < edges.size(); ++k) edges[k] = Edge(int(k), int(k));
+    add(obj, std::move(samples), std::move(edges));
+  }
+
+  // Register a curve with m samples, or a surface with m1 x m2 samples
+  void add(GMlib::PCurve<float,3>* curve, int m) {
+
+    m = std::max(m, 2);
+    std::vector<Edge> edges;
+    for(int i = 0; i < m - 1; ++i) edges.emplace_back(i, i + 1);   // A closed curve's last sample is its first
+    add(curve, sample(curve, m), std::move(edges));
+    auto it = _index.find(curve);
+    if(it != _index.end()) _bodies[size_t(it->second)].sampler = [curve, m] { return sample(curve, m); };
+  }
+
+  void add(GMlib::PSurf<float,3>* surf, int m1, int m2) {
+
+    m1 = std::max(m1, 2);
+    m2 = std::max(m2, 2);
+    std::vector<Edge> edges;
+    for(int i = 0; i < m1; ++i)
+      for(int j = 0; j < m2; ++j) {
+        if(i < m1 - 1) edges.emplace_back(i * m2 + j, (i + 1) * m2 + j);
+        if(j < m2 - 1) edges.emplace_back(i * m2 + j, i * m2 + j + 1);
+      }
+    add(surf, sample(surf, m1, m2), std::move(edges));
+    auto it = _index.find(surf);
+    if(it != _index.end()) _bodies[size_t(it->second)].sampler = [surf, m1, m2] { return sample(surf, m1, m2); };
+  }
+
+  // Replace the samples of a registered obj; the broad phase picks up the new box next
+  // update(). The segments are kept for the same number of samples, else they become points.
+  void setSamples(const GMlib::SceneObject* obj, std::vector<Point> samples) {
+
+    auto it = _index.find(const_cast<GMlib::SceneObject*>(obj));
+    if(it == _index.end() || samples.empty()) return;
+    Body& b = _bodies[size_t(it->second)];
+    if(samples.size() != b.samples.size()) {
+      b.edges.resize(samples.size());
+      for(size_t k = 0; k < b.edges.size(); ++k) b.edges[k] = Edge(int(k), int(k));
+    }
+    setSamples(b, std::move(samples));
+  }
+
+  // Re-sample a PCurve/PSurf registered by the overloads above, at the same resolution;
+  // other objects are left as they are
+  void refresh(const GMlib::SceneObject* obj) {
+
+    auto it = _index.find(const_cast<GMlib::SceneObject*>(obj));
+    if(it == _index.end()) return;
+    Body& b = _bodies[size_t(it->second)];
+    if(b.sampler) setSamples(b, b.sampler());
+  }
+
+  // Unregister obj; its current contacts end silently
+  void remove(GMlib::SceneObject* obj) {
+
+    auto it = _index.find(obj);
+    if(it == _index.end()) return;
+    const int id = it->second;
+    _index.erase(it);
+
+    for(auto& axis : _axes)
+      axis.erase(std::remove_if(axis.begin(), axis.end(), [id](const Endpoint& e) { return e.body == id; }), axis.end());
+
+    auto involves = [id](std::uint64_t key) { return int(key >> 32) == id || int(key & 0xffffffffu) == id; };
+    for(auto i = _counts.begin(); i != _counts.end(); ) i = involves(i->first) ? _counts.erase(i) : std::next(i);
+    for(auto i = _candidates.begin(); i != _candidates.end(); ) i = involves(i->first) ? _candidates.erase(i) : std::next(i);
+    _contacts.erase(std::remove_if(_contacts.begin(), _contacts.end(), [obj](const Contact& c) { return c.a == obj || c.b == obj; }),
+                    _contacts.end());
+
+    _bodies[size_t(id)] = Body();
+    _free.push_back(id);
+  }
+
+  void update() {
+
+    // World AABBs
+    const float pad = 0.5f * _contact_distance;
+    parallelFor(0, int(_bodies.size()), [&](int first, int last) {
+      for(int i = first; i < last; ++i) {
+        Body& b = _bodies[size_t(i)];
+        if(!b.obj) continue;
+        b.matrix = b.obj->getMatrixGlobal();
+        for(int a = 0; a < 3; ++a) { b.lo[a] = std::numeric_limits<float>::max(); b.hi[a] = -std::numeric_limits<float>::max(); }
+        for(int c = 0; c < 8; ++c) {
+          const Point p = b.matrix * Point(c & 1 ? b.local_hi[0] : b.local_lo[0],
+                                           c & 2 ? b.local_hi[1] : b.local_lo[1],
+                                           c & 4 ? b.local_hi[2] : b.local_lo[2]);
+          for(int a = 0; a < 3; ++a) { b.lo[a] = std::min(b.lo[a], p[a] - pad); b.hi[a] = std::max(b.hi[a], p[a] + pad); }
+        }
+        b.world_valid = false;
+      }
+    }, 64);
+
+    // Broad phase; sorting many new objects in one by one is quadratic
+    const bool rebuild = _added > 16;
+    if(rebuild) {
+      _counts.clear();
+      _candidates.clear();
+    }
+    for(int a = 0; a < 3; ++a) rebuild ? build(a) : sweep(a);
+    _added = 0;
+
+    // Narrow phase
+    std::vector<std::uint64_t> pairs;
+    pairs.reserve(_candidates.size());
+    for(const auto& c : _candidates) pairs.push_back(c.first);
+    std::sort(pairs.begin(), pairs.end());
+
+    for(auto key : pairs) {
+      for(int id : { int(key >> 32), int(key & 0xffffffffu) }) {
+        Body& b = _bodies[size_t(id)];
+        if(!b.world_valid) { b.world_valid = true; _transform.push_back(id); }
+      }
+    }
+    parallelFor(0, int(_transform.size()), [&](int first, int last) {
+      for(int i = first; i < last; ++i) {
+        Body& b = _bodies[size_t(_transform[size_t(i)])];
+        b.world.resize(b.samples.size());
+        for(size_t k = 0; k < b.samples.size(); ++k) b.world[k] = b.matrix * b.samples[k];
+        b.longest = 0.0f;
+        for(const Edge& e : b.edges) {
+          const GMlib::Vector<float,3> d = b.world[size_t(e.second)] - b.world[size_t(e.first)];
+          b.longest = std::max(b.longest, d * d);
+        }
+        b.longest = std::sqrt(b.longest);
+      }
+    });
+    _transform.clear();
+
+    std::vector<Contact> found(pairs.size());
+    std::vector<char>    hit(pairs.size(), 0);
+    parallelFor(0, int(pairs.size()), [&](int first, int last) {
+      std::vector<std::pair<std::uint64_t,int>> cells;
+      for(int i = first; i < last; ++i) {
+        const Body& p = _bodies[size_t(pairs[size_t(i)] >> 32)];
+        const Body& q = _bodies[size_t(pairs[size_t(i)] & 0xffffffffu)];
+        Contact& c = found[size_t(i)];
+        c.a = p.obj;
+        c.b = q.obj;
+        hit[size_t(i)] = closest(p, q, cells, c) ? 1 : 0;
+      }
+    }, 4);
+
+    // Events
+    std::vector<Contact> contacts;
+    for(size_t i = 0; i < pairs.size(); ++i)
+      if(hit[i]) contacts.push_back(found[i]);
+
+    if(_callback) {
+      auto key = [](const Contact& c) { return std::make_pair(c.a, c.b); };
+      auto less = [&](const Contact& x, const Contact& y) { return key(x) < key(y); };
+      std::vector<Contact> before = _contacts, after = contacts;
+      std::sort(before.begin(), before.end(), less);
+      std::sort(after.begin(), after.end(), less);
+
+      size_t i = 0, j = 0;
+      while(i < before.size() || j < after.size()) {
+        if(j == after.size() || (i < before.size() && less(before[i], after[j]))) _callback(before[i++], State::Ended);
+        else if(i == before.size() || less(after[j], before[i]))                _callback(after[j++], State::Began);
+        else { ++i; ++j; }
+      }
+    }
+    _contacts = std::move(contacts);
+  }
+
+  const std::vector<Contact>& contacts() const { return _contacts; }
+
+  size_t candidatePairs() const { return _candidates.size(); }
+
+private:
+  using Edge = std::pair<int,int>;   // Segment between two samples; a point if they are the same
+
+  struct Body {
+    GMlib::SceneObject*        obj {nullptr};
+    std::vector<Point>         samples;           // Local frame
+    std::vector<Edge>          edges;
+    std::function<std::vector<Point>()> sampler;  // Samples the object again; PCurve/PSurf only
+    float                      local_lo[3], local_hi[3];
+    GMlib::HqMatrix<float,3>   matrix;
+    float                      lo[3], hi[3];      // World AABB, padded
+    std::vector<Point>         world;             // Samples in the scene, for candidates only
+    float                      longest {0.0f};    // Longest edge in the scene
+    bool                       world_valid {false};
+  };
+
+  struct Endpoint {
+    float  value;
+    int    body;
+    bool   max;
+  };
+
+  float                                    _contact_distance;
+  Callback                                 _callback;
+  std::vector<Body>                        _bodies;
+  std::vector<int>                         _free;
+  std::unordered_map<GMlib::SceneObject*, int> _index;
+  std::vector<Endpoint>                    _axes[3];
+  std::unordered_map<std::uint64_t, int>   _counts;       // Overlapping axes per pair
+  std::unordered_map<std::uint64_t, char>  _candidates;   // Pairs overlapping on all three
+  std::vector<int>                         _transform;
+  int                                      _added {0};      // Objects added since the last update()
+  std::vector<Contact>                     _contacts;
+
+  void add(GMlib::SceneObject* obj, std::vector<Point> samples, std::vector<Edge> edges) {
+
+    if(samples.empty() || _index.count(obj)) return;
+
+    int id;
+    if(_free.empty()) { id = int(_bodies.size()); _bodies.emplace_back(); }
+    else              { id = _free.back(); _free.pop_back(); }
+
+    Body& b = _bodies[size_t(id)];
+    b = Body();
+    b.obj   = obj;
+    b.edges = std::move(edges);
+    setSamples(b, std::move(samples));
+    _index[obj] = id;
+
+    // New endpoints start at the end of the lists, as if beyond everything; the next
+    // update() sorts them in and counts their overlaps (or rebuilds, after many adds)
+    for(auto& axis : _axes) {
+      axis.push_back(Endpoint { std::numeric_limits<float>::max(), id, false });
+      axis.push_back(Endpoint { std::numeric_limits<float>::max(), id, true });
+    }
+    ++_added;
+  }
+
+  static std::vector<Point> sample(GMlib::PCurve<float,3>* curve, int m) {
+
+    std::vector<Point> p(static_cast<size_t>(std::max(m, 2)));
+    for(size_t i = 0; i < p.size(); ++i)
+      p[i] = curve->evaluate(curve->getParStart() + curve->getParDelta() * float(i) / float(p.size() - 1), 0)[0];
+    return p;
+  }
+
+  static std::vector<Point> sample(GMlib::PSurf<float,3>* surf, int m1, int m2) {
+
+    m1 = std::max(m1, 2);
+    m2 = std::max(m2, 2);
+    std::vector<Point> p;
+    p.reserve(size_t(m1) * size_t(m2));
+    for(int i = 0; i < m1; ++i)
+      for(int j = 0; j < m2; ++j)
+        p.push_back(surf->evaluate(surf->getParStartU() + surf->getParDeltaU() * float(i) / float(m1 - 1),
+                                   surf->getParStartV() + surf->getParDeltaV() * float(j) / float(m2 - 1), 0, 0)[0][0]);
+    return p;
+  }
+
+  // Samples and their local box
+  static void setSamples(Body& b, std::vector<Point> samples) {
+
+    b.samples = std::move(samples);
+    for(int a = 0; a < 3; ++a) {
+      b.local_lo[a] =  std::numeric_limits<float>::max();
+      b.local_hi[a] = -std::numeric_limits<float>::max();
+    }
+    for(const auto& p : b.samples)
+      for(int a = 0; a < 3; ++a) {
+        b.local_lo[a] = std::min(b.local_lo[a], p[a]);
+        b.local_hi[a] = std::max(b.local_hi[a], p[a]);
+      }
+  }
+
+  static std::uint64_t pairKey(int a, int b) {
+    if(a > b) std::swap(a, b);
+    return (std::uint64_t(unsigned(a)) << 32) | unsigned(b);
+  }
+
+  void overlap(int a, int b, int delta) {
+
+    const auto key = pairKey(a, b);
+    int& n = _counts[key];
+    n += delta;
+    if(n == 3)      _candidates[key] = 1;
+    else if(n == 2) _candidates.erase(key);
+    if(n <= 0)      _counts.erase(key);
+  }
+
+  // Insertion sort of one axis; a min passing a max to the left starts an overlap on this
+  // axis, a max passing a min to the left ends one
+  void sweep(int a) {
+
+    auto& axis = _axes[a];
+    for(auto& e : axis) {
+      const Body& b = _bodies[size_t(e.body)];
+      e.value = e.max ? b.hi[a] : b.lo[a];
+    }
+
+    for(size_t i = 1; i < axis.size(); ++i) {
+      const Endpoint e = axis[i];
+      size_t j = i;
+      for(; j > 0 && e.value < axis[j - 1].value; --j) {
+        const Endpoint& f = axis[j - 1];
+        if(!e.max && f.max)      overlap(e.body, f.body, +1);
+        else if(e.max && !f.max) overlap(e.body, f.body, -1);
+        axis[j] = f;
+      }
+      axis[j] = e;
+    }
+  }
+
+  // Full sort of one axis; the overlaps are counted by a sweep over the sorted list
+  void build(int a) {
+
+    auto& axis = _axes[a];
+    for(auto& e : axis) {
+      const Body& b = _bodies[size_t(e.body)];
+      e.value = e.max ? b.hi[a] : b.lo[a];
+    }
+    std::sort(axis.begin(), axis.end(), [](const Endpoint& x, const Endpoint& y) {
+      return x.value < y.value || (x.value == y.value && !x.max && y.max);
+    });
+
+    std::vector<int> active, slot(_bodies.size());
+    for(const auto& e : axis) {
+      if(!e.max) {
+        for(int b : active) overlap(e.body, b, +1);
+        slot[size_t(e.body)] = int(active.size());
+        active.push_back(e.body);
+      }
+      else {
+        const int k = slot[size_t(e.body)];
+        active[size_t(k)] = active.back();
+        slot[size_t(active[size_t(k)])] = k;
+        active.pop_back();
+      }
+    }
+  }
+
+  // Closest points of the segments a0-a1 and b0-b1 (Ericson, Real-Time Collision Detection 5.1.9)
+  static float segmentDistance2(const Point& a0, const Point& a1, const Point& b0, const Point& b1, Point& pa, Point& pb) {
+
+    const GMlib::Vector<float,3> d1 = a1 - a0, d2 = b1 - b0, r = a0 - b0;
+    const float a = d1 * d1, e = d2 * d2, f = d2 * r;
+    const float eps = 1e-12f;
+
+    float s = 0.0f, t = 0.0f;
+    if(a <= eps && e <= eps) {}
+    else if(a <= eps) t = std::min(std::max(f / e, 0.0f), 1.0f);
+    else {
+      const float c = d1 * r;
+      if(e <= eps) s = std::min(std::max(-c / a, 0.0f), 1.0f);
+      else {
+        const float b = d1 * d2, denom = a * e - b * b;
+        s = denom > eps ? std::min(std::max((b * f - c * e) / denom, 0.0f), 1.0f) : 0.0f;
+        t = (b * s + f) / e;
+        if(t < 0.0f)      { t = 0.0f; s = std::min(std::max(-c / a, 0.0f), 1.0f); }
+        else if(t > 1.0f) { t = 1.0f; s = std::min(std::max((b - c) / a, 0.0f), 1.0f); }
+      }
+    }
+
+    pa = a0 + d1 * s;
+    pb = b0 + d2 * t;
+    const GMlib::Vector<float,3> d = pb - pa;
+    return d * d;
+  }
+
+  // Closest points of the segments of p and q if nearer than the contact distance
+  bool closest(const Body& p, const Body& q, std::vector<std::pair<std::uint64_t,int>>& cells, Contact& c) const {
+
+    const float r = _contact_distance;
+    float lo[3], hi[3];
+    for(int a = 0; a < 3; ++a) { lo[a] = std::max(p.lo[a], q.lo[a]) - r; hi[a] = std::min(p.hi[a], q.hi[a]) + r; }
+    auto inside = [&](const Body& b, const Edge& e) {
+      const Point& x = b.world[size_t(e.first)];
+      const Point& y = b.world[size_t(e.second)];
+      for(int a = 0; a < 3; ++a)
+        if(std::max(x[a], y[a]) < lo[a] || std::min(x[a], y[a]) > hi[a]) return false;
+      return true;
+    };
+    auto mid = [](const Body& b, const Edge& e) { return (b.world[size_t(e.first)] + b.world[size_t(e.second)]) * 0.5f; };
+
+    // Segments closer than r have midpoints closer than r plus their half lengths
+    const float h = r + 0.5f * (p.longest + q.longest);
+    auto cell = [h](const Point& x, int d0, int d1, int d2) {
+      return (std::uint64_t(std::int64_t(std::floor(x[0] / h)) + d0 + (1 << 20)) & 0x1fffff) << 42 |
+             (std::uint64_t(std::int64_t(std::floor(x[1] / h)) + d1 + (1 << 20)) & 0x1fffff) << 21 |
+             (std::uint64_t(std::int64_t(std::floor(x[2] / h)) + d2 + (1 << 20)) & 0x1fffff);
+    };
+
+    cells.clear();
+    for(size_t k = 0; k < q.edges.size(); ++k)
+      if(inside(q, q.edges[k])) cells.emplace_back(cell(mid(q, q.edges[k]), 0, 0, 0), int(k));
+    if(cells.empty()) return false;
+    std::sort(cells.begin(), cells.end());
+
+    float best = r * r;
+    bool  hit  = false;
+    Point pa, pb;
+    for(const Edge& ep : p.edges) {
+      if(!inside(p, ep)) continue;
+      const Point& p0 = p.world[size_t(ep.first)];
+      const Point& p1 = p.world[size_t(ep.second)];
+      const Point  x  = mid(p, ep);
+      for(int d = 0; d < 27; ++d) {
+        const auto key = cell(x, d % 3 - 1, d / 3 % 3 - 1, d / 9 - 1);
+        for(auto it = std::lower_bound(cells.begin(), cells.end(), std::make_pair(key, 0));
+            it != cells.end() && it->first == key; ++it) {
+          const Edge& eq = q.edges[size_t(it->second)];
+          const float d2 = segmentDistance2(p0, p1, q.world[size_t(eq.first)], q.world[size_t(eq.second)], pa, pb);
+          if(d2 < best) {
+            best       = d2;
+            hit        = true;
+            c.point    = (pa + pb) * 0.5f;
+          }
+        }
+      }
+    }
+    if(!hit) return false;
+
+    c.distance = std::sqrt(best);
+    return true;
+  }
+};
+
+#endif // COLLISION_DETECTOR_H
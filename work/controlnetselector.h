@@ -0,0 +1,372 @@
+#ifndef CONTROL_NET_SELECTOR_H
+#define CONTROL_NET_SELECTOR_H
+
+#include "streamring.h"
+
+// gmlib
+#include <scene/gmsceneobject.h>
+#include <opengl/gmprogram.h>
+#include <opengl/bufferobjects/gmvertexbufferobject.h>
+#include <scene/render/gmdefaultrenderer.h>
+#include <scene/camera/gmcamera.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <vector>
+
+/*!
+ *  ControlNetSelector
+ *
+ *  One selector object for a whole control net, instead of one GMlib Selector scene object
+ *  (and draw call) per control point.
+ *
+ *  - The controls are a single point VBO, drawn with one call, plus one call for the
+ *    selected ones. Moved controls are re-uploaded as one sub range per frame, through the
+ *    shared StreamRing when there is one.
+ *  - Picking: the object is found by the select renderer like any selector; the control
+ *    under the cursor is then found in screen space. The projected controls are bucketed
+ *    in a grid of PickCell pixel cells (counting sort), rebuilt only when the camera, the
+ *    viewport or the net changed; a pick looks at the cells around the cursor.
+ *  - Editing is by index through Net::set, so the owner replots only what the moved
+ *    controls affect (e.g. MyB_spline::setControlPoint invalidates their spans).
+ *  - The selector is a child of the owner and shares its frame.
+ */
+class ControlNetSelector : public GMlib::SceneObject {
+  GM_SCENEOBJECT(ControlNetSelector)
+public:
+  using Point = GMlib::Vector<float,3>;
+
+  static constexpr int PickCell = 16;   // Pixels
+
+  // Access to the control net being edited
+  struct Net {
+    std::function<int()>                      size;
+    std::function<Point(int)>                 get;
+    std::function<void(int, const Point&)>    set;    // The owner schedules its replot
+  };
+
+  // Net of an object with getNumControlPoints(), getControlPoint(i) and setControlPoint(i, p)
+  template <typename Obj>
+  static Net netOf(Obj* obj) {
+
+    return Net { [obj] { return obj->getNumControlPoints(); },
+                 [obj](int i) { return Point(obj->getControlPoint(i)); },
+                 [obj](int i, const Point& p) { obj->setControlPoint(i, p); obj->setEditDone(); } };
+  }
+
+  // Show or hide the control net selector of obj; created as a child of obj on first use
+  template <typename Obj>
+  static ControlNetSelector* toggle(Obj* obj) {
+
+    for(int i = 0; i < obj->getChildren().getSize(); ++i)
+      if(auto sel = dynamic_cast<ControlNetSelector*>(obj->getChildren()[i])) {
+        sel->setVisible(!sel->isVisible());
+        if(!sel->isVisible()) sel->clearControlSelection();
+        return sel;
+      }
+
+    auto sel = new ControlNetSelector(netOf(obj));
+    obj->insert(sel);
+    return sel;
+  }
+
+  explicit ControlNetSelector(Net net, float point_size = 8.0f)
+    : _net(std::move(net)), _point_size(point_size) {
+
+    _type_id = GMlib::GM_SO_TYPE_SELECTOR;
+    reload();
+  }
+
+  int size() const { return int(_points.size()); }
+
+  // Re-read the whole net, e.g. after the owner was refitted
+  void reload() {
+
+    _points.resize(size_t(std::max(_net.size(), 0)));
+    for(int i = 0; i < size(); ++i) _points[size_t(i)] = _net.get(i);
+    _selected.assign(_points.size(), 0);
+    _no_selected = 0;
+    _dirty_first = 0;
+    _dirty_last = size();
+    _resized = true;
+    _projected_valid = false;
+    updateSphere();
+  }
+
+  // Control under pos (GMlib view coordinates; origin lower left) within radius pixels,
+  // the one nearest the camera on ties; -1 if none
+  int pick(const GMlib::Camera* cam, const GMlib::Point<int,2>& pos, float radius = 8.0f) {
+
+    project(cam);
+
+    const float r2 = radius * radius;
+    float best_d2 = std::numeric_limits<float>::max(), best_z = std::numeric_limits<float>::max();
+    int best = -1;
+
+    const int x0 = std::max(int(std::floor((pos(0) - radius) / PickCell)), 0);
+    const int x1 = std::min(int(std::floor((pos(0) + radius) / PickCell)), _cols - 1);
+    const int y0 = std::max(int(std::floor((pos(1) - radius) / PickCell)), 0);
+    const int y1 = std::min(int(std::floor((pos(1) + radius) / PickCell)), _rows - 1);
+    for(int y = y0; y <= y1; ++y)
+      for(int x = x0; x <= x1; ++x) {
+        const int c = y * _cols + x;
+        for(int k = _cell_start[size_t(c)]; k < _cell_start[size_t(c) + 1]; ++k) {
+          const int i = _cell_items[size_t(k)];
+          const Projected& p = _projected[size_t(i)];
+          const float dx = p.x - pos(0), dy = p.y - pos(1), d2 = dx * dx + dy * dy;
+          if(d2 > r2) continue;
+          if(p.z < best_z || (p.z == best_z && d2 < best_d2)) { best = i; best_z = p.z; best_d2 = d2; }
+        }
+      }
+    return best;
+  }
+
+  void selectControl(int i, bool state) {
+
+    if(i < 0 || i >= size() || bool(_selected[size_t(i)]) == state) return;
+    _selected[size_t(i)] = state ? 1 : 0;
+    _no_selected += state ? 1 : -1;
+    _selection_changed = true;
+  }
+
+  bool isControlSelected(int i) const { return i >= 0 && i < size() && _selected[size_t(i)]; }
+  int  selectedControls() const { return _no_selected; }
+
+  std::vector<int> selectedIndices() const {
+
+    std::vector<int> indices;
+    indices.reserve(size_t(_no_selected));
+    for(int i = 0; i < size(); ++i)
+      if(_selected[size_t(i)]) indices.push_back(i);
+    return indices;
+  }
+
+  const Point& control(int i) const { return _points[size_t(i)]; }
+
+  // Set control i (net frame) through the owner
+  void setControl(int i, const Point& p) {
+
+    _points[size_t(i)] = p;
+    _net.set(i, p);
+    _dirty_first = std::min(_dirty_first, i);
+    _dirty_last = std::max(_dirty_last, i + 1);
+    if(_selected[size_t(i)]) _selection_changed = true;
+    _projected_valid = false;
+    updateSphere();
+  }
+
+  void clearControlSelection() {
+
+    if(_no_selected == 0) return;
+    std::fill(_selected.begin(), _selected.end(), 0);
+    _no_selected = 0;
+    _selection_changed = true;
+  }
+
+  // Move the selected controls by the displacement delta, given in scene coordinates
+  void moveSelected(const GMlib::Vector<float,3>& delta) {
+
+    if(_no_selected == 0) return;
+
+    // Into the net's frame: the inverse of the linear part of the global matrix, which may
+    // scale as well as rotate (cofactors over the determinant)
+    const GMlib::HqMatrix<float,3>& m = getMatrixGlobal();
+    auto a = [&m](int r, int c) { return double(m(r % 3)(c % 3)); };
+    double inv[3][3];
+    for(int r = 0; r < 3; ++r)
+      for(int c = 0; c < 3; ++c)
+        inv[c][r] = a(r + 1, c + 1) * a(r + 2, c + 2) - a(r + 1, c + 2) * a(r + 2, c + 1);
+    const double det = a(0, 0) * inv[0][0] + a(0, 1) * inv[1][0] + a(0, 2) * inv[2][0];
+    if(std::abs(det) < 1e-12) return;   // Degenerate frame; no displacement maps onto it
+
+    Point d(0.0f, 0.0f, 0.0f);
+    for(int i = 0; i < 3; ++i)
+      d[i] = float((inv[i][0] * delta(0) + inv[i][1] * delta(1) + inv[i][2] * delta(2)) / det);
+
+    for(int i = 0; i < size(); ++i) {
+      if(!_selected[size_t(i)]) continue;
+      _points[size_t(i)] += d;
+      _net.set(i, _points[size_t(i)]);
+      _dirty_first = std::min(_dirty_first, i);
+      _dirty_last = std::max(_dirty_last, i + 1);
+    }
+    _selection_changed = true;
+    _projected_valid = false;
+    updateSphere();
+  }
+
+protected:
+  void localDisplay(const GMlib::DefaultRenderer* renderer) const override {
+
+    upload();
+    draw(renderer->getCamera(), GMlib::GMcolor::lightGrey(), GMlib::GMcolor::yellow());
+  }
+
+  void localSelect(const GMlib::Renderer* renderer, const GMlib::Color& color) const override {
+
+    upload();
+    draw(renderer->getCamera(), color, color);
+  }
+
+private:
+  struct Projected { float x, y, z; };
+
+  Net                               _net;
+  float                             _point_size;
+  std::vector<Point>                _points;          // Net frame
+  std::vector<char>                 _selected;
+  int                               _no_selected {0};
+
+  // GL state, updated on the render thread
+  mutable GMlib::GL::Program             _prog;
+  mutable GMlib::GL::VertexBufferObject  _vbo;
+  mutable GMlib::GL::VertexBufferObject  _selected_vbo;
+  mutable bool                           _gl_ready {false};
+  mutable bool                           _resized {true};
+  mutable int                            _dirty_first {0}, _dirty_last {0};
+  mutable bool                           _selection_changed {true};
+  mutable GLsizei                        _no_selected_vertices {0};
+
+  // Screen space buckets
+  std::vector<Projected>            _projected;
+  std::vector<int>                  _cell_start, _cell_items;
+  int                               _cols {0}, _rows {0};
+  bool                              _projected_valid {false};
+  float                             _projected_mvp[16] {};
+  int                               _projected_w {0}, _projected_h {0};
+
+  void updateSphere() {
+
+    if(_points.empty()) return;
+    Point lo = _points[0], hi = lo;
+    for(const auto& p : _points)
+      for(int j = 0; j < 3; ++j) { lo[j] = std::min(lo[j], p(j)); hi[j] = std::max(hi[j], p(j)); }
+    setSurroundingSphere(GMlib::Sphere<float,3>((lo + hi) * 0.5f, 0.5f * (hi - lo).getLength() + 1e-3f));
+  }
+
+  void project(const GMlib::Camera* cam) {
+
+    const GMlib::HqMatrix<float,3>& mvp = getModelViewProjectionMatrix(cam);
+    const int w = cam->getViewportW(), h = cam->getViewportH();
+
+    bool same = _projected_valid && w == _projected_w && h == _projected_h;
+    for(int k = 0; k < 16 && same; ++k) same = mvp(k / 4)(k % 4) == _projected_mvp[k];
+    if(same) return;
+
+    for(int k = 0; k < 16; ++k) _projected_mvp[k] = mvp(k / 4)(k % 4);
+    _projected_w = w;
+    _projected_h = h;
+    _projected_valid = true;
+
+    _cols = std::max(w / PickCell + 1, 1);
+    _rows = std::max(h / PickCell + 1, 1);
+    _projected.resize(_points.size());
+    _cell_start.assign(size_t(_cols) * size_t(_rows) + 1, 0);
+
+    // Counting sort into cells; controls behind the camera or off screen are left out
+    std::vector<int> cell(_points.size(), -1);
+    for(size_t i = 0; i < _points.size(); ++i) {
+      const Point& p = _points[i];
+      float c[4];
+      for(int r = 0; r < 4; ++r) c[r] = mvp(r)(0) * p(0) + mvp(r)(1) * p(1) + mvp(r)(2) * p(2) + mvp(r)(3);
+      if(c[3] <= 0.0f) continue;
+
+      Projected& q = _projected[i];
+      q.x = (c[0] / c[3] * 0.5f + 0.5f) * w;
+      q.y = (c[1] / c[3] * 0.5f + 0.5f) * h;
+      q.z = c[2] / c[3];
+      if(q.x < 0.0f || q.y < 0.0f || q.x >= w || q.y >= h) continue;
+
+      cell[i] = int(q.y) / PickCell * _cols + int(q.x) / PickCell;
+      ++_cell_start[size_t(cell[i]) + 1];
+    }
+    for(size_t c = 1; c < _cell_start.size(); ++c) _cell_start[c] += _cell_start[c - 1];
+
+    _cell_items.resize(size_t(_cell_start.back()));
+    std::vector<int> fill(_cell_start.begin(), _cell_start.end() - 1);
+    for(size_t i = 0; i < _points.size(); ++i)
+      if(cell[i] >= 0) _cell_items[size_t(fill[size_t(cell[i])]++)] = int(i);
+  }
+
+  static GMlib::GL::GLVertex vertex(const Point& p) {
+
+    GMlib::GL::GLVertex v;
+    v.x = p(0); v.y = p(1); v.z = p(2);
+    return v;
+  }
+
+  // Pending VBO updates; the moved range of the net, and the selected controls
+  void upload() const {
+
+    if(!_gl_ready) {
+      _prog.acquire("color");
+      _vbo.create();
+      _selected_vbo.create();
+      _gl_ready = true;
+    }
+
+    if(_resized) {
+      _vbo.bufferData(_points.size() * sizeof(GMlib::GL::GLVertex), 0x0, GL_DYNAMIC_DRAW);
+      _resized = false;
+    }
+    if(_dirty_first < _dirty_last) {
+      const size_t count = size_t(_dirty_last - _dirty_first);
+      StreamRing*  ring  = StreamRing::shared();
+      const StreamRing::Allocation a = ring ? ring->allocate(count * sizeof(GMlib::GL::GLVertex)) : StreamRing::Allocation();
+      if(a) {
+        auto* v = static_cast<GMlib::GL::GLVertex*>(a.data);
+        for(int i = _dirty_first; i < _dirty_last; ++i) *v++ = vertex(_points[size_t(i)]);
+        ring->commit(a);
+        ring->copy(a, _vbo.getId(), _dirty_first * sizeof(GMlib::GL::GLVertex));
+      }
+      else {
+        std::vector<GMlib::GL::GLVertex> v;
+        v.reserve(count);
+        for(int i = _dirty_first; i < _dirty_last; ++i) v.push_back(vertex(_points[size_t(i)]));
+        _vbo.bufferSubData(_dirty_first * sizeof(GMlib::GL::GLVertex), v.size() * sizeof(GMlib::GL::GLVertex), v.data());
+      }
+      _dirty_first = std::numeric_limits<int>::max();
+      _dirty_last = 0;
+    }
+
+    if(_selection_changed) {
+      std::vector<GMlib::GL::GLVertex> v;
+      v.reserve(size_t(_no_selected));
+      for(size_t i = 0; i < _points.size(); ++i)
+        if(_selected[i]) v.push_back(vertex(_points[i]));
+      _selected_vbo.bufferData(v.size() * sizeof(GMlib::GL::GLVertex), v.data(), GL_DYNAMIC_DRAW);
+      _no_selected_vertices = GLsizei(v.size());
+      _selection_changed = false;
+    }
+  }
+
+  void draw(const GMlib::Camera* cam, const GMlib::Color& color, const GMlib::Color& selected_color) const {
+
+    if(_points.empty()) return;
+
+    _prog.bind(); {
+
+      _prog.uniform("u_mvpmat", getModelViewProjectionMatrix(cam));
+      GMlib::GL::AttributeLocation vert_loc = _prog.getAttributeLocation("in_vertex");
+
+      // Selected controls on top, slightly larger
+      auto points = [&](const GMlib::GL::VertexBufferObject& vbo, GLsizei count, const GMlib::Color& c, float size) {
+        if(count == 0) return;
+        _prog.uniform("u_color", c);
+        GL_CHECK(::glPointSize(size));
+        vbo.bind();
+        vbo.enable(vert_loc, 3, GL_FLOAT, GL_FALSE, sizeof(GMlib::GL::GLVertex), reinterpret_cast<const GLvoid*>(0x0));
+        GL_CHECK(::glDrawArrays(GL_POINTS, 0, count));
+        vbo.disable(vert_loc);
+        vbo.unbind();
+      };
+      points(_vbo, GLsizei(_points.size()), color, _point_size);
+      points(_selected_vbo, _no_selected_vertices, selected_color, 1.5f * _point_size);
+
+    } _prog.unbind();
+  }
+};
+
+#endif // CONTROL_NET_SELECTOR_H
@@ -0,0 +1,171 @@
+#ifndef CURVATURE_COMB_VISUALIZER_H
+#define CURVATURE_COMB_VISUALIZER_H
+
+#include "curveanalysis.h"
+#include "streamring.h"
+
+// gmlib
+#include <parametrics/visualizers/gmpcurvevisualizer.h>
+#include <opengl/gmprogram.h>
+#include <opengl/bufferobjects/gmvertexbufferobject.h>
+#include <scene/render/gmdefaultrenderer.h>
+#include <scene/camera/gmcamera.h>
+
+/*!
+ *  CurvatureCombVisualizer
+ *
+ *  Draws the curvature comb of a PCurve; one tooth per sample along the curvature
+ *  vector (pointing away from the center of curvature), scaled so the longest tooth
+ *  is a fixed fraction of the curve's extent, and the envelope through the tooth tips.
+ *
+ *  - The curve must be sampled with d >= 2 (d >= 3 for torsion).
+ *  - The analysis is cached alongside the sample buffer; on replot only the spans
+ *    whose samples changed are re-analysed, and only their part of the VBO is rewritten.
+ *  - Rewritten vertices are generated straight into the shared StreamRing and copied into
+ *    the VBO on the GPU; without a ring they go through bufferSubData.
+ */
+class CurvatureCombVisualizer : public GMlib::PCurveVisualizer<float,3> {
+  GM_VISUALIZER(CurvatureCombVisualizer)
+public:
+  explicit CurvatureCombVisualizer(float relative_size = 0.25f)
+    : _relative_size(relative_size) {
+
+    _prog.acquire("color");
+    _vbo.create();
+  }
+
+  const CurveAnalysis<float>& analysis() const { return _analysis; }
+
+  void setColor(const GMlib::Color& color) { _color = color; }
+
+  void replot(const GMlib::DVector<GMlib::DVector<GMlib::Vector<float,3>>>& p,
+              int m, int d, bool /*closed*/) override {
+
+    const auto& changed = _analysis.update(p, m, d);
+    const int   n       = _analysis.size();
+
+    if(n == 0) { _no_vertices = 0; return; }
+
+    // Comb scale; a new sample count (or first replot) rebuilds everything
+    float k_max = 0.0f;
+    for(auto k : _analysis.curvature()) k_max = std::max(k_max, k);
+    const bool resized = (_no_vertices != 4 * n - 2);
+    const bool rescale = resized || std::abs(k_max - _k_max) > 0.05f * _k_max;
+    if(rescale) {
+      _k_max = k_max;
+      _scale = k_max > 0.0f ? _relative_size * extent() / k_max : 0.0f;
+    }
+
+    // Vertex layout: n tooth lines (2n vertices), followed by n-1 envelope segments (2n-2 vertices)
+    if(resized) {
+      _no_vertices = 4 * n - 2;
+      _vbo.bufferData(_no_vertices * sizeof(GMlib::GL::GLVertex), 0x0, GL_DYNAMIC_DRAW);
+    }
+
+    if(rescale) { writeRange(0, n); return; }
+    for(const auto& r : changed) writeRange(r.first, r.last);
+  }
+
+  void render(const GMlib::SceneObject* obj, const GMlib::DefaultRenderer* renderer) const override {
+
+    if(_no_vertices == 0) return;
+
+    const GMlib::Camera* cam = renderer->getCamera();
+    const GMlib::HqMatrix<float,3>& mvpmat = obj->getModelViewProjectionMatrix(cam);
+
+    _prog.bind(); {
+
+      _prog.uniform("u_mvpmat", mvpmat);
+      _prog.uniform("u_color", _color);
+
+      GMlib::GL::AttributeLocation vert_loc = _prog.getAttributeLocation("in_vertex");
+
+      _vbo.bind();
+      _vbo.enable(vert_loc, 3, GL_FLOAT, GL_FALSE, sizeof(GMlib::GL::GLVertex), reinterpret_cast<const GLvoid*>(0x0));
+
+      GL_CHECK(::glDrawArrays(GL_LINES, 0, _no_vertices));
+
+      _vbo.disable(vert_loc);
+      _vbo.unbind();
+
+    } _prog.unbind();
+  }
+
+private:
+  GMlib::GL::Program              _prog;
+  GMlib::GL::VertexBufferObject   _vbo;
+  GMlib::Color                    _color {GMlib::GMcolor::yellow()};
+  GLsizei                         _no_vertices {0};
+
+  CurveAnalysis<float>            _analysis;
+  float                           _relative_size;
+  float                           _k_max {0.0f};
+  float                           _scale {0.0f};
+
+  float extent() const {
+
+    GMlib::Vector<float,3> lo = _analysis.position(0), hi = lo;
+    for(int i = 1; i < _analysis.size(); ++i) {
+      const auto p = _analysis.position(i);
+      for(int j = 0; j < 3; ++j) { lo[j] = std::min(lo[j], p(j)); hi[j] = std::max(hi[j], p(j)); }
+    }
+    return (hi - lo).getLength();
+  }
+
+  GMlib::GL::GLVertex vertex(const GMlib::Vector<float,3>& p) const {
+
+    GMlib::GL::GLVertex v;
+    v.x = p(0); v.y = p(1); v.z = p(2);
+    return v;
+  }
+
+  GMlib::Vector<float,3> tip(int i) const {
+
+    return _analysis.position(i) - _analysis.curvatureVector(i) * _scale;
+  }
+
+  // Vertices [first, first + count) of the VBO, generated by fill into the stream ring
+  // when there is one (and it has room), else into a staging vector
+  template <typename Fill>
+  void write(int first, int count, Fill fill) {
+
+    const size_t bytes = size_t(count) * sizeof(GMlib::GL::GLVertex);
+    if(StreamRing* ring = StreamRing::shared()) {
+      const StreamRing::Allocation a = ring->allocate(bytes);
+      if(a) {
+        fill(static_cast<GMlib::GL::GLVertex*>(a.data));
+        ring->commit(a);
+        if(ring->copy(a, _vbo.getId(), size_t(first) * sizeof(GMlib::GL::GLVertex))) return;
+      }
+    }
+
+    std::vector<GMlib::GL::GLVertex> v(size_t(count));
+    fill(v.data());
+    _vbo.bufferSubData(first * sizeof(GMlib::GL::GLVertex), bytes, v.data());
+  }
+
+  // Rewrite the teeth of samples [first, last), and the envelope segments touching them
+  void writeRange(int first, int last) {
+
+    const int n = _analysis.size();
+
+    write(2 * first, 2 * (last - first), [&](GMlib::GL::GLVertex* teeth) {
+      for(int i = first; i < last; ++i) {
+        teeth[2 * (i - first)]     = vertex(_analysis.position(i));
+        teeth[2 * (i - first) + 1] = vertex(tip(i));
+      }
+    });
+
+    const int s0 = std::max(first - 1, 0), s1 = std::min(last, n - 1);
+    if(s1 <= s0) return;
+
+    write(2 * n + 2 * s0, 2 * (s1 - s0), [&](GMlib::GL::GLVertex* envelope) {
+      for(int i = s0; i < s1; ++i) {
+        envelope[2 * (i - s0)]     = vertex(tip(i));
+        envelope[2 * (i - s0) + 1] = vertex(tip(i + 1));
+      }
+    });
+  }
+};
+
+#endif // CURVATURE_COMB_VISUALIZER_H
@@ -0,0 +1,252 @@
+#ifndef CURVE_ANALYSIS_H
+#define CURVE_ANALYSIS_H
+
+#include <core/containers/gmdvector.h>
+#include <core/types/gmpoint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+/*!
+ *  CurveAnalysis<T>
+ *
+ *  Differential geometry of a sampled space curve; curvature, torsion and their arc
+ *  length derivatives for whole sample arrays.
+ *
+ *  - Samples are held as a structure of arrays; the kernels run over contiguous,
+ *    branch free batches which the compiler turns into SIMD code (at -O3, with
+ *    -fno-math-errno and -fno-trapping-math; see CMakeLists.txt).
+ *  - Everything is computed from the analytic derivatives of the samples; c' and c''
+ *    for curvature, c''' for torsion and dkappa/ds. dtorsion/ds is the only finite
+ *    difference, it would otherwise need c''''.
+ *  - With d == 2 there is no c'''; torsion and both arc length derivatives are not
+ *    computed and their arrays are empty (hasTorsion() is false).
+ *  - Results are cached per chunk of samples; update() compares the new samples with
+ *    the cached ones and only recomputes the chunks that changed (edited spans).
+ *
+ *  Input is a GMlib sample buffer, as handed to PCurveVisualizer::replot():
+ *  p[i][0] position, p[i][k] k-th derivative.
+ */
+template <typename T>
+class CurveAnalysis {
+public:
+  static constexpr int ChunkSize = 64;     // Samples per cache chunk (change granularity)
+
+  struct Range { int first; int last; };   // Changed samples; [first, last)
+
+  int             size() const { return _m; }
+  bool            hasTorsion() const { return _d > 2; }
+
+  // Results; per sample. torsion() and the derivatives only if hasTorsion(), else empty
+  const std::vector<T>& curvature() const { return _kappa; }
+  const std::vector<T>& torsion() const { return _tau; }
+  const std::vector<T>& curvatureDerivative() const { return _dkappa; }   // dkappa/ds
+  const std::vector<T>& torsionDerivative() const { return _dtau; }       // dtau/ds
+
+  GMlib::Vector<T,3> position(int i) const { return GMlib::Vector<T,3>(_px[i], _py[i], _pz[i]); }
+  GMlib::Vector<T,3> curvatureVector(int i) const { return GMlib::Vector<T,3>(_kx[i], _ky[i], _kz[i]); }
+
+  /*!
+   *  update(p, m, d)
+   *
+   *  - Takes over a new sample buffer; m samples with d derivatives.
+   *  - Returns the ranges of samples whose analysis changed; all of them if the
+   *    number of samples or derivatives changed.
+   */
+  const std::vector<Range>& update(const GMlib::DVector<GMlib::DVector<GMlib::Vector<T,3>>>& p, int m, int d) {
+
+    _changed.clear();
+    if(m < 2 || d < 2) { resize(0, d); return _changed; }
+
+    const bool full = (m != _m || d != _d);
+    if(full) resize(m, d);
+
+    for(int c = 0; c * ChunkSize < m; ++c) {
+
+      const int first = c * ChunkSize;
+      const int last  = std::min(first + ChunkSize, m);
+
+      const bool changed = load(p, first, last);
+      if(!full && !changed) continue;
+
+      compute(first, last);
+
+      // Merge consecutive chunks into one range
+      if(!_changed.empty() && _changed.back().last == first) _changed.back().last = last;
+      else _changed.push_back({first, last});
+    }
+
+    if(_d < 3) return _changed;
+
+    // dtau/ds couples neighbouring samples; widen each range by one sample on each side
+    for(auto& r : _changed) {
+      r.first = std::max(r.first - 1, 0);
+      r.last  = std::min(r.last + 1, _m);
+      torsionDerivative(r.first, r.last);
+    }
+
+    return _changed;
+  }
+
+private:
+  int               _m {0};
+  int               _d {0};
+  std::vector<Range> _changed;
+
+  // Samples (structure of arrays)
+  std::vector<T>    _px, _py, _pz;
+  std::vector<T>    _ax, _ay, _az;   // c'
+  std::vector<T>    _bx, _by, _bz;   // c''
+  std::vector<T>    _cx, _cy, _cz;   // c'''; empty if not sampled (d == 2)
+
+  // Results
+  std::vector<T>    _speed, _kappa, _tau, _dkappa, _dtau;
+  std::vector<T>    _kx, _ky, _kz;   // Curvature vector; kappa * principal normal
+
+  void resize(int m, int d) {
+
+    _m = m;
+    _d = d;
+    for(auto* v : { &_px, &_py, &_pz, &_ax, &_ay, &_az, &_bx, &_by, &_bz,
+                    &_speed, &_kappa, &_kx, &_ky, &_kz })
+      v->assign(size_t(m), T(0));
+
+    const size_t m3 = d > 2 ? size_t(m) : 0;
+    for(auto* v : { &_cx, &_cy, &_cz, &_tau, &_dkappa, &_dtau })
+      v->assign(m3, T(0));
+  }
+
+  static bool store(std::vector<T>& v, int i, T x) {
+    const bool changed = v[size_t(i)] != x;
+    v[size_t(i)] = x;
+    return changed;
+  }
+
+  // Copy samples [first, last) into the cache; returns true if anything changed
+  bool load(const GMlib::DVector<GMlib::DVector<GMlib::Vector<T,3>>>& p, int first, int last) {
+
+    bool changed = false;
+    for(int i = first; i < last; ++i) {
+
+      const auto& s = p(i);
+      changed |= store(_px, i, s(0)(0)) | store(_py, i, s(0)(1)) | store(_pz, i, s(0)(2));
+      changed |= store(_ax, i, s(1)(0)) | store(_ay, i, s(1)(1)) | store(_az, i, s(1)(2));
+      changed |= store(_bx, i, s(2)(0)) | store(_by, i, s(2)(1)) | store(_bz, i, s(2)(2));
+      if(_d > 2)
+        changed |= store(_cx, i, s(3)(0)) | store(_cy, i, s(3)(1)) | store(_cz, i, s(3)(2));
+    }
+    return changed;
+  }
+
+  // Batch kernels for samples [first, last); curvature and curvature vector, then torsion
+  // and dkappa/ds if c''' is sampled
+  void compute(int first, int last) {
+
+    const size_t f = size_t(first);
+    const int    n = last - first;
+
+    curvature(n, &_ax[f], &_ay[f], &_az[f], &_bx[f], &_by[f], &_bz[f],
+              &_speed[f], &_kappa[f], &_kx[f], &_ky[f], &_kz[f]);
+    if(_d > 2)
+      torsion(n, &_ax[f], &_ay[f], &_az[f], &_bx[f], &_by[f], &_bz[f], &_cx[f], &_cy[f], &_cz[f],
+              &_tau[f], &_dkappa[f]);
+  }
+
+  // The arrays are restrict parameters; GCC ignores restrict on local pointers and would
+  // otherwise need more run time alias checks than it is willing to emit
+  static void curvature(int n,
+                        const T* __restrict ax, const T* __restrict ay, const T* __restrict az,
+                        const T* __restrict bx, const T* __restrict by, const T* __restrict bz,
+                        T* __restrict speed, T* __restrict kappa,
+                        T* __restrict kx, T* __restrict ky, T* __restrict kz) {
+
+    const T eps = T(1e-12);
+
+    for(int i = 0; i < n; ++i) {
+
+      // w = c' x c''
+      const T wx = ay[i]*bz[i] - az[i]*by[i];
+      const T wy = az[i]*bx[i] - ax[i]*bz[i];
+      const T wz = ax[i]*by[i] - ay[i]*bx[i];
+
+      const T a2 = ax[i]*ax[i] + ay[i]*ay[i] + az[i]*az[i];
+      const T a1 = std::sqrt(a2);
+      const T w1 = std::sqrt(wx*wx + wy*wy + wz*wz);
+      const T ab = ax[i]*bx[i] + ay[i]*by[i] + az[i]*bz[i];
+
+      const T inv_a2 = T(1) / std::max(a2, eps);
+      const T inv_a3 = T(1) / std::max(a2 * a1, eps);
+
+      speed[i] = a1;
+
+      // kappa = |c' x c''| / |c'|^3
+      kappa[i] = w1 * inv_a3;
+
+      // Curvature vector; the component of c'' orthogonal to c', over |c'|^2
+      kx[i] = (bx[i] - ab * inv_a2 * ax[i]) * inv_a2;
+      ky[i] = (by[i] - ab * inv_a2 * ay[i]) * inv_a2;
+      kz[i] = (bz[i] - ab * inv_a2 * az[i]) * inv_a2;
+    }
+  }
+
+  static void torsion(int n,
+                      const T* __restrict ax, const T* __restrict ay, const T* __restrict az,
+                      const T* __restrict bx, const T* __restrict by, const T* __restrict bz,
+                      const T* __restrict cx, const T* __restrict cy, const T* __restrict cz,
+                      T* __restrict tau, T* __restrict dkappa) {
+
+    const T eps = T(1e-12);
+
+    for(int i = 0; i < n; ++i) {
+
+      // w = c' x c''
+      const T wx = ay[i]*bz[i] - az[i]*by[i];
+      const T wy = az[i]*bx[i] - ax[i]*bz[i];
+      const T wz = ax[i]*by[i] - ay[i]*bx[i];
+
+      // v = c' x c'''; dw/dt
+      const T vx = ay[i]*cz[i] - az[i]*cy[i];
+      const T vy = az[i]*cx[i] - ax[i]*cz[i];
+      const T vz = ax[i]*cy[i] - ay[i]*cx[i];
+
+      const T a2 = ax[i]*ax[i] + ay[i]*ay[i] + az[i]*az[i];
+      const T a1 = std::sqrt(a2);
+      const T a3 = a2 * a1;
+      const T w1 = std::sqrt(wx*wx + wy*wy + wz*wz);
+      const T ab = ax[i]*bx[i] + ay[i]*by[i] + az[i]*bz[i];
+
+      const T inv_a3 = T(1) / std::max(a3, eps);
+      const T inv_w1 = T(1) / std::max(w1, eps);
+
+      // tau = (c' x c'') . c''' / |c' x c''|^2
+      tau[i] = (wx*cx[i] + wy*cy[i] + wz*cz[i]) * inv_w1 * inv_w1;
+
+      // dkappa/dt = (d|w|/dt |c'|^3 - 3 |w| |c'|^2 d|c'|/dt) / |c'|^6,
+      //   d|w|/dt = w . (c' x c''') / |w|,  d|c'|/dt = c' . c'' / |c'|
+      const T dw = (wx*vx + wy*vy + wz*vz) * inv_w1;
+      const T da = ab / std::max(a1, eps);
+      const T dk = (dw * a3 - T(3) * w1 * a2 * da) * inv_a3 * inv_a3;
+
+      // d/ds = 1/|c'| d/dt
+      dkappa[i] = dk / std::max(a1, eps);
+    }
+  }
+
+  // dtau/ds by central differences in arc length; samples [first, last)
+  void torsionDerivative(int first, int last) {
+
+    for(int i = first; i < last; ++i) {
+
+      const int i0 = std::max(i - 1, 0), i1 = std::min(i + 1, _m - 1);
+      const T dx = _px[size_t(i1)] - _px[size_t(i0)];
+      const T dy = _py[size_t(i1)] - _py[size_t(i0)];
+      const T dz = _pz[size_t(i1)] - _pz[size_t(i0)];
+      const T ds = std::sqrt(dx*dx + dy*dy + dz*dz);
+
+      _dtau[size_t(i)] = ds > T(0) ? (_tau[size_t(i1)] - _tau[size_t(i0)]) / ds : T(0);
+    }
+  }
+};
+
+#endif // CURVE_ANALYSIS_H
@@ -0,0 +1,212 @@
+#ifndef CYCLIC_BANDED_SOLVER_H
+#define CYCLIC_BANDED_SOLVER_H
+
+#include "bandedlu.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+/*!
+ *  CyclicBandedSolver<T>
+ *
+ *  Solver for cyclic banded n x n matrices; A(i,j) is non-zero only if the cyclic distance
+ *  between i and j is at most k. These arise from periodic splines: the band of the
+ *  open case plus k x k corner blocks coupling the first and the last unknowns.
+ *
+ *  Sherman-Morrison-Woodbury, in bordered form:
+ *
+ *      A = | B  C |   B (n-k) x (n-k) banded (no corners),  E k x k
+ *          | D  E |
+ *
+ *  - B is factorized by BandedLU; Z = B^-1 C takes k banded solves.
+ *  - The capacitance matrix S = E - D Z (the Schur complement; k x k) is factorized densely.
+ *  - A solve is one banded solve, a k x k solve and an O(n k) correction; factorization
+ *    and solve are linear in n, with O(n k) memory.
+ *
+ *  Systems with n < 2k + 2 have no proper band (the corners overlap) and are solved densely.
+ */
+template <typename T>
+class CyclicBandedSolver {
+public:
+  CyclicBandedSolver() = default;
+  CyclicBandedSolver(int n, int k) { resize(n, k); }
+
+  void resize(int n, int k) {
+
+    _n = n;
+    _k = k;
+    _dense = n < 2 * k + 2;
+    _m = _dense ? 0 : n - k;
+    _a.assign(size_t(n) * size_t(_dense ? n : 2 * k + 1), T(0));
+    _factorized = false;
+  }
+
+  int  size() const { return _n; }
+  bool isFactorized() const { return _factorized; }
+
+  // Element (i, j); j is taken modulo n and must be within cyclic distance k of i (asserted;
+  // anything further out would alias a neighbouring element of row i's band storage).
+  // Assemble with +=; on small (dense) systems two cyclic offsets may denote the same element.
+  T&       operator()(int i, int j)       { return _a[index(i, j)]; }
+  const T& operator()(int i, int j) const { return _a[index(i, j)]; }
+
+  /*!
+   *  factorize()
+   *
+   *  - Returns false if the matrix is (numerically) singular, or if B needs pivoting.
+   */
+  bool factorize() {
+
+    _factorized = false;
+
+    if(_dense) {
+      _s = _a;
+      return _factorized = denseFactorize(_s, _piv, _n);
+    }
+
+    // Banded block B
+    _b.resize(_m, _k, _k);
+    for(int i = 0; i < _m; ++i)
+      for(int j = std::max(0, i - _k); j <= std::min(_m - 1, i + _k); ++j)
+        _b(i, j) = (*this)(i, j);
+    if(!_b.factorize()) return false;
+
+    // Z = B^-1 C; column c of C is column m + c of A, non-zero in the first and last k rows
+    _z.assign(size_t(_m) * size_t(_k), T(0));
+    std::vector<T> col(static_cast<size_t>(_m));
+    for(int c = 0; c < _k; ++c) {
+
+      std::fill(col.begin(), col.end(), T(0));
+      for(int i = 0; i < _m; ++i)
+        if(cyclicDistance(i, _m + c) <= _k) col[size_t(i)] = (*this)(i, _m + c);
+
+      _b.solve(col.data());
+      for(int i = 0; i < _m; ++i) _z[size_t(i * _k + c)] = col[size_t(i)];
+    }
+
+    // Capacitance matrix S = E - D Z
+    _s.assign(size_t(_k * _k), T(0));
+    for(int r = 0; r < _k; ++r) {
+      for(int c = 0; c < _k; ++c) {
+
+        T s = cyclicDistance(_m + r, _m + c) <= _k ? (*this)(_m + r, _m + c) : T(0);
+        forEachBorderColumn(r, [&](int j, T d) { s -= d * _z[size_t(j * _k + c)]; });
+        _s[size_t(r * _k + c)] = s;
+      }
+    }
+
+    return _factorized = denseFactorize(_s, _piv, _k);
+  }
+
+  /*!
+   *  solve(b)
+   *
+   *  - Solves A x = b in place for a factorized matrix; b holds n right hand sides.
+   *  - V is any type with V * T, V -= V and V = V, e.g. T itself or GMlib::Vector<T,n>.
+   */
+  template <typename V>
+  void solve(V* b) const {
+
+    if(_dense) { denseSolve(_s, _piv, _n, b); return; }
+
+    // y = B^-1 b1
+    _b.solve(b);
+
+    // x2 = S^-1 (b2 - D y)
+    for(int r = 0; r < _k; ++r)
+      forEachBorderColumn(r, [&](int j, T d) { b[_m + r] -= b[j] * d; });
+    denseSolve(_s, _piv, _k, b + _m);
+
+    // x1 = y - Z x2
+    for(int i = 0; i < _m; ++i)
+      for(int c = 0; c < _k; ++c)
+        b[i] -= b[_m + c] * _z[size_t(i * _k + c)];
+  }
+
+private:
+  int               _n {0};
+  int               _k {0};
+  int               _m {0};           // Size of the banded block B
+  bool              _dense {false};
+  std::vector<T>    _a;               // Cyclic band; row i holds offsets -k, ..., k (dense: full rows)
+  bool              _factorized {false};
+
+  BandedLU<T>       _b;
+  std::vector<T>    _z;               // B^-1 C; m x k, row major
+  std::vector<T>    _s;               // Factorized capacitance matrix (dense: the whole matrix)
+  std::vector<int>  _piv;
+
+  int cyclicOffset(int i, int j) const {
+
+    int d = ((j - i) % _n + _n) % _n;
+    if(d > _n / 2) d -= _n;
+    return d;
+  }
+
+  int cyclicDistance(int i, int j) const { return std::abs(cyclicOffset(i, j)); }
+
+  size_t index(int i, int j) const {
+
+    assert(i >= 0 && i < _n);
+    if(_dense) return size_t(i) * size_t(_n) + size_t(((j % _n) + _n) % _n);
+
+    const int o = cyclicOffset(i, j);
+    assert(std::abs(o) <= _k && "CyclicBandedSolver: element outside the cyclic band");
+    return size_t(i) * size_t(2 * _k + 1) + size_t(o + _k);
+  }
+
+  // Calls f(j, D(r, j)) for the non-zeros of border row m + r inside columns 0, ..., m - 1
+  template <typename F>
+  void forEachBorderColumn(int r, F f) const {
+
+    const int i = _m + r;
+    for(int o = -_k; o <= _k; ++o) {
+      const int j = ((i + o) % _n + _n) % _n;
+      if(j < _m) f(j, (*this)(i, j));
+    }
+  }
+
+  // Dense LU with partial pivoting, in place; n x n row major
+  static bool denseFactorize(std::vector<T>& a, std::vector<int>& piv, int n) {
+
+    piv.resize(size_t(n));
+    for(int k = 0; k < n; ++k) {
+
+      int p = k;
+      for(int i = k + 1; i < n; ++i)
+        if(std::abs(a[size_t(i * n + k)]) > std::abs(a[size_t(p * n + k)])) p = i;
+      piv[size_t(k)] = p;
+
+      if(std::abs(a[size_t(p * n + k)]) <= std::numeric_limits<T>::min()) return false;
+      if(p != k)
+        for(int j = 0; j < n; ++j) std::swap(a[size_t(k * n + j)], a[size_t(p * n + j)]);
+
+      for(int i = k + 1; i < n; ++i) {
+        const T l = a[size_t(i * n + k)] / a[size_t(k * n + k)];
+        a[size_t(i * n + k)] = l;
+        for(int j = k + 1; j < n; ++j) a[size_t(i * n + j)] -= l * a[size_t(k * n + j)];
+      }
+    }
+    return true;
+  }
+
+  template <typename V>
+  static void denseSolve(const std::vector<T>& a, const std::vector<int>& piv, int n, V* b) {
+
+    for(int k = 0; k < n; ++k)
+      if(piv[size_t(k)] != k) std::swap(b[k], b[piv[size_t(k)]]);
+
+    for(int i = 1; i < n; ++i)
+      for(int j = 0; j < i; ++j) b[i] -= b[j] * a[size_t(i * n + j)];
+
+    for(int i = n - 1; i >= 0; --i) {
+      for(int j = i + 1; j < n; ++j) b[i] -= b[j] * a[size_t(i * n + j)];
+      b[i] = b[i] * (T(1) / a[size_t(i * n + i)]);
+    }
+  }
+};
+
+#endif // CYCLIC_BANDED_SOLVER_H
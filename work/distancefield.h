@@ -0,0 +1,476 @@
+#ifndef DISTANCE_FIELD_H
+#define DISTANCE_FIELD_H
+
+#include "parallelfor.h"
+
+#include <parametrics/gmpcurve.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+/*!
+ *  DistanceField
+ *
+ *  Distance to a set of line segments (sampled curves) on a regular 3D grid; a 2D field
+ *  is a grid with nz == 1.
+ *
+ *  - Seeding: every segment writes exact distances into the cells of its bounding box,
+ *    widened by a band of cells; cost proportional to the curve length, not to the grid
+ *    size times the number of segments. Cells closer than one cell size to a segment are
+ *    the sites; every point of the curves lies in a site. Segments outside the grid seed
+ *    (and make sites of) the boundary cells nearest to them.
+ *  - Propagation: exact Euclidean feature transform to the nearest site; separable, lower
+ *    envelopes of parabolas along x, y and z (Felzenszwalb and Huttenlocher). The lines of
+ *    a pass are independent and run in parallel; linear in the number of cells.
+ *  - Resolve: each cell measures the exact distance to the segments of its own site and
+ *    of its 6 neighbours' sites, and keeps the closest.
+ *  - Signed fields (2D only): the inside of closed polylines is negative; even-odd rule
+ *    per grid row, rows in parallel.
+ *
+ *  Cost: the three passes and the resolve each touch every cell a few times; a 256^3 grid
+ *  takes about 4 s on one core and scales with the cores, so "well under a second" at
+ *  that size needs 8 or more of them. Coarser grids are the way to go on smaller machines.
+ *
+ *  Cell (i,j,k) is centered at origin + h * (i + 1/2, j + 1/2, k + 1/2); a 2D grid lies in
+ *  the plane z = origin z.
+ */
+class DistanceField {
+public:
+  using Point = GMlib::Vector<float,3>;
+
+  DistanceField(const Point& origin, float cell_size, int nx, int ny, int nz = 1)
+    : _origin(origin), _h(cell_size), _nx(nx), _ny(ny), _nz(std::max(nz, 1)) {}
+
+  int   sizeX() const { return _nx; }
+  int   sizeY() const { return _ny; }
+  int   sizeZ() const { return _nz; }
+  float cellSize() const { return _h; }
+
+  // Seed geometry
+  void clearSegments() { _segments.clear(); _closed_loops = true; }
+
+  void addSegment(const Point& a, const Point& b) { _segments.push_back(Segment(a, b, -1, -1)); _closed_loops = false; }
+
+  void addPolyline(const std::vector<Point>& points, bool closed) {
+
+    const int n    = int(points.size());
+    const int base = int(_segments.size());
+    const int m    = closed && n > 2 ? n : n - 1;   // Number of segments
+    for(int i = 0; i < m; ++i) {
+      const int prev = i > 0 ? base + i - 1 : (closed ? base + m - 1 : -1);
+      const int next = i < m - 1 ? base + i + 1 : (closed ? base : -1);
+      _segments.push_back(Segment(points[size_t(i)], points[size_t((i + 1) % n)], prev, next));
+    }
+    if(m != n) _closed_loops = false;
+  }
+
+  // Samples a curve (TorusKnot, MyB_spline, ClosedSubdivisionCurve, ...) in its parent's frame
+  void addCurve(GMlib::PCurve<float,3>& curve, int samples) {
+
+    const bool closed = curve.isClosed();
+    const int  m      = std::max(samples, 2);
+    const float dt    = curve.getParDelta() / float(closed ? m : m - 1);
+
+    std::vector<Point> points(static_cast<size_t>(m));
+    for(int i = 0; i < m; ++i)
+      points[size_t(i)] = curve.evaluateParent(curve.getParStart() + i * dt, 0)[0];
+    addPolyline(points, closed);
+  }
+
+  /*!
+   *  build(signed_field, band)
+   *
+   *  - Computes the field; band is the seeding width in cells around each segment.
+   *  - signed_field needs a 2D grid and closed polylines only; ignored otherwise.
+   */
+  void build(bool signed_field = false, int band = 1) {
+
+    const size_t size = size_t(_nx) * size_t(_ny) * size_t(_nz);
+    _field.assign(size, std::numeric_limits<float>::infinity());
+    _nearest.assign(size, -1);
+    _site.assign(size, -1);
+    _site_d2.assign(size, int(Infinity));
+
+    if(!_segments.empty()) {
+      seed(std::max(band, 1));
+      transform(_nx, _ny * _nz, 1,                       [this](int l) { return size_t(l) * size_t(_nx); });
+      transform(_ny, _nx * _nz, size_t(_nx),             [this](int l) { return index(l % _nx, 0, l / _nx); });
+      transform(_nz, _nx * _ny, size_t(_nx) * size_t(_ny), [](int l) { return size_t(l); });
+      resolve();
+    }
+
+    std::vector<int>().swap(_site);
+    std::vector<int>().swap(_site_d2);
+
+    _signed = signed_field && _nz == 1 && _closed_loops;
+    if(_signed) applySign();
+  }
+
+  bool isSigned() const { return _signed; }
+
+  float distance(int i, int j, int k = 0) const { return _field[index(i, j, k)]; }
+  int   nearestSegment(int i, int j, int k = 0) const { return _nearest[index(i, j, k)]; }
+
+  const std::vector<float>& values() const { return _field; }
+
+  // Trilinear interpolation at p; clamped to the grid
+  float sample(const Point& p) const {
+
+    float f[3]; int i0[3], i1[3];
+    const int n[3] = { _nx, _ny, _nz };
+    for(int a = 0; a < 3; ++a) {
+      const float x = std::min(std::max((p(a) - _origin(a)) / _h - 0.5f, 0.0f), float(n[a] - 1));
+      i0[a] = std::min(int(x), n[a] - 1);
+      i1[a] = std::min(i0[a] + 1, n[a] - 1);
+      f[a]  = x - float(i0[a]);
+    }
+
+    auto lerp = [](float a, float b, float t) { return a + (b - a) * t; };
+    auto v    = [&](int x, int y, int z) { return _field[index(x, y, z)]; };
+    return lerp(lerp(lerp(v(i0[0],i0[1],i0[2]), v(i1[0],i0[1],i0[2]), f[0]),
+                     lerp(v(i0[0],i1[1],i0[2]), v(i1[0],i1[1],i0[2]), f[0]), f[1]),
+                lerp(lerp(v(i0[0],i0[1],i1[2]), v(i1[0],i0[1],i1[2]), f[0]),
+                     lerp(v(i0[0],i1[1],i1[2]), v(i1[0],i1[1],i1[2]), f[0]), f[1]), f[2]);
+  }
+
+private:
+  // Plain floats; distance2() is the inner loop of the whole build
+  struct Segment {
+    float a[3], d[3];   // Start and direction (b - a)
+    float inv_len2;
+    int   prev, next;   // Neighbours along the polyline; -1 at open ends
+
+    Segment(const Point& p0, const Point& p1, int p, int n) : prev(p), next(n) {
+      for(int k = 0; k < 3; ++k) { a[k] = p0(k); d[k] = p1(k) - p0(k); }
+      const float l2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+      inv_len2 = l2 > 0.0f ? 1.0f / l2 : 0.0f;
+    }
+
+    float distance2(const float* p) const {
+      const float ap[3] = { p[0] - a[0], p[1] - a[1], p[2] - a[2] };
+      const float t = std::min(std::max((ap[0] * d[0] + ap[1] * d[1] + ap[2] * d[2]) * inv_len2, 0.0f), 1.0f);
+      const float e[3] = { ap[0] - d[0] * t, ap[1] - d[1] * t, ap[2] - d[2] * t };
+      return e[0] * e[0] + e[1] * e[1] + e[2] * e[2];
+    }
+  };
+
+  static constexpr int  Infinity = std::numeric_limits<int>::max() / 4;
+  static constexpr int  Group    = 16;   // Strided lines gathered per transform step
+
+  Point                 _origin;
+  float                 _h;
+  int                   _nx, _ny, _nz;
+
+  std::vector<Segment>  _segments;
+  bool                  _closed_loops {true};
+  bool                  _signed {false};
+
+  std::vector<float>    _field;     // Distance; squared until resolve()
+  std::vector<int>      _nearest;   // Nearest segment; -1 if none
+  std::vector<int>      _site;      // Feature transform: cell index of the nearest site; -1 if none
+  std::vector<int>      _site_d2;   // Squared distance to that site, in cells
+
+  size_t index(int i, int j, int k) const { return (size_t(k) * size_t(_ny) + size_t(j)) * size_t(_nx) + size_t(i); }
+
+  Point center(int i, int j, int k) const {
+    return _origin + Point((i + 0.5f) * _h, (j + 0.5f) * _h, _nz == 1 ? 0.0f : (k + 0.5f) * _h);
+  }
+
+  // Cells seeded by a segment: its bounding box widened by band cells, clamped to the grid
+  struct Box {
+    int  lo[3], hi[3];
+    bool outside;       // The segment misses the grid; its cells are the boundary cells nearest to it
+  };
+
+  Box box(const Segment& seg, int band) const {
+
+    Box b;
+    b.outside = false;
+    const int n[3] = { _nx, _ny, _nz };
+    for(int a = 0; a < 3; ++a) {
+      if(a == 2 && _nz == 1) { b.lo[2] = b.hi[2] = 0; break; }   // 2D; every segment seeds the grid plane
+
+      // In cells; clamped before the conversion, so far away segments do not overflow
+      const float x0 = (std::min(seg.a[a], seg.a[a] + seg.d[a]) - _origin(a)) / _h - 0.5f;
+      const float x1 = (std::max(seg.a[a], seg.a[a] + seg.d[a]) - _origin(a)) / _h - 0.5f;
+      if(x1 < -0.5f || x0 > float(n[a]) - 0.5f) b.outside = true;
+
+      const float last = float(n[a] - 1);
+      b.lo[a] = std::max(int(std::floor(std::min(std::max(x0, 0.0f), last))) - band, 0);
+      b.hi[a] = std::min(int(std::ceil(std::min(std::max(x1, 0.0f), last))) + band, n[a] - 1);
+    }
+    return b;
+  }
+
+  /*!
+   *  Exact squared distances in a band around every segment, and the sites.
+   *  - The segments are first binned by the blocks of grid rows (j,k) their boxes cover;
+   *    the blocks then run in parallel, each over its own segments only.
+   *  - Cells closer than one cell size to a segment are sites; so are all cells seeded by
+   *    a segment outside the grid, so the field stays finite with no geometry inside.
+   */
+  void seed(int band) {
+
+    const int rows      = _ny * _nz;
+    const int bin_rows  = std::max(rows / 1024, 1);
+    const int bins      = (rows + bin_rows - 1) / bin_rows;
+
+    std::vector<Box> boxes(_segments.size());
+    for(size_t s = 0; s < _segments.size(); ++s) boxes[s] = box(_segments[s], band);
+
+    // Bins of segments (compressed rows); a segment is listed once per bin it reaches
+    std::vector<int> first(size_t(bins) + 1, 0), list;
+    auto forBins = [this, bin_rows](const Box& b, auto f) {
+      int last = -1;
+      for(int k = b.lo[2]; k <= b.hi[2]; ++k)
+        for(int bin = std::max((k * _ny + b.lo[1]) / bin_rows, last + 1); bin <= (k * _ny + b.hi[1]) / bin_rows; ++bin)
+          f(last = bin);
+    };
+    for(const Box& b : boxes) forBins(b, [&first](int bin) { ++first[size_t(bin) + 1]; });
+    for(int bin = 0; bin < bins; ++bin) first[size_t(bin) + 1] += first[size_t(bin)];
+    list.resize(size_t(first.back()));
+    {
+      std::vector<int> fill(first.begin(), first.end() - 1);
+      for(int s = 0; s < int(boxes.size()); ++s)
+        forBins(boxes[size_t(s)], [&fill, &list, s](int bin) { list[size_t(fill[size_t(bin)]++)] = s; });
+    }
+
+    const float h2 = _h * _h;
+    parallelFor(0, bins, [&, this](int b0, int b1) {
+
+      for(int bin = b0; bin < b1; ++bin) {
+
+        const int r0 = bin * bin_rows, r1 = std::min(r0 + bin_rows, rows);
+        for(int e = first[size_t(bin)]; e < first[size_t(bin) + 1]; ++e) {
+
+          const int    s   = list[size_t(e)];
+          const auto&  seg = _segments[size_t(s)];
+          const Box&   b   = boxes[size_t(s)];
+          for(int k = b.lo[2]; k <= b.hi[2]; ++k) {
+            const int j0 = std::max(b.lo[1], r0 - k * _ny), j1 = std::min(b.hi[1], r1 - 1 - k * _ny);
+            for(int j = j0; j <= j1; ++j)
+              for(int i = b.lo[0]; i <= b.hi[0]; ++i) {
+                const size_t c  = index(i, j, k);
+                const Point  pc = center(i, j, k);
+                const float  p[3] = { pc(0), pc(1), pc(2) };
+                const float  d2 = seg.distance2(p);
+                if(d2 < _field[c]) { _field[c] = d2; _nearest[c] = s; }
+                if(d2 < h2 || b.outside) { _site[c] = int(c); _site_d2[c] = 0; }
+              }
+          }
+        }
+      }
+    });
+  }
+
+  /*!
+   *  Lower envelope of the parabolas (q - v)^2 + f(v) over a contiguous line of n cells, in
+   *  place; every q gets the minimizing v, the nearest site of the slab covered so far.
+   */
+  struct Envelope {
+    std::vector<int>    f, site, v;
+    std::vector<double> z;
+
+    void run(int* d2, int* sites, int n) {
+
+      f.assign(d2, d2 + n);
+      site.assign(sites, sites + n);
+      v.resize(size_t(n));
+      z.resize(size_t(n) + 1);
+
+      int k = -1;
+      for(int q = 0; q < n; ++q) {
+
+        if(f[size_t(q)] >= Infinity) continue;
+
+        double s = 0.0;
+        while(k >= 0) {
+          const int p = v[size_t(k)];
+          s = (double(f[size_t(q)]) + double(q) * q - double(f[size_t(p)]) - double(p) * p) / (2.0 * (q - p));
+          if(s > z[size_t(k)]) break;
+          --k;
+        }
+
+        ++k;
+        v[size_t(k)]     = q;
+        z[size_t(k)]     = k == 0 ? -1e30 : s;
+        z[size_t(k) + 1] = 1e30;
+      }
+      if(k < 0) return;   // No sites on the line
+
+      k = 0;
+      for(int q = 0; q < n; ++q) {
+        while(z[size_t(k) + 1] < q) ++k;
+        const int p = v[size_t(k)];
+        d2[q]    = (q - p) * (q - p) + f[size_t(p)];
+        sites[q] = site[size_t(p)];
+      }
+    }
+  };
+
+  /*!
+   *  One feature transform pass over lines of n cells; first(l) is the first cell of line l.
+   *  Strided lines are gathered in groups of neighbouring lines, so every cache line read
+   *  serves the whole group.
+   */
+  template <typename First>
+  void transform(int n, int lines, size_t stride, First first) {
+
+    if(n == 1) return;
+    parallelFor(0, lines, [this, n, stride, first](int l0, int l1) {
+
+      Envelope e;
+      if(stride == 1) {
+        for(int l = l0; l < l1; ++l) {
+          const size_t c = first(l);
+          e.run(&_site_d2[c], &_site[c], n);
+        }
+        return;
+      }
+
+      std::vector<int> d2(size_t(Group * n)), sites(size_t(Group * n));
+      for(int l = l0; l < l1; ) {
+
+        const size_t c = first(l);
+        int g = 1;
+        while(g < Group && l + g < l1 && first(l + g) == c + size_t(g)) ++g;
+
+        for(int q = 0; q < n; ++q)
+          for(int b = 0; b < g; ++b) {
+            d2[size_t(b * n + q)]    = _site_d2[c + size_t(q) * stride + size_t(b)];
+            sites[size_t(b * n + q)] = _site[c + size_t(q) * stride + size_t(b)];
+          }
+
+        for(int b = 0; b < g; ++b) e.run(&d2[size_t(b * n)], &sites[size_t(b * n)], n);
+
+        for(int q = 0; q < n; ++q)
+          for(int b = 0; b < g; ++b) {
+            _site_d2[c + size_t(q) * stride + size_t(b)] = d2[size_t(b * n + q)];
+            _site[c + size_t(q) * stride + size_t(b)]    = sites[size_t(b * n + q)];
+          }
+        l += g;
+      }
+    }, 16);
+  }
+
+  /*!
+   *  Exact distances, parallel over rows; two passes:
+   *  - candidates are the cell's seeded segment and the segments of its own and its 6
+   *    neighbours' labels (first pass: segments of the sites);
+   *  - from the best one, walks along its polyline while the distance decreases;
+   *  - the second pass only revisits cells with a neighbour on another part of the curves
+   *    (not the same or an adjacent segment), where the first pass may have settled on the
+   *    wrong strand.
+   */
+  void resolve() {
+
+    // Sites to their segments
+    std::vector<int>().swap(_site_d2);
+    std::vector<int> label(_site.size());
+    parallelFor(0, int(_site.size()), [this, &label](int a, int b) {
+      for(int c = a; c < b; ++c) label[size_t(c)] = _site[size_t(c)] < 0 ? -1 : _nearest[size_t(_site[size_t(c)])];
+    }, 1 << 16);
+
+    for(int pass = 0; pass < 2; ++pass) {
+
+      parallelFor(0, _ny * _nz, [&](int r0, int r1) {
+
+        const size_t sx = 1, sy = size_t(_nx), sz = size_t(_nx) * size_t(_ny);
+        for(int r = r0; r < r1; ++r) {
+          const int j = r % _ny, k = r / _ny;
+          int previous = -1;   // Segment of the previous cell in the row; the walks start close
+
+          for(int i = 0; i < _nx; ++i) {
+
+            const size_t c = index(i, j, k);
+            int n[6], no_n = 0;
+            if(i > 0)       n[no_n++] = label[c - sx];
+            if(i < _nx - 1) n[no_n++] = label[c + sx];
+            if(j > 0)       n[no_n++] = label[c - sy];
+            if(j < _ny - 1) n[no_n++] = label[c + sy];
+            if(k > 0)       n[no_n++] = label[c - sz];
+            if(k < _nz - 1) n[no_n++] = label[c + sz];
+
+            const int   own  = label[c];
+            const auto& ownS = _segments[size_t(std::max(own, 0))];
+            if(pass == 1 && own >= 0 &&
+               std::all_of(n, n + no_n, [&](int s) { return s == own || s == ownS.prev || s == ownS.next; })) {
+              _field[c] = std::sqrt(_field[c]);
+              _site[c]  = previous = label[c];
+              continue;
+            }
+
+            const Point pc = center(i, j, k);
+            const float p[3] = { pc(0), pc(1), pc(2) };
+            float best = _field[c];                      // Seeded, or the first pass result
+            int   seg  = pass == 0 ? _nearest[c] : own;
+
+            auto closer = [&](int s) {
+              const float d2 = _segments[size_t(s)].distance2(p);
+              if(d2 >= best) return false;
+              best = d2;
+              seg  = s;
+              return true;
+            };
+
+            int tested[9] = { seg }, no_tested = 1;
+            auto offer = [&](int s) {
+              if(s < 0 || std::find(tested, tested + no_tested, s) != tested + no_tested) return;
+              tested[no_tested++] = s;
+              closer(s);
+            };
+            offer(previous);
+            offer(own);
+            for(int a = 0; a < no_n; ++a) offer(n[a]);
+
+            // Walk along the polyline while the distance decreases; no walking back, and a
+            // closed loop ends where it started
+            const int start = seg;
+            bool moved = false;
+            for(int s; seg >= 0 && (s = _segments[size_t(seg)].next) >= 0 && s != start && closer(s); ) moved = true;
+            for(int s; !moved && seg >= 0 && (s = _segments[size_t(seg)].prev) >= 0 && s != start && closer(s); ) {}
+
+            _field[c] = pass == 1 ? std::sqrt(best) : best;
+            _site[c]  = previous = seg;   // Written apart from label, which the neighbours still read
+          }
+        }
+      }, 4);
+
+      label.swap(_site);
+    }
+
+    _nearest.swap(label);
+  }
+
+  // Even-odd rule per row; crossings of the row's center line with the segments (xy plane)
+  void applySign() {
+
+    parallelFor(0, _ny, [this](int j0, int j1) {
+
+      std::vector<float> xs;
+      for(int j = j0; j < j1; ++j) {
+
+        const float y = _origin(1) + (j + 0.5f) * _h;
+        xs.clear();
+        for(const auto& s : _segments) {
+          const float ya = s.a[1], yb = s.a[1] + s.d[1];
+          if((ya <= y) == (yb <= y)) continue;   // Half open; no double counting at vertices
+          xs.push_back(s.a[0] + (y - ya) / (yb - ya) * s.d[0]);
+        }
+        std::sort(xs.begin(), xs.end());
+
+        size_t c = 0;
+        bool inside = false;
+        for(int i = 0; i < _nx; ++i) {
+          const float x = _origin(0) + (i + 0.5f) * _h;
+          while(c < xs.size() && xs[c] < x) { inside = !inside; ++c; }
+          if(inside) _field[index(i, j, 0)] = -_field[index(i, j, 0)];
+        }
+      }
+    }, 4);
+  }
+};
+
+#endif // DISTANCE_FIELD_H
@@ -0,0 +1,225 @@
+#ifndef EDIT_JOURNAL_H
+#define EDIT_JOURNAL_H
+
+#include <scene/gmsceneobject.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "controlnetselector.h"
+
+/*!
+ *  EditJournal
+ *
+ *  Undo/redo history of interactive geometry edits, stored as deltas instead of object
+ *  snapshots.
+ *
+ *  - Transform entries hold the object's frame (pos, dir, up) before and after, and the
+ *    scale factor applied in between; 21 floats.
+ *  - Control entries hold a control net selector, the edited control indices and their
+ *    positions before and after; 6 floats and one index per control.
+ *  - Selector entries hold the accumulated global translation of a GMlib Selector (a
+ *    control point of the legacy editing path); 3 floats, replayed through editPos() so
+ *    the parent is updated as by the original edit.
+ *  - Values and indices live in two append-only arenas; an entry is a small header with
+ *    offsets into them. Recording after an undo drops the undone entries (truncates).
+ *  - Coalescing: while a gesture is open (the first record opens it, endGesture() closes
+ *    it, e.g. on mouse release), a record for a target already edited in the gesture (with
+ *    the same controls) updates the "after" values of that target's entry in place; a whole
+ *    drag of any number of selected objects is one entry per object. undo() and redo()
+ *    step over a whole gesture.
+ *  - Undo/redo set the frames, or the controls through ControlNetSelector::setControl, so
+ *    edited curves only replot the spans the controls affect.
+ *  - Targets must outlive the journal, or the journal must be cleared (the HID manager
+ *    clears it before the scene is cleaned up).
+ */
+class EditJournal {
+public:
+  using Point = GMlib::Vector<float,3>;
+
+  struct Frame {
+    GMlib::Point<float,3>   pos;
+    GMlib::Vector<float,3>  dir, up;
+  };
+
+  static Frame frameOf(const GMlib::SceneObject* obj) {
+
+    return Frame { obj->getPos(), obj->getDir(), obj->getUp() };
+  }
+
+  // obj was moved or rotated from the frame before, and scaled by scale
+  void recordTransform(GMlib::SceneObject* obj, const Frame& before, const Point& scale = Point(1.0f, 1.0f, 1.0f)) {
+
+    const Frame after = frameOf(obj);
+    if(Entry* e = merge(Kind::Transform, obj, nullptr, 0)) {
+      float* v = &_values[size_t(e->values)];
+      write(v + 9, after);
+      for(int a = 0; a < 3; ++a) v[18 + a] *= scale(a);
+    }
+    else {
+      float* v = &_values[size_t(open(Kind::Transform, obj, 0, 21).values)];
+      write(v, before);
+      write(v + 9, after);
+      for(int a = 0; a < 3; ++a) v[18 + a] = scale(a);
+    }
+  }
+
+  // The selector was moved by delta through editPos()
+  void recordSelector(GMlib::SceneObject* selector, const Point& delta) {
+
+    Entry* e = merge(Kind::Selector, selector, nullptr, 0);
+    if(!e) {
+      e = &open(Kind::Selector, selector, 0, 3);
+      std::fill_n(&_values[size_t(e->values)], 3, 0.0f);
+    }
+    float* v = &_values[size_t(e->values)];
+    for(int a = 0; a < 3; ++a) v[a] += delta(a);
+  }
+
+  // The controls indices of net were moved from the positions before
+  void recordControls(ControlNetSelector* net, const std::vector<int>& indices, const std::vector<Point>& before) {
+
+    const int n = int(indices.size());
+    if(n == 0) return;
+
+    Entry* e = merge(Kind::Controls, net, indices.data(), n);
+    if(!e) {
+      e = &open(Kind::Controls, net, n, 6 * n);
+      std::copy(indices.begin(), indices.end(), _indices.end() - n);
+      float* v = &_values[size_t(e->values)];
+      for(int k = 0; k < n; ++k)
+        for(int a = 0; a < 3; ++a) v[3 * k + a] = before[size_t(k)](a);
+    }
+
+    float* after = &_values[size_t(e->values) + 3 * size_t(n)];
+    for(int k = 0; k < n; ++k) {
+      const Point p = net->control(indices[size_t(k)]);
+      for(int a = 0; a < 3; ++a) after[3 * k + a] = p(a);
+    }
+  }
+
+  // Close the open gesture; the next record starts a new gesture
+  void endGesture() { _open.clear(); }
+
+  bool canUndo() const { return _size > 0; }
+  bool canRedo() const { return _size < _entries.size(); }
+
+  // The last gesture, all of its entries
+  void undo() {
+
+    if(!canUndo()) return;
+    _open.clear();
+    const std::uint32_t g = _entries[_size - 1].gesture;
+    while(_size > 0 && _entries[_size - 1].gesture == g) apply(_entries[--_size], false);
+  }
+
+  void redo() {
+
+    if(!canRedo()) return;
+    _open.clear();
+    const std::uint32_t g = _entries[_size].gesture;
+    while(_size < _entries.size() && _entries[_size].gesture == g) apply(_entries[_size++], true);
+  }
+
+  void clear() {
+
+    _entries.clear();
+    _values.clear();
+    _indices.clear();
+    _open.clear();
+    _size = 0;
+  }
+
+  size_t entries() const { return _entries.size(); }
+  size_t bytes() const { return _entries.size() * sizeof(Entry) + _values.size() * sizeof(float) + _indices.size() * sizeof(int); }
+
+private:
+  enum class Kind : std::uint8_t { Transform, Controls, Selector };
+
+  struct Entry {
+    Kind           kind;
+    void*          target;       // SceneObject (Transform, Selector) or ControlNetSelector (Controls)
+    std::uint32_t  values;       // Offset into _values
+    std::uint32_t  indices;      // Offset into _indices
+    std::uint32_t  count;        // Controls
+    std::uint32_t  gesture;      // Entries of one gesture are undone together
+  };
+
+  std::vector<Entry>                 _entries;
+  std::vector<float>                 _values;
+  std::vector<int>                   _indices;
+  size_t                             _size {0};        // Entries before the undo cursor
+  std::uint32_t                      _gestures {0};
+  std::unordered_map<void*, size_t>  _open;            // Target -> entry, in the open gesture
+
+  static void write(float* v, const Frame& f) {
+
+    for(int a = 0; a < 3; ++a) { v[a] = f.pos(a); v[3 + a] = f.dir(a); v[6 + a] = f.up(a); }
+  }
+
+  static Frame read(const float* v) {
+
+    return Frame { GMlib::Point<float,3>(v[0], v[1], v[2]), GMlib::Vector<float,3>(v[3], v[4], v[5]),
+                   GMlib::Vector<float,3>(v[6], v[7], v[8]) };
+  }
+
+  // The entry of target in the open gesture, if it records the same kind of edit
+  Entry* merge(Kind kind, void* target, const int* indices, int count) {
+
+    auto it = _open.find(target);
+    if(it == _open.end()) return nullptr;
+    Entry& e = _entries[it->second];
+    if(e.kind != kind || int(e.count) != count) return nullptr;
+    if(!std::equal(indices, indices + count, _indices.begin() + e.indices)) return nullptr;
+    return &e;
+  }
+
+  // Append an entry with room for its values and indices to the open gesture (opening one
+  // if there is none); drops the undone entries
+  Entry& open(Kind kind, void* target, int count, int values) {
+
+    if(_size < _entries.size()) {
+      _values.resize(_entries[_size].values);
+      _indices.resize(_entries[_size].indices);
+      _entries.resize(_size);
+    }
+    if(_open.empty()) ++_gestures;
+
+    _open[target] = _entries.size();
+    _entries.push_back(Entry { kind, target, std::uint32_t(_values.size()), std::uint32_t(_indices.size()),
+                               std::uint32_t(count), _gestures });
+    _values.resize(_values.size() + size_t(values));
+    _indices.resize(_indices.size() + size_t(count));
+    ++_size;
+    return _entries.back();
+  }
+
+  void apply(const Entry& e, bool forward) {
+
+    const float* v = &_values[e.values];
+
+    if(e.kind == Kind::Transform) {
+      auto obj = static_cast<GMlib::SceneObject*>(e.target);
+      const Frame f = read(forward ? v + 9 : v);
+      obj->set(f.pos, f.dir, f.up);
+      if(v[18] != 1.0f || v[19] != 1.0f || v[20] != 1.0f)
+        obj->scale(forward ? Point(v[18], v[19], v[20]) : Point(1.0f / v[18], 1.0f / v[19], 1.0f / v[20]));
+      return;
+    }
+
+    if(e.kind == Kind::Selector) {
+      const Point d(v[0], v[1], v[2]);
+      static_cast<GMlib::SceneObject*>(e.target)->editPos(forward ? d : -d);
+      return;
+    }
+
+    auto net = static_cast<ControlNetSelector*>(e.target);
+    const float* p = forward ? v + 3 * size_t(e.count) : v;
+    for(std::uint32_t k = 0; k < e.count; ++k)
+      net->setControl(_indices[e.indices + k], Point(p[3 * k], p[3 * k + 1], p[3 * k + 2]));
+  }
+};
+
+#endif // EDIT_JOURNAL_H
@@ -0,0 +1,223 @@
+#ifndef MEMORY_BUDGET_H
+#define MEMORY_BUDGET_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*!
+ *  MemoryBudget
+ *
+ *  Process wide cap on the memory held by rebuildable buffers (sample caches, subdivision
+ *  levels and the like).
+ *
+ *  - A cache opens an Account with its subsystem name, its rebuild cost per byte (1 for
+ *    sample buffers: one evaluation per sampled vector) and an eviction callback, charges
+ *    its current footprint and touches the account when it is used.
+ *  - collect() evicts until the total is under the cap; call it where the caches may be
+ *    mutated (the scene graph synchronization point). Evicted caches free their buffers
+ *    and charge 0; they are rebuilt on the next use, so a scene over budget gets slower,
+ *    not larger.
+ *  - Eviction order is GreedyDual (with cost proportional to size): an account's priority
+ *    is L + cost, set on touch and charge; the lowest priority goes first and raises L to
+ *    its priority. Ties go to the least recently touched: among equally costly bytes this
+ *    is LRU, costlier bytes survive longer.
+ *  - touch() is lock free; charge(), open() and close() take a mutex. Touch the account
+ *    where the cache is read as a whole (a resample), not per evaluation.
+ *  - version() counts the changes of the footprints, accounts and cap; a display polling
+ *    every frame only rebuilds when it has moved.
+ *  - shared() is the process wide budget, created on first use; 512 MiB until setCap().
+ */
+class MemoryBudget {
+  struct Slot;
+
+public:
+  using EvictFunction = std::function<void()>;
+
+  // One cache's registration; closed on destruction. Copies start closed, so the copy of
+  // an object opens its own account.
+  class Account {
+  public:
+    Account() = default;
+    Account(const Account&) {}
+    Account& operator=(const Account&) { return *this; }
+    ~Account() { close(); }
+
+    void open(const char* subsystem, double cost_per_byte, EvictFunction evict) {
+
+      close();
+      _slot = MemoryBudget::shared().open(subsystem, cost_per_byte, std::move(evict));
+    }
+
+    void close() {
+
+      if(_slot) MemoryBudget::shared().close(_slot);
+      _slot = nullptr;
+    }
+
+    bool isOpen() const { return _slot != nullptr; }
+
+    // Current footprint in bytes
+    void charge(size_t bytes) { if(_slot) MemoryBudget::shared().charge(_slot, bytes); }
+
+    void touch() { if(_slot) MemoryBudget::shared().touch(_slot); }
+
+  private:
+    Slot* _slot {nullptr};
+  };
+
+  static MemoryBudget& shared() {
+    static MemoryBudget budget;
+    return budget;
+  }
+
+  void setCap(size_t bytes) { _cap = bytes; ++_version; }
+  size_t cap() const { return _cap; }
+  size_t used() const { return _used; }
+
+  // Incremented whenever used(), usage() or cap() change
+  std::uint64_t version() const { return _version.load(std::memory_order_acquire); }
+
+  // Bytes in use per subsystem
+  std::vector<std::pair<std::string, size_t>> usage() const {
+
+    std::lock_guard<std::mutex> lk(_mutex);
+    std::map<std::string, size_t> sum;
+    for(const Slot& s : _slots)
+      if(s.open) sum[s.subsystem] += s.bytes;
+    return std::vector<std::pair<std::string, size_t>>(sum.begin(), sum.end());
+  }
+
+  // Evict until used() <= cap(); returns the bytes freed
+  size_t collect() {
+
+    if(_used <= _cap) return 0;
+
+    // Candidates, lowest priority first; callbacks run without the lock. A slot closed and
+    // reopened meanwhile belongs to another cache; the generation tells them apart.
+    struct Candidate { double priority; std::uint64_t last_use; Slot* slot; std::uint64_t generation; };
+    std::vector<Candidate> order;
+    {
+      std::lock_guard<std::mutex> lk(_mutex);
+      for(Slot& s : _slots)
+        if(s.open && s.bytes > 0)
+          order.push_back({ s.priority.load(std::memory_order_relaxed), s.last_use.load(std::memory_order_relaxed), &s, s.generation });
+    }
+    std::sort(order.begin(), order.end(), [](const Candidate& a, const Candidate& b) {
+      return a.priority < b.priority || (a.priority == b.priority && a.last_use < b.last_use);
+    });
+
+    size_t freed = 0;
+    for(const Candidate& c : order) {
+      if(_used <= _cap) break;
+
+      EvictFunction evict;
+      size_t        bytes;
+      {
+        std::lock_guard<std::mutex> lk(_mutex);
+        if(!c.slot->open || c.slot->generation != c.generation) continue;
+        evict = c.slot->evict;
+        bytes = c.slot->bytes;
+        _inflation.store(std::max(_inflation.load(std::memory_order_relaxed), c.priority), std::memory_order_relaxed);
+      }
+      evict();
+      freed += bytes;
+
+      std::lock_guard<std::mutex> lk(_mutex);
+      if(c.slot->open && c.slot->generation == c.generation) set(c.slot, 0);   // In case the callback did not charge 0
+    }
+    return freed;
+  }
+
+private:
+  struct Slot {
+    std::string                 subsystem;
+    double                      cost {1.0};         // Per byte
+    EvictFunction               evict;
+    size_t                      bytes {0};
+    std::atomic<double>         priority {0.0};
+    std::atomic<std::uint64_t>  last_use {0};
+    bool                        open {false};
+    std::uint64_t               generation {0};     // Opens of this slot; with the lock held
+  };
+
+  mutable std::mutex          _mutex;
+  std::deque<Slot>            _slots;               // Stable addresses; closed slots are reused
+  std::vector<Slot*>          _free;
+  std::atomic<size_t>         _used {0};
+  std::atomic<size_t>         _cap {size_t(512) << 20};
+  std::atomic<double>         _inflation {0.0};     // L
+  std::atomic<std::uint64_t>  _clock {0};           // Touch sequence
+  std::atomic<std::uint64_t>  _version {0};
+
+  MemoryBudget() = default;
+  MemoryBudget(const MemoryBudget&) = delete;
+  MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+  // Footprint and priority; with the lock held
+  void set(Slot* s, size_t bytes) {
+
+    if(bytes != s->bytes) {
+      _used += bytes;
+      _used -= s->bytes;
+      s->bytes = bytes;
+      _version.fetch_add(1, std::memory_order_release);
+    }
+    touch(s);
+  }
+
+  Slot* open(const char* subsystem, double cost, EvictFunction evict) {
+
+    std::lock_guard<std::mutex> lk(_mutex);
+    Slot* s;
+    if(_free.empty()) {
+      _slots.emplace_back();
+      s = &_slots.back();
+    }
+    else {
+      s = _free.back();
+      _free.pop_back();
+    }
+    s->subsystem = subsystem;
+    s->cost      = std::max(cost, 0.0);
+    s->evict     = std::move(evict);
+    s->bytes     = 0;
+    s->open      = true;
+    ++s->generation;
+    set(s, 0);
+    _version.fetch_add(1, std::memory_order_release);
+    return s;
+  }
+
+  void close(Slot* s) {
+
+    std::lock_guard<std::mutex> lk(_mutex);
+    set(s, 0);
+    s->evict = nullptr;
+    s->open  = false;
+    _free.push_back(s);
+    _version.fetch_add(1, std::memory_order_release);
+  }
+
+  void charge(Slot* s, size_t bytes) {
+
+    std::lock_guard<std::mutex> lk(_mutex);
+    set(s, bytes);
+  }
+
+  void touch(Slot* s) {
+
+    s->priority.store(_inflation.load(std::memory_order_relaxed) + s->cost, std::memory_order_relaxed);
+    s->last_use.store(_clock.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+  }
+};
+
+#endif // MEMORY_BUDGET_H
@@ -1,29 +1,80 @@
+#ifndef MY_B_SPLINE_H
+#define MY_B_SPLINE_H
+
 #include <parametrics/gmpcurve.h>
 #include <core/containers/gmdvector.h>
 
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "bsplinebasis.h"
+#include "bandedlu.h"
+#include "arclength.h"
+#include "sharedcontrolpoints.h"
+#include "memorybudget.h"
+
 // MyB_spline class definition inheriting from GMlib::PCurve
 class MyB_spline : public GMlib::PCurve<float,3> {
     GM_SCENEOBJECT(MyB_spline)
 
 public:
+    // Parameter values assigned to interpolated points
+    enum class Parametrization {
+        ChordLength,    // Proportional to the distance between consecutive points
+        Centripetal,    // Proportional to the square root of the distance; tighter at sharp turns
+        Uniform         // Equally spaced; keeps the parametrization of points sampled at equal steps
+    };
+
     // Constructor 1: Initialize with given control points
     MyB_spline(const GMlib::DVector<GMlib::Vector<float,3>>& c);
+
+    // Constructor 1b: Share the control points of another curve (copy-on-write)
+    explicit MyB_spline(const SharedControlPoints<float,3>& c);
     
     // Constructor 2: Approximate a set of points using least squares
-    MyB_spline(const GMlib::DVector<GMlib::Vector<float,3>>& p, int n);
+    MyB_spline(const GMlib::DVector<GMlib::Vector<float,3>>& p, int n,
+               Parametrization param = Parametrization::ChordLength);
+
+    // Constructor 3: Interpolate a set of points (the curve passes through every point)
+    MyB_spline(const GMlib::DVector<GMlib::Vector<float,3>>& p, Parametrization param);
+
+    // Constructor 4: Approximate a set of points within a tolerance, with as few control points
+    // as the adaptive knot placement finds (no need to guess n)
+    MyB_spline(const GMlib::DVector<GMlib::Vector<float,3>>& p, float tolerance, Parametrization param);
+
+    int getNumControlPoints() const { return _controlPoints.getDim(); }
+    const GMlib::Vector<float,3>& getControlPoint(int i) const { return _controlPoints[i]; }
+    const SharedControlPoints<float,3>& getControlPoints() const { return _controlPoints; }
+
+    // Move control point i; only the knot spans it supports are resampled on the next replot
+    void setControlPoint(int i, const GMlib::Vector<float,3>& p);
+
+    // Partial replot: marks [t0, t1] as changed; as long as the sampling (d, start and spacing)
+    // is unchanged, the next resample only re-evaluates the samples inside the changed intervals,
+    // and the ones past the end of the last sampling
+    void invalidate(float t0, float t1);
+
+    // Reparametrize by (normalized) arc length, keeping the parameter domain;
+    // equally spaced samples along the curve regardless of the control point spacing
+    void setUniformSpeed(bool state);
+    bool isUniformSpeed() const { return _uniformSpeed; }
 
 protected:
     // Evaluate the curve at parameter t with d derivatives
     void eval(float t, int d, bool left = true) const override;
+
+    // Sample the curve; reuses the cached samples outside the invalidated intervals
+    void resample(GMlib::DVector<GMlib::DVector<GMlib::Vector<float,3>>>& p, int m, int d, float start, float end) override;
     
     // Return the first valid parameter value (avoid repeated knots at start)
     float getStartP() const override {
-        return _knotVector[2]; // First non-repeated knot
+        return _knotVector[_degree]; // First non-repeated knot
     }
     
     // Return the last valid parameter value (avoid repeated knots at end)
     float getEndP() const override {
-        return _knotVector[_knotVector.getDim() - 3]; // Last non-repeated knot
+        return _knotVector[_controlPoints.getDim()]; // Last non-repeated knot; knots past n + degree are spare
     }
     
     // Check if the curve is closed (always false for this B-spline)
@@ -32,33 +83,82 @@ protected:
     }
 
 private:
-    GMlib::DVector<GMlib::Vector<float,3>> _controlPoints; // Control points defining the curve
+    friend class StreamingFitter; // Updates control points and knots in place
+
+    SharedControlPoints<float,3> _controlPoints; // Control points defining the curve; shared until edited
     GMlib::DVector<float> _knotVector; // Knot vector defining parameter spacing
+    int _degree {2}; // Polynomial degree
+
+    bool _uniformSpeed {false}; // Arc length parametrization on/off
+    ArcLength<float> _arcLength; // Arc length table over the knot spans
+
+    // Sample cache of the last resample, and the changed parameter interval since then
+    GMlib::DVector<GMlib::DVector<GMlib::Vector<float,3>>> _samples;
+    int _sampleD {-1}; // -1: no valid cache
+    float _sampleStart {0.0f};
+    float _sampleDt {0.0f}; // Sample spacing
+    float _dirtyStart {std::numeric_limits<float>::max()};
+    float _dirtyEnd {std::numeric_limits<float>::lowest()};
+    const void* _sampleTarget {nullptr}; // Array the last resample was copied into
+    MemoryBudget::Account _sampleBudget; // The sample cache is evicted under memory pressure
+
+    // Drop the sample cache; the next resample evaluates everything
+    void releaseSamples();
+
+    // Evaluate the spline (de Boor; span local) at t with d derivatives into p
+    void evalSpline(float t, int d, bool left, GMlib::DVector<GMlib::Vector<float,3>>& p) const;
 
     // Generate a uniform knot vector for a 2nd-degree B-spline
     void generateKnotVector();
     
     // Compute control points using least squares fitting
-    void leastSquaresFit(const GMlib::DVector<GMlib::Vector<float,3>>& p, int n);
-    
-    // Evaluate the basis function at index i, degree k, and parameter t
-    float evaluateBasis(int i, int k, float t) const;
+    void leastSquaresFit(const GMlib::DVector<GMlib::Vector<float,3>>& p, int n, Parametrization param);
+
+    // Compute control points and knots interpolating p (global interpolation; banded solve)
+    void interpolate(const GMlib::DVector<GMlib::Vector<float,3>>& p, Parametrization param);
+
+    // Compute control points and knots approximating p within tolerance (adaptive knot insertion)
+    void adaptiveFit(const GMlib::DVector<GMlib::Vector<float,3>>& p, float tolerance, Parametrization param);
+
+    // Parameter values of p by chord length, centripetal or uniform spacing, normalized to [0,1]
+    static std::vector<double> parameters(const GMlib::DVector<GMlib::Vector<float,3>>& p, Parametrization param);
+
+    // Least squares control points c for the knots; returns false if the system is singular
+    bool solveLeastSquares(const GMlib::DVector<GMlib::Vector<float,3>>& p, const std::vector<double>& u,
+                           const std::vector<double>& knots, std::vector<GMlib::Vector<double,3>>& c) const;
+
+    // Take over knots and control points computed in double
+    void assign(const std::vector<double>& knots, const std::vector<GMlib::Vector<double,3>>& c);
 };
 
 // Constructor: Create a B-spline from predefined control points
-MyB_spline::MyB_spline(const GMlib::DVector<GMlib::Vector<float,3>>& c)
+inline MyB_spline::MyB_spline(const GMlib::DVector<GMlib::Vector<float,3>>& c)
     : _controlPoints(c) {
     generateKnotVector(); // Generate knot vector for this set of control points
 }
 
+inline MyB_spline::MyB_spline(const SharedControlPoints<float,3>& c)
+    : _controlPoints(c) {
+    generateKnotVector();
+}
+
 // Constructor: Approximate a given set of points using least squares fitting
-MyB_spline::MyB_spline(const GMlib::DVector<GMlib::Vector<float,3>>& p, int n) {
-    leastSquaresFit(p, n); // Fit control points using least squares
-    generateKnotVector(); // Generate a corresponding knot vector
+inline MyB_spline::MyB_spline(const GMlib::DVector<GMlib::Vector<float,3>>& p, int n, Parametrization param) {
+    leastSquaresFit(p, n, param); // Computes both the knot vector and the control points
+}
+
+// Constructor: Interpolate a given set of points
+inline MyB_spline::MyB_spline(const GMlib::DVector<GMlib::Vector<float,3>>& p, Parametrization param) {
+    interpolate(p, param); // Computes both the knot vector and the control points
+}
+
+// Constructor: Approximate a given set of points within a tolerance
+inline MyB_spline::MyB_spline(const GMlib::DVector<GMlib::Vector<float,3>>& p, float tolerance, Parametrization param) {
+    adaptiveFit(p, tolerance, param); // Computes both the knot vector and the control points
 }
 
 // Generate a uniform knot vector for a 2nd-degree (quadratic) B-spline
-void MyB_spline::generateKnotVector() {
+inline void MyB_spline::generateKnotVector() {
     int n = _controlPoints.getDim(); // Number of control points
     int k = 2; // Degree of the B-spline (quadratic)
     int m = n + k + 1; // Number of knots
@@ -82,92 +182,341 @@ void MyB_spline::generateKnotVector() {
     }
 }
 
-// Compute control points using least squares fitting
-void MyB_spline::leastSquaresFit(const GMlib::DVector<GMlib::Vector<float,3>>& p, int n) {
-    int m = p.getDim(); // Number of input points
-    int k = 2; // B-spline degree
+// Parameter values; accumulated in double, 10^6 points would drift in float
+inline std::vector<double> MyB_spline::parameters(const GMlib::DVector<GMlib::Vector<float,3>>& p, Parametrization param) {
+    const int m = p.getDim();
+    std::vector<double> u(m, 0.0);
+    for (int i = 1; i < m; ++i) {
+        double dist = param == Parametrization::Uniform ? 1.0 : (p(i) - p(i - 1)).getLength();
+        if (param == Parametrization::Centripetal) dist = std::sqrt(dist);
+        u[i] = u[i - 1] + dist;
+    }
+    for (int i = 1; i < m; ++i)
+        u[i] = u[m - 1] > 0.0 ? u[i] / u[m - 1] : double(i) / (m - 1); // Coincident points: uniform
+    if (m > 1) u[m - 1] = 1.0;
+    return u;
+}
 
-    _controlPoints.setDim(n); // Allocate space for control points
+// Least squares (The NURBS Book, 9.4.1): minimize sum |c(u_k) - p_k|^2
+// - The normal equations N^T N c = N^T p are banded (bandwidth p) and symmetric positive
+//   definite as long as the data fills the knot spans; banded LU, O(m p^2 + n p^2)
+inline bool MyB_spline::solveLeastSquares(const GMlib::DVector<GMlib::Vector<float,3>>& p, const std::vector<double>& u,
+                                   const std::vector<double>& knots, std::vector<GMlib::Vector<double,3>>& c) const {
+    const int m = p.getDim();
+    const int n = int(knots.size()) - _degree - 1;
 
-    GMlib::DMatrix<float> N(m, n, 0.0f); // Basis function matrix
-    GMlib::DVector<float> weights(m, 1.0f); // Weights for least squares
+    BandedLU<double> A(n, _degree, _degree);
+    c.assign(n, GMlib::Vector<double,3>(0.0, 0.0, 0.0));
 
-    // Compute basis functions for each input point
-    for (int i = 0; i < m; ++i) {
-        float t = static_cast<float>(i) / (m - 1); // Normalized parameter value
-        int span = -1; // Find knot span
-
-        // Find the knot span for the current parameter value t
-        // The knot span is the interval [u_i, u_{i+1}) where the parameter t lies
-        // This determines which basis functions are non-zero at t
-        for (int j = k; j < n; ++j) {
-            if (t >= _knotVector[j] && t < _knotVector[j + 1]) {
-                span = j;
-                break;
-            }
+    double N[bspline::MaxDegree + 1];
+    for (int k = 0; k < m; ++k) {
+        const int span = bspline::findSpan(knots, n, _degree, u[k]);
+        bspline::basisFuns(knots, span, _degree, u[k], N);
+
+        const GMlib::Vector<double,3> q(p(k)(0), p(k)(1), p(k)(2));
+        for (int a = 0; a <= _degree; ++a) {
+            c[span - _degree + a] += q * N[a];
+            for (int b = 0; b <= _degree; ++b)
+                A(span - _degree + a, span - _degree + b) += N[a] * N[b];
         }
-        if (span == -1) span = n - 1; // Handle boundary case
-
-        GMlib::DVector<float> N_i(k + 1, 0.0f); // Basis function values
-        N_i[0] = 1.0f;
-        
-        // Compute basis functions using recursion
-        for (int d = 1; d <= k; ++d) {
-            float left = t - _knotVector[span + 1 - d];
-            float right = _knotVector[span + d] - t;
-            float saved = 0.0f;
-            
-            // Update basis functions for the current degree
-            for (int r = 0; r < d; ++r) {
-                float temp = N_i[r] / (_knotVector[span + r + 1] - _knotVector[span + 1 - d + r]);
-                N_i[r] = saved + right * temp;
-                saved = left * temp;
+    }
+
+    if (!A.factorize()) return false;
+    A.solve(c.data());
+    return true;
+}
+
+inline void MyB_spline::assign(const std::vector<double>& knots, const std::vector<GMlib::Vector<double,3>>& c) {
+    _knotVector.setDim(int(knots.size()));
+    for (int i = 0; i < int(knots.size()); ++i)
+        _knotVector[i] = float(knots[i]);
+
+    std::vector<GMlib::Vector<float,3>> cf(c.size());
+    for (size_t i = 0; i < c.size(); ++i)
+        cf[i] = GMlib::Vector<float,3>(float(c[i](0)), float(c[i](1)), float(c[i](2)));
+    _controlPoints.assign(std::move(cf));
+}
+
+// Compute control points using least squares fitting
+// - Knots placed by the distribution of the parameters (The NURBS Book, 9.68-9.69),
+//   so every knot span holds data
+inline void MyB_spline::leastSquaresFit(const GMlib::DVector<GMlib::Vector<float,3>>& p, int n, Parametrization param) {
+    const int m = p.getDim(); // Number of input points
+    n = std::min(n, m);
+    if (n <= _degree + 1 && n < m) n = std::min(_degree + 1, m);
+    if (n == m || n < 2) { // As many control points as points: interpolation
+        interpolate(p, param);
+        return;
+    }
+
+    const std::vector<double> u = parameters(p, param);
+
+    std::vector<double> knots(n + _degree + 1, 0.0);
+    for (int i = n; i < n + _degree + 1; ++i) knots[i] = 1.0;
+    const double dd = double(m) / (n - _degree); // Points per knot span
+    for (int j = 1; j < n - _degree; ++j) {
+        const int i = int(j * dd);
+        const double alpha = j * dd - i;
+        knots[j + _degree] = (1.0 - alpha) * u[i - 1] + alpha * u[i];
+    }
+
+    std::vector<GMlib::Vector<double,3>> c;
+    if (!solveLeastSquares(p, u, knots, c)) { // Only with (many) repeated points
+        interpolate(p, param);
+        return;
+    }
+    assign(knots, c);
+}
+
+// Adaptive least squares fit: start with a single polynomial span and split the spans whose
+// residual exceeds the tolerance, until all residuals are within the tolerance
+// - A span is split at the median of its parameters, and only if both halves keep at least
+//   p+1 points; every span then holds enough data for a non-singular system
+// - All offending spans are split in a round, so the number of rounds is logarithmic in the
+//   final control count; each round is one banded O(m) assembly and solve
+// - The result is the control count at which refinement first meets the tolerance, which
+//   is usually far below the count uniform knots would need
+inline void MyB_spline::adaptiveFit(const GMlib::DVector<GMlib::Vector<float,3>>& p, float tolerance, Parametrization param) {
+    const int m = p.getDim();
+    _degree = std::max(std::min(_degree, m - 1), 1);
+    if (m <= _degree + 1) {
+        interpolate(p, param);
+        return;
+    }
+
+    const std::vector<double> u = parameters(p, param);
+
+    // No interior knots; degree + 1 control points
+    std::vector<double> knots(2 * (_degree + 1), 0.0);
+    for (int i = _degree + 1; i < 2 * (_degree + 1); ++i) knots[i] = 1.0;
+
+    std::vector<GMlib::Vector<double,3>> c;
+    if (!solveLeastSquares(p, u, knots, c)) {
+        interpolate(p, param);
+        return;
+    }
+
+    double N[bspline::MaxDegree + 1];
+    std::vector<double> inserted, merged;
+    for (;;) {
+        const int n = int(knots.size()) - _degree - 1;
+
+        // The points are ordered by parameter; walk them span by span
+        inserted.clear();
+        int k0 = 0;
+        while (k0 < m) {
+            const int span = bspline::findSpan(knots, n, _degree, u[k0]);
+            double worst = 0.0;
+            int k1 = k0;
+            for (; k1 < m && bspline::findSpan(knots, n, _degree, u[k1]) == span; ++k1) {
+                bspline::basisFuns(knots, span, _degree, u[k1], N);
+                GMlib::Vector<double,3> r(-p(k1)(0), -p(k1)(1), -p(k1)(2));
+                for (int j = 0; j <= _degree; ++j)
+                    r += c[span - _degree + j] * N[j];
+                worst = std::max(worst, r.getLength());
             }
-            N_i[d] = saved;
-        }
 
-        // Store the computed basis functions in the matrix N
-        for (int j = 0; j <= k; ++j) {
-            N[i][span - k + j] = N_i[j];
+            const int mid = (k0 + k1) / 2;
+            if (worst > tolerance && k1 - k0 >= 2 * (_degree + 1) && u[mid - 1] < u[mid])
+                inserted.push_back(0.5 * (u[mid - 1] + u[mid]));
+            k0 = k1;
         }
+
+        // Within tolerance, or no span can be split further
+        if (inserted.empty()) break;
+
+        merged.resize(knots.size() + inserted.size());
+        std::merge(knots.begin(), knots.end(), inserted.begin(), inserted.end(), merged.begin());
+
+        std::vector<GMlib::Vector<double,3>> refined;
+        if (!solveLeastSquares(p, u, merged, refined)) break; // Keep the last solvable fit
+        knots.swap(merged);
+        c.swap(refined);
     }
+
+    assign(knots, c);
 }
 
-// Evaluate basis function recursively using the Cox–de Boor formula
-float MyB_spline::evaluateBasis(int i, int degree, float t) const {
-    // Base case: if degree is 0, check if t is within the knot span [u_i, u_{i+1})
-    if (degree == 0) {
-        if( (_knotVector[i] <= t && t < _knotVector[i+1]) ||
-            (t == _knotVector[_knotVector.getDim()-1] && i == _controlPoints.getDim()-1) )
-            return 1.0f;
-        else
-            return 0.0f;    }
-    
-    // Calculate the denominator for the first term
-    float denom1 = _knotVector[i+degree] - _knotVector[i];
-    // Calculate the first term of the Cox–de Boor recursion formula
-    float term1  = (denom1 != 0.0f) ? (t - _knotVector[i]) / denom1 * evaluateBasis(i, degree - 1, t) : 0.0f;
+// Global interpolation (The NURBS Book, A9.1)
+// - Parameter values u_i by chord length or centripetal spacing, normalized to [0,1]
+// - Knots by averaging p consecutive parameter values; every knot span holds a u_i,
+//   which keeps the collocation matrix non-singular
+// - The collocation matrix N(u_i) has at most p+1 non-zeros per row around the diagonal;
+//   it is solved by banded LU without pivoting (totally positive), O(n) time and memory
+inline void MyB_spline::interpolate(const GMlib::DVector<GMlib::Vector<float,3>>& p, Parametrization param) {
+    const int n = p.getDim(); // Number of points = number of control points
 
-    // Calculate the denominator for the second term
-    float denom2 = _knotVector[i+degree+1] - _knotVector[i+1];
-    // Calculate the second term of the Cox–de Boor recursion formula
-    float term2  = (denom2 != 0.0f) ? (_knotVector[i+degree+1] - t) / denom2 * evaluateBasis(i+1, degree - 1, t) : 0.0f;
+    // A single point (or none) becomes a degenerate line segment; two coincident control
+    // points keep the knot vector, and with it the domain, valid
+    if (n < 2) {
+        const GMlib::Vector<float,3> c = n == 1 ? p(0) : GMlib::Vector<float,3>(0.0f, 0.0f, 0.0f);
+        GMlib::DVector<GMlib::Vector<float,3>> q(2);
+        q[0] = q[1] = c;
+        interpolate(q, param);
+        return;
+    }
 
-    // Return the sum of the two terms
-    return term1 + term2;
-}
+    const int k = std::min(_degree, n - 1); // Degree; lowered for very few points
+    _degree = k;
 
-// Evaluate the curve at parameter t using correct basis function evaluation
-void MyB_spline::eval(float t, int d, bool left) const {
-    this->_p.setDim(d+1);
-    this->_p[0] = GMlib::Vector<float,3>(0.0f, 0.0f, 0.0f);
-    
-    int n = _controlPoints.getDim();
-    int degree = 2; // B-spline degree
-    
-    // Sum over each control point multiplied by its corresponding basis function value.
+    const std::vector<double> u = parameters(p, param);
+
+    // Averaged knot vector; k+1 repeated end knots
+    std::vector<double> knots(n + k + 1, 0.0);
+    for (int i = n; i < n + k + 1; ++i) knots[i] = 1.0;
+    double sum = 0.0;
+    for (int i = 1; i < k; ++i) sum += u[i]; // Running sum of u_j, ..., u_{j+k-1}
+    for (int j = 1; j < n - k; ++j) {
+        sum += u[j + k - 1];
+        knots[j + k] = sum / k;
+        sum -= u[j];
+    }
+
+    // Collocation matrix; row i holds N_{span-k}(u_i), ..., N_{span}(u_i)
+    BandedLU<double> A(n, k, k);
+    double N[bspline::MaxDegree + 1];
     for (int i = 0; i < n; ++i) {
-        float basisVal = evaluateBasis(i, degree, t);
-        this->_p[0] += basisVal * _controlPoints[i];
+        const int span = bspline::findSpan(knots, n, k, u[i]);
+        bspline::basisFuns(knots, span, k, u[i], N);
+        for (int j = 0; j <= k; ++j)
+            if (A.inBand(i, span - k + j)) A(i, span - k + j) = N[j];
     }
-}
\ No newline at end of file
+
+    // Solve for all three coordinates at once
+    std::vector<GMlib::Vector<double,3>> c(n);
+    for (int i = 0; i < n; ++i)
+        c[i] = GMlib::Vector<double,3>(p(i)(0), p(i)(1), p(i)(2));
+
+    _knotVector.setDim(n + k + 1);
+    for (int i = 0; i < n + k + 1; ++i)
+        _knotVector[i] = float(knots[i]);
+
+    if (!A.factorize()) { // Only with repeated points; fall back to the points as control points
+        _controlPoints = p;
+        return;
+    }
+    A.solve(c.data());
+
+    std::vector<GMlib::Vector<float,3>> cf(n);
+    for (int i = 0; i < n; ++i)
+        cf[i] = GMlib::Vector<float,3>(float(c[i](0)), float(c[i](1)), float(c[i](2)));
+    _controlPoints.assign(std::move(cf));
+}
+
+// Enable/disable arc length parametrization
+inline void MyB_spline::setUniformSpeed(bool state) {
+    _uniformSpeed = state;
+    if(!_uniformSpeed) return;
+
+    // One quadrature table entry per (subdivided) knot span
+    std::vector<float> breaks;
+    for (int i = _degree; i <= _controlPoints.getDim(); ++i)
+        breaks.push_back(_knotVector[i]);
+
+    _arcLength.build([this](float t) {
+        GMlib::DVector<GMlib::Vector<float,3>> p;
+        evalSpline(t, 1, false, p);
+        return p[1].getLength();
+    }, breaks);
+}
+
+// Evaluate the spline using the p+1 non-zero basis functions of the knot span containing t
+inline void MyB_spline::evalSpline(float t, int d, bool left, GMlib::DVector<GMlib::Vector<float,3>>& p) const {
+    const int n = _controlPoints.getDim();
+    const int dd = std::min(d, bspline::MaxDerivatives);
+
+    p.setDim(d+1);
+    for (int k = 0; k <= d; ++k)
+        p[k] = GMlib::Vector<float,3>(0.0f, 0.0f, 0.0f);
+
+    // Find the knot span and the basis functions (with derivatives) that are non-zero on it
+    const int span = bspline::findSpan(_knotVector, n, _degree, t, left);
+    float ders[bspline::MaxDerivatives+1][bspline::MaxDegree+1];
+    bspline::basisFunsDerivs(_knotVector, span, _degree, t, dd, ders);
+
+    // Sum over the control points of the span multiplied by the basis function values
+    for (int k = 0; k <= dd; ++k)
+        for (int j = 0; j <= _degree; ++j)
+            p[k] += ders[k][j] * _controlPoints[span - _degree + j];
+}
+
+// Evaluate the curve at parameter t with d derivatives
+inline void MyB_spline::eval(float t, int d, bool left) const {
+    if (!_uniformSpeed) {
+        evalSpline(t, d, left, this->_p);
+        return;
+    }
+
+    // Uniform speed: t is (scaled) arc length; map to the spline parameter and apply the chain rule
+    const float domain = getEndP() - getStartP();
+    evalSpline(_arcLength.parameter((t - getStartP()) / domain * _arcLength.length()), d, left, this->_p);
+    ArcLength<float>::toUniformSpeed<3>(this->_p, _arcLength.length() / domain, std::min(d, 3));
+}
+
+// Extend the changed interval
+inline void MyB_spline::invalidate(float t0, float t1) {
+    _dirtyStart = std::min(_dirtyStart, t0);
+    _dirtyEnd = std::max(_dirtyEnd, t1);
+}
+
+// Control point i is nonzero on [t_i, t_i+degree+1]; uniform speed depends on all of them
+inline void MyB_spline::setControlPoint(int i, const GMlib::Vector<float,3>& p) {
+    _controlPoints.set(i, p); // Copies the shared control points first
+    if (_uniformSpeed) setUniformSpeed(true);
+    invalidate(_knotVector[i], _knotVector[i + _degree + 1]);
+}
+
+// Uniform sampling of [start, end] into p, as GMlib's PCurve does
+// - Samples outside the invalidated intervals are copied from the cache when the sampling
+//   starts at the same parameter with the same spacing; a domain grown at the end with the
+//   sample count grown along (StreamingFitter) only evaluates the new samples
+// - The uniform speed mode depends globally on the control points and always samples everything
+// - p only receives the re-evaluated samples when it is the array of the last resample, with
+//   the same sample count; otherwise the whole cache is copied
+inline void MyB_spline::resample(GMlib::DVector<GMlib::DVector<GMlib::Vector<float,3>>>& p, int m, int d, float start, float end) {
+    const float dt = (end - start) / (m - 1);
+    const bool reuse = !_uniformSpeed && _sampleD == d && _sampleStart == start
+                       && std::abs(dt - _sampleDt) <= 1e-5f * std::abs(dt);
+    const int cached = reuse ? std::min(_samples.getDim(), m) : 0;
+
+    if (_samples.getDim() != m) {
+        GMlib::DVector<GMlib::DVector<GMlib::Vector<float,3>>> samples(m);
+        for (int i = 0; i < cached; ++i) samples[i] = _samples[i];
+        _samples = samples;
+    }
+    const bool patch = cached == m && _sampleTarget == &p && p.getDim() == m;
+    for (int i = 0; i < m; ++i) {
+        const float t = start + i * dt;
+        if (i < cached && (t < _dirtyStart || t > _dirtyEnd)) continue;
+        eval(t, d);
+        _samples[i] = this->_p;
+        if (patch) p[i] = this->_p;
+    }
+    if (!patch) p = _samples;
+    _sampleTarget = &p;
+
+    _sampleD = _uniformSpeed ? -1 : d;
+    _sampleStart = start;
+    _sampleDt = dt;
+    _dirtyStart = std::numeric_limits<float>::max();
+    _dirtyEnd = std::numeric_limits<float>::lowest();
+
+    // Uniform speed never reuses samples; don't keep them
+    if (_sampleD < 0) {
+        releaseSamples();
+        return;
+    }
+    if (!_sampleBudget.isOpen())
+        _sampleBudget.open("Curve samples", 1.0, [this]() { releaseSamples(); });
+    const size_t bytes = size_t(m) * size_t(d + 1) * sizeof(GMlib::Vector<float,3>);
+    _sampleBudget.charge(bytes);
+}
+
+inline void MyB_spline::releaseSamples() {
+    _samples = GMlib::DVector<GMlib::DVector<GMlib::Vector<float,3>>>();
+    _sampleD = -1;
+    _sampleTarget = nullptr;
+    _sampleBudget.charge(0);
+}
+
+#endif // MY_B_SPLINE_H
@@ -0,0 +1,228 @@
+#ifndef MY_CLOSED_B_SPLINE_H
+#define MY_CLOSED_B_SPLINE_H
+
+#include <parametrics/gmpcurve.h>
+#include <core/containers/gmdvector.h>
+
+#include <vector>
+
+#include "bsplinebasis.h"
+#include "cyclicbandedsolver.h"
+#include "mybspline.h"
+
+// MyClosedB_spline class definition inheriting from GMlib::PCurve
+// A periodic B-spline; n control points c_0, ..., c_{n-1} used cyclically, wrapped knots
+class MyClosedB_spline : public GMlib::PCurve<float,3> {
+    GM_SCENEOBJECT(MyClosedB_spline)
+
+public:
+    using Parametrization = MyB_spline::Parametrization;
+
+    // Constructor 1: Initialize with given control points (uniform knots)
+    MyClosedB_spline(const GMlib::DVector<GMlib::Vector<float,3>>& c);
+
+    // Constructor 2: Approximate a closed contour using least squares, with n control points
+    MyClosedB_spline(const GMlib::DVector<GMlib::Vector<float,3>>& p, int n,
+                     Parametrization param = Parametrization::ChordLength);
+
+    // Constructor 3: Interpolate a closed contour (the curve passes through every point)
+    MyClosedB_spline(const GMlib::DVector<GMlib::Vector<float,3>>& p, Parametrization param);
+
+protected:
+    // Evaluate the curve at parameter t with d derivatives
+    void eval(float t, int d, bool left = true) const override;
+
+    // One period; the extended knot vector holds degree knots on either side of it
+    float getStartP() const override {
+        return _knotVector[_degree];
+    }
+
+    float getEndP() const override {
+        return _knotVector[_knotVector.getDim() - 1 - _degree];
+    }
+
+    bool isClosed() const override {
+        return true;
+    }
+
+private:
+    GMlib::DVector<GMlib::Vector<float,3>> _controlPoints; // Control points, used cyclically
+    GMlib::DVector<float> _knotVector; // Extended knot vector; n + 2*degree + 1 knots
+    int _degree {2}; // Polynomial degree
+
+    // Extended knot vector from one period of breaks t_0 < ... < t_n (t_n closes the period)
+    void generateKnotVector(const std::vector<double>& breaks);
+
+    // Cyclic parameter values of p in [0,1); the closing segment counts too
+    static std::vector<double> parameters(const GMlib::DVector<GMlib::Vector<float,3>>& p, Parametrization param);
+
+    // Wrap t into [start, start + 1)
+    double wrap(double t) const;
+
+    // Compute control points using least squares fitting
+    void leastSquaresFit(const GMlib::DVector<GMlib::Vector<float,3>>& p, int n, Parametrization param);
+
+    // Compute control points and knots interpolating p
+    void interpolate(const GMlib::DVector<GMlib::Vector<float,3>>& p, Parametrization param);
+};
+
+// Constructor: Create a periodic B-spline from predefined control points
+MyClosedB_spline::MyClosedB_spline(const GMlib::DVector<GMlib::Vector<float,3>>& c)
+    : _controlPoints(c) {
+    const int n = c.getDim();
+    std::vector<double> breaks(n + 1);
+    for (int i = 0; i <= n; ++i) breaks[i] = double(i) / n;
+    generateKnotVector(breaks);
+}
+
+// Constructor: Approximate a closed contour using least squares fitting
+MyClosedB_spline::MyClosedB_spline(const GMlib::DVector<GMlib::Vector<float,3>>& p, int n, Parametrization param) {
+    leastSquaresFit(p, n, param);
+}
+
+// Constructor: Interpolate a closed contour
+MyClosedB_spline::MyClosedB_spline(const GMlib::DVector<GMlib::Vector<float,3>>& p, Parametrization param) {
+    interpolate(p, param);
+}
+
+// Knots e_j = t_{j-degree}, extended periodically: t_{i+n} = t_i + period
+void MyClosedB_spline::generateKnotVector(const std::vector<double>& breaks) {
+    const int n = int(breaks.size()) - 1;
+    const double period = breaks[n] - breaks[0];
+
+    _knotVector.setDim(n + 2 * _degree + 1);
+    for (int j = 0; j < n + 2 * _degree + 1; ++j) {
+        const int i = j - _degree;
+        const int r = ((i % n) + n) % n; // Break index within the period
+        const int w = (i - r) / n;       // Period offset
+        _knotVector[j] = float(breaks[r] + w * period);
+    }
+}
+
+std::vector<double> MyClosedB_spline::parameters(const GMlib::DVector<GMlib::Vector<float,3>>& p, Parametrization param) {
+    const int m = p.getDim();
+    std::vector<double> u(m + 1, 0.0); // u[m] closes the contour
+    for (int i = 1; i <= m; ++i) {
+        double dist = param == Parametrization::Uniform ? 1.0 : (p(i % m) - p(i - 1)).getLength();
+        if (param == Parametrization::Centripetal) dist = std::sqrt(dist);
+        u[i] = u[i - 1] + dist;
+    }
+    for (int i = 1; i <= m; ++i)
+        u[i] = u[m] > 0.0 ? u[i] / u[m] : double(i) / m; // Coincident points: uniform
+    u.pop_back();
+    return u;
+}
+
+double MyClosedB_spline::wrap(double t) const {
+    const double start = getStartP();
+    return t - std::floor(t - start); // Period is 1
+}
+
+// Least squares fit (periodic): minimize sum |c(u_k) - p_k|^2 over n control points
+// - Uniform periodic knots; the normal equations N^T N c = N^T p are cyclic banded
+//   (bandwidth degree) and symmetric positive definite; O(m degree^2 + n degree^2)
+void MyClosedB_spline::leastSquaresFit(const GMlib::DVector<GMlib::Vector<float,3>>& p, int n, Parametrization param) {
+    const int m = p.getDim(); // Number of input points
+    n = std::max(std::min(n, m), _degree + 1);
+
+    std::vector<double> breaks(n + 1);
+    for (int i = 0; i <= n; ++i) breaks[i] = double(i) / n;
+    generateKnotVector(breaks);
+
+    const std::vector<double> u = parameters(p, param);
+
+    CyclicBandedSolver<double> A(n, _degree);
+    std::vector<GMlib::Vector<double,3>> c(n, GMlib::Vector<double,3>(0.0, 0.0, 0.0));
+
+    double N[bspline::MaxDegree + 1];
+    for (int k = 0; k < m; ++k) {
+        const double t = wrap(u[k]);
+        const int span = bspline::findSpan(_knotVector, n + _degree, _degree, float(t));
+        bspline::basisFuns(_knotVector, span, _degree, t, N);
+
+        // Span span uses the control points c_{(span - degree + j) mod n}
+        const GMlib::Vector<double,3> q(p(k)(0), p(k)(1), p(k)(2));
+        for (int a = 0; a <= _degree; ++a) {
+            const int ia = (span - _degree + a) % n;
+            c[ia] += q * N[a];
+            for (int b = 0; b <= _degree; ++b)
+                A(ia, span - _degree + b) += N[a] * N[b];
+        }
+    }
+
+    _controlPoints.setDim(n);
+    if (!A.factorize()) { // Too few points, or gaps leaving control points without data
+        for (int i = 0; i < n; ++i) _controlPoints[i] = p(int(i * double(m) / n));
+        return;
+    }
+    A.solve(c.data());
+
+    for (int i = 0; i < n; ++i)
+        _controlPoints[i] = GMlib::Vector<float,3>(float(c[i](0)), float(c[i](1)), float(c[i](2)));
+}
+
+// Periodic interpolation: one control point per input point
+// - Knots by averaging degree consecutive (cyclic) parameter values, as in the open case;
+//   the largest basis function value of each row then lands on the diagonal
+// - The collocation matrix is cyclic banded; solved by Sherman-Morrison-Woodbury in O(n)
+void MyClosedB_spline::interpolate(const GMlib::DVector<GMlib::Vector<float,3>>& p, Parametrization param) {
+    const int n = p.getDim();
+    _degree = std::max(std::min(_degree, n - 1), 1);
+
+    const std::vector<double> u = parameters(p, param);
+    auto uc = [&](int i) { // Cyclic extension of the parameters
+        const int r = ((i % n) + n) % n;
+        return u[r] + double((i - r) / n);
+    };
+
+    std::vector<double> breaks(n + 1);
+    for (int i = 0; i <= n; ++i) {
+        double sum = 0.0;
+        for (int j = 0; j < _degree; ++j) sum += uc(i + j);
+        breaks[i] = sum / _degree;
+    }
+    generateKnotVector(breaks);
+
+    CyclicBandedSolver<double> A(n, _degree);
+    double N[bspline::MaxDegree + 1];
+    for (int k = 0; k < n; ++k) {
+        const double t = wrap(u[k]);
+        const int span = bspline::findSpan(_knotVector, n + _degree, _degree, float(t));
+        bspline::basisFuns(_knotVector, span, _degree, t, N);
+        for (int j = 0; j <= _degree; ++j)
+            A(k, span - _degree + j) += N[j];
+    }
+
+    std::vector<GMlib::Vector<double,3>> c(n);
+    for (int i = 0; i < n; ++i)
+        c[i] = GMlib::Vector<double,3>(p(i)(0), p(i)(1), p(i)(2));
+
+    _controlPoints = p;
+    if (!A.factorize()) return; // Only with repeated points; the points become control points
+    A.solve(c.data());
+
+    for (int i = 0; i < n; ++i)
+        _controlPoints[i] = GMlib::Vector<float,3>(float(c[i](0)), float(c[i](1)), float(c[i](2)));
+}
+
+// Evaluate the curve at parameter t with d derivatives
+void MyClosedB_spline::eval(float t, int d, bool left) const {
+    const int n = _controlPoints.getDim();
+    const int dd = std::min(d, bspline::MaxDerivatives);
+
+    this->_p.setDim(d + 1);
+    for (int k = 0; k <= d; ++k)
+        this->_p[k] = GMlib::Vector<float,3>(0.0f, 0.0f, 0.0f);
+
+    // The extended knot vector describes an open spline with n + degree control points,
+    // the last degree of them repeating the first ones
+    const int span = bspline::findSpan(_knotVector, n + _degree, _degree, t, left);
+    float ders[bspline::MaxDerivatives + 1][bspline::MaxDegree + 1];
+    bspline::basisFunsDerivs(_knotVector, span, _degree, t, dd, ders);
+
+    for (int k = 0; k <= dd; ++k)
+        for (int j = 0; j <= _degree; ++j)
+            this->_p[k] += ders[k][j] * _controlPoints[(span - _degree + j) % n];
+}
+
+#endif // MY_CLOSED_B_SPLINE_H
@@ -0,0 +1,222 @@
+#ifndef MY_ERBS_CURVE_H
+#define MY_ERBS_CURVE_H
+
+#include <parametrics/gmpcurve.h>
+#include <core/containers/gmdvector.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "erbsblend.h"
+#include "mybspline.h"
+#include "quantizedvertex.h"
+#include "quantizedvisualizers.h"
+
+// MyERBSCurve class definition inheriting from GMlib::PCurve
+// An ERBS curve with MyB_spline local curves: on the knot span [t_k, t_k+1]
+//   c(t) = c_k(t) + B(w) (c_k+1(t) - c_k(t)),   w = (t - t_k) / (t_k+1 - t_k)
+// B comes from the ERBSBlend table, so a sample costs two local curve evaluations and a lookup
+class MyERBSCurve : public GMlib::PCurve<float,3> {
+    GM_SCENEOBJECT(MyERBSCurve)
+
+public:
+    // Constructor: n local curves approximating g (open or closed like g); local curve k is a
+    // least squares MyB_spline with `control` control points through `samples` points of g
+    MyERBSCurve(GMlib::PCurve<float,3>* g, int n, int samples = 24, int control = 6);
+
+    int getNumLocalCurves() const { return int(_localCurves.size()); }
+    MyB_spline* getLocalCurve(int k) const { return _localCurves[k]; }
+
+    // The local curves are children; when shown they can be selected and moved
+    void showLocalCurves();
+    void hideLocalCurves();
+    bool isLocalCurvesVisible() const { return _localCurvesVisible; }
+
+    // Sample m points (with tangents) over the whole domain straight into the compressed layout
+    // of the QuantizedCurveVisualizers: every sample is encoded as it is evaluated (16 bit
+    // positions in the box of the local curves' control points, octahedral tangents), without
+    // float samples. Edits replot the same way; the next sample() goes back to float replots.
+    void sampleQuantized(int m);
+
+    // A local curve was moved; replot
+    void edit(GMlib::SceneObject* obj) override;
+
+protected:
+    // Float samples; leaves the quantized replots
+    void resample(GMlib::DVector<GMlib::DVector<GMlib::Vector<float,3>>>& p, int m, int d, float start, float end) override;
+
+    // Quantized replot of an edit
+    void localSimulate(double dt) override;
+
+    // Evaluate the curve at parameter t with d derivatives (at most ERBSBlend::MaxDerivatives)
+    void eval(float t, int d, bool left = true) const override;
+
+    float getStartP() const override {
+        return _knots[1];
+    }
+
+    // Open: t_n = t_n+1 is the end; closed: t_n+1 closes the period
+    float getEndP() const override {
+        return _knots[_knots.size() - (_closed ? 1 : 2)];
+    }
+
+    bool isClosed() const override {
+        return _closed;
+    }
+
+private:
+    std::vector<MyB_spline*> _localCurves; // Children of this curve
+    std::vector<float> _knots; // t_0, ..., t_n+1; local curve k lives on [t_k, t_k+2]
+    bool _closed {false};
+    bool _localCurvesVisible {false};
+    bool _quantizedReplot {false}; // Replots go through sampleQuantized()
+    bool _quantizedDirty {false}; // Edited since the last quantized replot
+    int _quantizedM {0};
+
+    // Local curve k at the ERBS parameter t, d derivatives with respect to t
+    GMlib::DVector<GMlib::Vector<float,3>> evalLocal(int k, float t, int d) const;
+};
+
+// Constructor: uniform knots over g's domain; open curves get double end knots
+inline MyERBSCurve::MyERBSCurve(GMlib::PCurve<float,3>* g, int n, int samples, int control)
+    : _closed(g->isClosed()) {
+    n = std::max(n, _closed ? 3 : 2);
+    samples = std::max(samples, 3);
+
+    const float start = g->getParStart();
+    const float period = g->getParDelta();
+    const float dt = period / (_closed ? n : n - 1);
+
+    _knots.resize(n + 2);
+    for (int j = 0; j < n + 2; ++j) _knots[j] = start + (j - 1) * dt;
+    if (!_closed) {
+        _knots[0] = _knots[1];
+        _knots[n + 1] = _knots[n];
+    }
+
+    for (int k = 0; k < n; ++k) {
+        // Equally spaced samples and uniform parametrization: the local parameter is linear in t
+        const float lo = _knots[k], hi = _knots[k + 2];
+        GMlib::DVector<GMlib::Vector<float,3>> p(samples);
+        for (int i = 0; i < samples; ++i) {
+            float s = lo + (hi - lo) * i / (samples - 1);
+            if (_closed) s = start + std::fmod(std::fmod(s - start, period) + period, period);
+            p[i] = g->evaluate(s, 0)[0];
+        }
+
+        auto local = new MyB_spline(p, control, MyB_spline::Parametrization::Uniform);
+        local->toggleDefaultVisualizer();
+        local->sample(4 * samples, 1);
+        local->setVisible(false);
+        insert(local);
+        _localCurves.push_back(local);
+    }
+}
+
+inline void MyERBSCurve::showLocalCurves() {
+    for (auto local : _localCurves) local->setVisible(true);
+    _localCurvesVisible = true;
+}
+
+inline void MyERBSCurve::hideLocalCurves() {
+    for (auto local : _localCurves) local->setVisible(false);
+    _localCurvesVisible = false;
+}
+
+inline void MyERBSCurve::edit(GMlib::SceneObject* obj) {
+    GMlib::PCurve<float,3>::edit(obj);
+    if (_quantizedReplot) _quantizedDirty = true; // Replotted by localSimulate()
+    else setEditDone(); // The scenario replots edited objects
+}
+
+// The box holds the curve: every point is a convex combination of two local curves, each
+// in the hull of its control points (placed by the local curve's frame)
+inline void MyERBSCurve::sampleQuantized(int m) {
+    if (m < 2) return;
+    _quantizedReplot = true;
+    _quantizedDirty = false;
+    _quantizedM = m;
+
+    std::vector<quantized::Vec> hull;
+    for (auto local : _localCurves)
+        for (int i = 0; i < local->getNumControlPoints(); ++i)
+            hull.push_back(local->getMatrix() * GMlib::Point<float,3>(local->getControlPoint(i)));
+    const quantized::Box box = quantized::Box::fromPoints(hull.begin(), hull.end());
+
+    const GMlib::Vector<float,3> offset(box.offset[0], box.offset[1], box.offset[2]);
+    const GMlib::Vector<float,3> extent(box.extent[0], box.extent[1], box.extent[2]);
+    setSurroundingSphere(GMlib::Sphere<float,3>(offset + extent * 0.5f, extent.getLength() * 0.5f));
+
+    const float start = getStartP(), dt = (getEndP() - start) / (m - 1);
+    GMlib::Array<GMlib::Visualizer*>& visus = getVisualizers();
+    for (int i = 0; i < visus.getSize(); ++i)
+        if (auto visu = dynamic_cast<QuantizedCurveVisualizer*>(visus[i]))
+            visu->upload(box, m, [this, &box, start, dt](int k) {
+                eval(start + k * dt, 1);
+                return quantized::encode(box, this->_p[0], this->_p[1]);
+            });
+}
+
+inline void MyERBSCurve::resample(GMlib::DVector<GMlib::DVector<GMlib::Vector<float,3>>>& p, int m, int d, float start, float end) {
+    _quantizedReplot = false;
+    _quantizedDirty = false;
+    GMlib::PCurve<float,3>::resample(p, m, d, start, end);
+}
+
+inline void MyERBSCurve::localSimulate(double /*dt*/) {
+    if (_quantizedReplot && _quantizedDirty) sampleQuantized(_quantizedM);
+}
+
+// Linear map from [t_k, t_k+2] onto the local curve's domain; the frame of the local
+// curve (moved by editing) is applied by evaluateParent
+inline GMlib::DVector<GMlib::Vector<float,3>> MyERBSCurve::evalLocal(int k, float t, int d) const {
+    MyB_spline* local = _localCurves[k];
+    const float scale = local->getParDelta() / (_knots[k + 2] - _knots[k]);
+
+    GMlib::DVector<GMlib::Vector<float,3>> p = local->evaluateParent(local->getParStart() + (t - _knots[k]) * scale, d);
+    float f = 1.0f;
+    for (int j = 1; j <= d; ++j) {
+        f *= scale;
+        p[j] = p[j] * f;
+    }
+    return p;
+}
+
+// Evaluate the curve at parameter t with d derivatives
+// - Leibniz: c^(j) = c_k^(j) + sum_i C(j,i) B^(i)(w) / dt^i (c_k+1 - c_k)^(j-i)
+inline void MyERBSCurve::eval(float t, int d, bool /*left*/) const {
+    static const int binomial[4][4] = { {1, 0, 0, 0}, {1, 1, 0, 0}, {1, 2, 1, 0}, {1, 3, 3, 1} };
+
+    const int n = int(_localCurves.size());
+    const int spans = _closed ? n : n - 1;
+    const int dd = std::min(d, ERBSBlend::MaxDerivatives);
+
+    this->_p.setDim(d + 1);
+    for (int j = 0; j <= d; ++j)
+        this->_p[j] = GMlib::Vector<float,3>(0.0f, 0.0f, 0.0f);
+
+    // Span k: [t_k+1, t_k+2] blends local curves k and k+1 (uniform knots; B is smooth at the knots)
+    const float dt = _knots[2] - _knots[1];
+    const int k = std::min(std::max(int(std::floor((t - _knots[1]) / dt)), 0), spans - 1);
+    const float w = (t - _knots[k + 1]) / dt;
+
+    double B[ERBSBlend::MaxDerivatives + 1];
+    ERBSBlend::table().eval(w, dd, B);
+
+    // Closed: the last span blends into local curve 0, one period back
+    const auto c0 = evalLocal(k, t, dd);
+    const auto c1 = k + 1 < n ? evalLocal(k + 1, t, dd) : evalLocal(0, t - getParDelta(), dd);
+
+    for (int j = 0; j <= dd; ++j) {
+        GMlib::Vector<float,3> v = c0[j];
+        float f = 1.0f;
+        for (int i = 0; i <= j; ++i) {
+            v += (c1[j - i] - c0[j - i]) * float(binomial[j][i] * B[i] * f);
+            f /= dt;
+        }
+        this->_p[j] = v;
+    }
+}
+
+#endif // MY_ERBS_CURVE_H
@@ -0,0 +1,583 @@
+#ifndef MY_ERBS_SURF_H
+#define MY_ERBS_SURF_H
+
+#include <parametrics/gmpsurf.h>
+#include <core/containers/gmdmatrix.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "erbsblend.h"
+#include "quantizedvertex.h"
+#include "quantizedvisualizers.h"
+#include "threadpool.h"
+
+// MyLocalPatch class definition inheriting from GMlib::PSurf
+// A bicubic Bezier patch on [0,1]x[0,1]; the local patches of MyERBSSurf
+class MyLocalPatch : public GMlib::PSurf<float,3> {
+    GM_SCENEOBJECT(MyLocalPatch)
+
+public:
+    // Control points c_ij at [4 * i + j], i along u
+    using Net = std::array<GMlib::Vector<float,3>, 16>;
+
+    explicit MyLocalPatch(const Net& c) : _c(c) {}
+
+    const Net& getControlNet() const { return _c; }
+
+    // S, S_u, S_v and S_uv of the net c at (u, v) into s[0..3]; no shared state, so it can
+    // run on any thread
+    static void evalNet(const Net& c, float u, float v, GMlib::Vector<float,3>* s);
+
+protected:
+    // Evaluate the patch at (u, v); derivatives above the mixed first are zero
+    void eval(float u, float v, int d1, int d2, bool lu = true, bool lv = true) const override;
+
+    float getStartPU() const override { return 0.0f; }
+    float getEndPU() const override { return 1.0f; }
+    float getStartPV() const override { return 0.0f; }
+    float getEndPV() const override { return 1.0f; }
+    bool isClosedU() const override { return false; }
+    bool isClosedV() const override { return false; }
+
+private:
+    Net _c;
+};
+
+// MyERBSSurf class definition inheriting from GMlib::PSurf
+// An ERBS surface over MyLocalPatch local patches: on the knot span [u_i, u_i+1] x [v_j, v_j+1]
+//   S(u,v) = sum_a,b B_a(w_u) B_b(w_v) s_i+a,j+b(u,v),   B_0 = 1 - B, B_1 = B
+// Tessellation (resample) is tiled: every local patch is evaluated once per knot-span tile it
+// covers into shared scratch, then each tile blends its four scratch buffers with the tabulated
+// ERBS weights of its rows and columns. Both phases run on the shared ThreadPool; sampleAsync()
+// runs the whole tessellation in the background and localSimulate() hands the result to the
+// visualizers on the render thread.
+class MyERBSSurf : public GMlib::PSurf<float,3> {
+    GM_SCENEOBJECT(MyERBSSurf)
+
+public:
+    // Constructor: n1 x n2 local patches interpolating 4 x 4 samples of g each (open or
+    // closed in u and v like g)
+    MyERBSSurf(GMlib::PSurf<float,3>* g, int n1, int n2);
+
+    int getNumLocalPatchesU() const { return _n1; }
+    int getNumLocalPatchesV() const { return _n2; }
+    MyLocalPatch* getLocalPatch(int i, int j) const { return _localPatches[i * _n2 + j]; }
+
+    // The local patches are children; when shown they can be selected and moved
+    void showLocalPatches();
+    void hideLocalPatches();
+    bool isLocalPatchesVisible() const { return _localPatchesVisible; }
+
+    // Tessellate m1 x m2 samples (with first derivatives) in the background; the surface is
+    // replotted by the first localSimulate() after the job is done. A request made while a job
+    // runs is queued; only the latest one is kept.
+    void sampleAsync(int m1, int m2);
+    bool isTessellating() const { return _job && !_job->done; }
+
+    // Tessellate m1 x m2 vertices over the whole domain straight into the compressed layout
+    // (16 bit positions in the box of the local patch nets, octahedral normals), grid indexed
+    void sampleQuantized(int m1, int m2, quantized::Mesh& mesh) const;
+
+    // Tessellate into the compressed layout and upload the mesh to the QuantizedSurfaceVisualizers,
+    // without float samples; edits replot the same way in the background. The next sample()
+    // goes back to float replots.
+    void sampleQuantized(int m1, int m2);
+
+    // A local patch was moved; replot in the background
+    void edit(GMlib::SceneObject* obj) override;
+
+protected:
+    // Evaluate the surface at (u, v) with d1, d2 derivatives (at most the mixed first)
+    void eval(float u, float v, int d1, int d2, bool lu = true, bool lv = true) const override;
+
+    // Tiled parallel tessellation; takes a finished sampleAsync() job when it matches
+    void resample(GMlib::DMatrix<GMlib::DMatrix<GMlib::Vector<float,3>>>& p,
+                  int m1, int m2, int d1, int d2,
+                  float s_u, float s_v, float e_u, float e_v) override;
+
+    void localSimulate(double dt) override;
+
+    float getStartPU() const override { return _u[1]; }
+    float getEndPU() const override { return _u[_u.size() - (_closedU ? 1 : 2)]; }
+    float getStartPV() const override { return _v[1]; }
+    float getEndPV() const override { return _v[_v.size() - (_closedV ? 1 : 2)]; }
+    bool isClosedU() const override { return _closedU; }
+    bool isClosedV() const override { return _closedV; }
+
+private:
+    // A tessellation; holds copies of everything it reads, so it never touches the surface
+    struct Job {
+        int m1, m2;
+        float s_u, s_v, e_u, e_v;
+        int n1, n2;
+        bool closedU, closedV;
+        std::vector<float> u, v; // Knots
+        std::vector<MyLocalPatch::Net> nets; // Local patch nets in the surface frame
+        GMlib::DMatrix<GMlib::DMatrix<GMlib::Vector<float,3>>> result;
+        quantized::Mesh* quantized {nullptr}; // Write here instead of result
+        quantized::Mesh mesh; // Output of background quantized jobs
+        std::atomic<bool> done {false};
+    };
+
+    int _n1, _n2;
+    bool _closedU, _closedV;
+    std::vector<float> _u, _v; // u_0, ..., u_n1+1; local patch (i,j) lives on [u_i, u_i+2] x [v_j, v_j+2]
+    std::vector<MyLocalPatch*> _localPatches; // Children of this surface, [i * n2 + j]
+    bool _localPatchesVisible {false};
+
+    std::shared_ptr<Job> _job; // Running or finished background tessellation
+    int _pendingM1 {0}, _pendingM2 {0}; // Request made while _job runs
+    int _lastM1 {0}, _lastM2 {0}; // Resolution of the last resample
+    bool _quantizedReplot {false}; // Replots go through sampleQuantized()
+
+    std::shared_ptr<Job> makeJob(int m1, int m2, float s_u, float s_v, float e_u, float e_v) const;
+    static void tessellate(Job& job);
+    void uploadQuantized(const quantized::Mesh& mesh, int m1, int m2);
+
+    // Local patch (i,j) at the ERBS parameter (u, v); s[0..3] = S, S_u, S_v, S_uv
+    void evalLocal(int i, int j, float u, float v, GMlib::Vector<float,3>* s) const;
+};
+
+inline void MyLocalPatch::evalNet(const Net& c, float u, float v, GMlib::Vector<float,3>* s) {
+    // Cubic Bernstein polynomials and their derivatives
+    auto bernstein = [](float t, float* b, float* db) {
+        const float r = 1.0f - t;
+        b[0] = r * r * r;
+        b[1] = 3.0f * t * r * r;
+        b[2] = 3.0f * t * t * r;
+        b[3] = t * t * t;
+        db[0] = -3.0f * r * r;
+        db[1] = 3.0f * r * r - 6.0f * t * r;
+        db[2] = 6.0f * t * r - 3.0f * t * t;
+        db[3] = 3.0f * t * t;
+    };
+
+    float bu[4], dbu[4], bv[4], dbv[4];
+    bernstein(u, bu, dbu);
+    bernstein(v, bv, dbv);
+
+    for (int k = 0; k < 4; ++k) s[k] = GMlib::Vector<float,3>(0.0f, 0.0f, 0.0f);
+    for (int i = 0; i < 4; ++i) {
+        GMlib::Vector<float,3> r(0.0f, 0.0f, 0.0f), dr(0.0f, 0.0f, 0.0f);
+        for (int j = 0; j < 4; ++j) {
+            r += c[4 * i + j] * bv[j];
+            dr += c[4 * i + j] * dbv[j];
+        }
+        s[0] += r * bu[i];
+        s[1] += r * dbu[i];
+        s[2] += dr * bu[i];
+        s[3] += dr * dbu[i];
+    }
+}
+
+inline void MyLocalPatch::eval(float u, float v, int d1, int d2, bool /*lu*/, bool /*lv*/) const {
+    GMlib::Vector<float,3> s[4];
+    evalNet(_c, u, v, s);
+
+    this->_p.setDim(d1 + 1, d2 + 1);
+    for (int i = 0; i <= d1; ++i)
+        for (int j = 0; j <= d2; ++j)
+            this->_p[i][j] = i < 2 && j < 2 ? s[2 * j + i] : GMlib::Vector<float,3>(0.0f, 0.0f, 0.0f);
+}
+
+// Constructor: uniform knots over g's domain; open directions get double end knots
+inline MyERBSSurf::MyERBSSurf(GMlib::PSurf<float,3>* g, int n1, int n2)
+    : _closedU(g->isClosedU()), _closedV(g->isClosedV()) {
+    _n1 = n1 = std::max(n1, _closedU ? 3 : 2);
+    _n2 = n2 = std::max(n2, _closedV ? 3 : 2);
+
+    auto knots = [](std::vector<float>& t, int n, bool closed, float start, float delta) {
+        const float dt = delta / (closed ? n : n - 1);
+        t.resize(n + 2);
+        for (int k = 0; k < n + 2; ++k) t[k] = start + (k - 1) * dt;
+        if (!closed) {
+            t[0] = t[1];
+            t[n + 1] = t[n];
+        }
+    };
+    knots(_u, n1, _closedU, g->getParStartU(), g->getParDeltaU());
+    knots(_v, n2, _closedV, g->getParStartV(), g->getParDeltaV());
+
+    // Inverse of the cubic Bernstein matrix at 0, 1/3, 2/3, 1: interpolating nets are A^-1 P A^-T
+    static const float inv[4][4] = { {  6.0f,  0.0f,  0.0f,  0.0f },
+                                     { -5.0f, 18.0f, -9.0f,  2.0f },
+                                     {  2.0f, -9.0f, 18.0f, -5.0f },
+                                     {  0.0f,  0.0f,  0.0f,  6.0f } };
+
+    auto wrap = [](float s, bool closed, float start, float delta) {
+        return closed ? start + std::fmod(std::fmod(s - start, delta) + delta, delta) : s;
+    };
+
+    for (int i = 0; i < n1; ++i) {
+        for (int j = 0; j < n2; ++j) {
+            GMlib::Vector<float,3> p[4][4];
+            for (int a = 0; a < 4; ++a) {
+                const float u = wrap(_u[i] + (_u[i + 2] - _u[i]) * a / 3.0f, _closedU, g->getParStartU(), g->getParDeltaU());
+                for (int b = 0; b < 4; ++b) {
+                    const float v = wrap(_v[j] + (_v[j + 2] - _v[j]) * b / 3.0f, _closedV, g->getParStartV(), g->getParDeltaV());
+                    p[a][b] = g->evaluate(u, v, 0, 0)[0][0];
+                }
+            }
+
+            GMlib::Vector<float,3> q[4][4]; // A^-1 P
+            for (int a = 0; a < 4; ++a)
+                for (int b = 0; b < 4; ++b) {
+                    q[a][b] = GMlib::Vector<float,3>(0.0f, 0.0f, 0.0f);
+                    for (int k = 0; k < 4; ++k) q[a][b] += p[k][b] * (inv[a][k] / 6.0f);
+                }
+
+            MyLocalPatch::Net c;
+            for (int a = 0; a < 4; ++a)
+                for (int b = 0; b < 4; ++b) {
+                    c[4 * a + b] = GMlib::Vector<float,3>(0.0f, 0.0f, 0.0f);
+                    for (int k = 0; k < 4; ++k) c[4 * a + b] += q[a][k] * (inv[b][k] / 6.0f);
+                }
+
+            auto local = new MyLocalPatch(c);
+            local->toggleDefaultVisualizer();
+            local->sample(8, 8, 1, 1);
+            local->setVisible(false);
+            insert(local);
+            _localPatches.push_back(local);
+        }
+    }
+}
+
+inline void MyERBSSurf::showLocalPatches() {
+    for (auto local : _localPatches) local->setVisible(true);
+    _localPatchesVisible = true;
+}
+
+inline void MyERBSSurf::hideLocalPatches() {
+    for (auto local : _localPatches) local->setVisible(false);
+    _localPatchesVisible = false;
+}
+
+inline void MyERBSSurf::edit(GMlib::SceneObject* obj) {
+    GMlib::PSurf<float,3>::edit(obj);
+    sampleAsync(_lastM1, _lastM2); // The replot itself runs in the background
+}
+
+inline void MyERBSSurf::sampleAsync(int m1, int m2) {
+    if (m1 < 2 || m2 < 2) return;
+    if (isTessellating()) {
+        _pendingM1 = m1;
+        _pendingM2 = m2;
+        return;
+    }
+
+    _job = makeJob(m1, m2, getStartPU(), getStartPV(), getEndPU(), getEndPV());
+    if (_quantizedReplot) _job->quantized = &_job->mesh;
+    std::shared_ptr<Job> job = _job;
+    ThreadPool::shared().enqueue([job] {
+        tessellate(*job);
+        job->done = true;
+    });
+}
+
+inline void MyERBSSurf::sampleQuantized(int m1, int m2, quantized::Mesh& mesh) const {
+    if (m1 < 2 || m2 < 2) return;
+    std::shared_ptr<Job> job = makeJob(m1, m2, getStartPU(), getStartPV(), getEndPU(), getEndPV());
+    job->quantized = &mesh;
+    tessellate(*job);
+}
+
+inline void MyERBSSurf::sampleQuantized(int m1, int m2) {
+    if (m1 < 2 || m2 < 2) return;
+    _quantizedReplot = true;
+    quantized::Mesh mesh;
+    sampleQuantized(m1, m2, mesh);
+    uploadQuantized(mesh, m1, m2);
+}
+
+// The bounding sphere is the one of the box; the nets' hull contains the surface
+inline void MyERBSSurf::uploadQuantized(const quantized::Mesh& mesh, int m1, int m2) {
+    _lastM1 = m1;
+    _lastM2 = m2;
+
+    const GMlib::Vector<float,3> offset(mesh.box.offset[0], mesh.box.offset[1], mesh.box.offset[2]);
+    const GMlib::Vector<float,3> extent(mesh.box.extent[0], mesh.box.extent[1], mesh.box.extent[2]);
+    setSurroundingSphere(GMlib::Sphere<float,3>(offset + extent * 0.5f, extent.getLength() * 0.5f));
+
+    GMlib::Array<GMlib::Visualizer*>& visus = getVisualizers();
+    for (int i = 0; i < visus.getSize(); ++i)
+        if (auto visu = dynamic_cast<QuantizedSurfaceVisualizer*>(visus[i])) visu->upload(mesh, m1, m2);
+}
+
+inline void MyERBSSurf::localSimulate(double /*dt*/) {
+    if (_job && _job->done) {
+        if (_job->quantized) {
+            if (_quantizedReplot) uploadQuantized(_job->mesh, _job->m1, _job->m2);
+        }
+        else
+            sample(_job->m1, _job->m2, 1, 1); // resample() takes the job
+        _job.reset();
+    }
+
+    if (_pendingM1 > 0 && !isTessellating()) {
+        const int m1 = _pendingM1, m2 = _pendingM2;
+        _pendingM1 = _pendingM2 = 0;
+        sampleAsync(m1, m2);
+    }
+}
+
+inline void MyERBSSurf::resample(GMlib::DMatrix<GMlib::DMatrix<GMlib::Vector<float,3>>>& p,
+                                 int m1, int m2, int d1, int d2,
+                                 float s_u, float s_v, float e_u, float e_v) {
+    _lastM1 = m1;
+    _lastM2 = m2;
+    _quantizedReplot = false;
+
+    // Higher derivatives are zero: the local patches are blended with their first derivatives only
+    if (d1 > 1 || d2 > 1) {
+        GMlib::PSurf<float,3>::resample(p, m1, m2, d1, d2, s_u, s_v, e_u, e_v);
+        return;
+    }
+
+    std::shared_ptr<Job> job;
+    if (_job && _job->done && !_job->quantized && _job->m1 == m1 && _job->m2 == m2 &&
+        _job->s_u == s_u && _job->s_v == s_v && _job->e_u == e_u && _job->e_v == e_v)
+        job = _job;
+    else {
+        job = makeJob(m1, m2, s_u, s_v, e_u, e_v);
+        tessellate(*job);
+    }
+    if (job == _job) _job.reset();
+
+    p.setDim(m1, m2);
+    for (int i = 0; i < m1; ++i)
+        for (int j = 0; j < m2; ++j) {
+            p[i][j].setDim(d1 + 1, d2 + 1);
+            for (int a = 0; a <= d1; ++a)
+                for (int b = 0; b <= d2; ++b) p[i][j][a][b] = job->result[i][j][a][b];
+        }
+}
+
+// Snapshot of the knots and the local patch nets; each net is mapped through its patch's frame
+// (Bezier patches are affine invariant), so moved patches are tessellated where they are drawn
+inline std::shared_ptr<MyERBSSurf::Job> MyERBSSurf::makeJob(int m1, int m2, float s_u, float s_v, float e_u, float e_v) const {
+    auto job = std::make_shared<Job>();
+    job->m1 = m1;
+    job->m2 = m2;
+    job->s_u = s_u;
+    job->s_v = s_v;
+    job->e_u = e_u;
+    job->e_v = e_v;
+    job->n1 = _n1;
+    job->n2 = _n2;
+    job->closedU = _closedU;
+    job->closedV = _closedV;
+    job->u = _u;
+    job->v = _v;
+
+    job->nets.resize(_localPatches.size());
+    for (size_t k = 0; k < _localPatches.size(); ++k) {
+        const GMlib::HqMatrix<float,3>& m = _localPatches[k]->getMatrix();
+        const MyLocalPatch::Net& c = _localPatches[k]->getControlNet();
+        for (int l = 0; l < 16; ++l) job->nets[k][l] = GMlib::Vector<float,3>(m * GMlib::Point<float,3>(c[l]));
+    }
+    return job;
+}
+
+// Two phases over knot-span tiles: (1) one task per local patch evaluates the patch at the
+// samples of each of the (up to) four tiles it covers into scratch; (2) one task per tile blends
+// its four scratch buffers with the ERBS weights, tabulated once per sample row and column
+inline void MyERBSSurf::tessellate(Job& job) {
+    using Vec = GMlib::Vector<float,3>;
+
+    // One direction: sample parameters, their spans, and the blend weights B(w), B'(w)/dt
+    struct Axis {
+        std::vector<float> t, b, db;
+        std::vector<int> first; // Samples of span s: [first[s], first[s + 1])
+        int spans;
+    };
+    auto axis = [](int m, float s, float e, const std::vector<float>& knots, int n, bool closed) {
+        Axis a;
+        a.spans = closed ? n : n - 1;
+        const float dt = knots[2] - knots[1];
+        a.t.resize(m);
+        a.b.resize(m);
+        a.db.resize(m);
+        a.first.assign(a.spans + 1, m);
+
+        for (int i = m - 1; i >= 0; --i) {
+            a.t[i] = s + (e - s) * i / (m - 1);
+            const int k = std::min(std::max(int(std::floor((a.t[i] - knots[1]) / dt)), 0), a.spans - 1);
+            for (int l = 0; l <= k; ++l) a.first[l] = i;
+
+            double B[2];
+            ERBSBlend::table().eval((a.t[i] - knots[k + 1]) / dt, 1, B);
+            a.b[i] = float(B[0]);
+            a.db[i] = float(B[1] / dt);
+        }
+        return a;
+    };
+    const Axis au = axis(job.m1, job.s_u, job.e_u, job.u, job.n1, job.closedU);
+    const Axis av = axis(job.m2, job.s_v, job.e_v, job.v, job.n2, job.closedV);
+
+    // Scratch per tile and corner (a,b): patch (s + a, t + b) at the tile's samples, 4 values each
+    const int tiles = au.spans * av.spans;
+    std::vector<std::vector<Vec>> scratch(size_t(tiles) * 4);
+
+    // Phase 1: local patch (i,j) covers the tiles (i - a, j - b); closed directions wrap, and
+    // there the patch is shifted by a period
+    ThreadPool::shared().run(job.n1 * job.n2, [&](int k) {
+        const int i = k / job.n2, j = k % job.n2;
+        const MyLocalPatch::Net& net = job.nets[size_t(k)];
+
+        for (int a = 0; a < 2; ++a) {
+            int s = i - a;
+            float shiftU = 0.0f;
+            if (s < 0) {
+                if (!job.closedU) continue;
+                s += job.n1;
+                shiftU = job.u[size_t(job.n1) + 1] - job.u[1];
+            }
+            if (s >= au.spans) continue;
+
+            for (int b = 0; b < 2; ++b) {
+                int t = j - b;
+                float shiftV = 0.0f;
+                if (t < 0) {
+                    if (!job.closedV) continue;
+                    t += job.n2;
+                    shiftV = job.v[size_t(job.n2) + 1] - job.v[1];
+                }
+                if (t >= av.spans) continue;
+
+                const int r0 = au.first[s], r1 = au.first[s + 1];
+                const int c0 = av.first[t], c1 = av.first[t + 1];
+                if (r0 >= r1 || c0 >= c1) continue;
+
+                // Linear map from [u_i, u_i+2] onto [0,1]
+                const float lu = job.u[i] + shiftU, su = 1.0f / (job.u[i + 2] - job.u[i]);
+                const float lv = job.v[j] + shiftV, sv = 1.0f / (job.v[j + 2] - job.v[j]);
+
+                std::vector<Vec>& out = scratch[size_t(t + s * av.spans) * 4 + size_t(2 * a + b)];
+                out.resize(size_t(r1 - r0) * size_t(c1 - c0) * 4);
+                Vec* o = out.data();
+                for (int r = r0; r < r1; ++r)
+                    for (int c = c0; c < c1; ++c, o += 4) {
+                        MyLocalPatch::evalNet(net, (au.t[r] - lu) * su, (av.t[c] - lv) * sv, o);
+                        o[1] *= su;
+                        o[2] *= sv;
+                        o[3] *= su * sv;
+                    }
+            }
+        }
+    });
+
+    // Phase 2: blend; the blend of the Bezier patches lies in the convex hull of their nets
+    if (job.quantized) {
+        std::vector<Vec> points;
+        points.reserve(job.nets.size() * 16);
+        for (const MyLocalPatch::Net& net : job.nets) points.insert(points.end(), net.begin(), net.end());
+        job.quantized->box = quantized::Box::fromPoints(points.begin(), points.end());
+        job.quantized->vertices.resize(size_t(job.m1) * size_t(job.m2));
+        quantized::gridIndices(job.m1, job.m2, job.quantized->indices);
+    }
+    else
+        job.result.setDim(job.m1, job.m2);
+    ThreadPool::shared().run(tiles, [&](int tile) {
+        const int s = tile / av.spans, t = tile % av.spans;
+        const int r0 = au.first[s], r1 = au.first[s + 1];
+        const int c0 = av.first[t], c1 = av.first[t + 1];
+        if (r0 >= r1 || c0 >= c1) return;
+
+        const Vec* in[4];
+        for (int k = 0; k < 4; ++k) in[k] = scratch[size_t(tile) * 4 + size_t(k)].data();
+
+        size_t o = 0;
+        for (int r = r0; r < r1; ++r) {
+            const float wu[2] = { 1.0f - au.b[r], au.b[r] }, dwu[2] = { -au.db[r], au.db[r] };
+            for (int c = c0; c < c1; ++c, o += 4) {
+                const float wv[2] = { 1.0f - av.b[c], av.b[c] }, dwv[2] = { -av.db[c], av.db[c] };
+
+                Vec S(0.0f, 0.0f, 0.0f), Su(0.0f, 0.0f, 0.0f), Sv(0.0f, 0.0f, 0.0f), Suv(0.0f, 0.0f, 0.0f);
+                for (int a = 0; a < 2; ++a)
+                    for (int b = 0; b < 2; ++b) {
+                        const Vec* x = in[2 * a + b] + o;
+                        S += x[0] * (wu[a] * wv[b]);
+                        Su += x[0] * (dwu[a] * wv[b]) + x[1] * (wu[a] * wv[b]);
+                        Sv += x[0] * (wu[a] * dwv[b]) + x[2] * (wu[a] * wv[b]);
+                        Suv += x[0] * (dwu[a] * dwv[b]) + x[1] * (wu[a] * dwv[b]) + x[2] * (dwu[a] * wv[b]) + x[3] * (wu[a] * wv[b]);
+                    }
+
+                if (job.quantized) {
+                    const Vec n(Su(1) * Sv(2) - Su(2) * Sv(1), Su(2) * Sv(0) - Su(0) * Sv(2), Su(0) * Sv(1) - Su(1) * Sv(0));
+                    job.quantized->vertices[size_t(r) * size_t(job.m2) + size_t(c)] = quantized::encode(job.quantized->box, S, n);
+                    continue;
+                }
+
+                GMlib::DMatrix<Vec>& p = job.result[r][c];
+                p.setDim(2, 2);
+                p[0][0] = S;
+                p[1][0] = Su;
+                p[0][1] = Sv;
+                p[1][1] = Suv;
+            }
+        }
+        for (int k = 0; k < 4; ++k) std::vector<Vec>().swap(scratch[size_t(tile) * 4 + size_t(k)]);
+    });
+}
+
+// Linear map from [u_i, u_i+2] x [v_j, v_j+2] onto the local patch's domain; the frame of the
+// local patch (moved by editing) is applied by evaluateParent
+inline void MyERBSSurf::evalLocal(int i, int j, float u, float v, GMlib::Vector<float,3>* s) const {
+    MyLocalPatch* local = _localPatches[i * _n2 + j];
+    const float su = 1.0f / (_u[i + 2] - _u[i]);
+    const float sv = 1.0f / (_v[j + 2] - _v[j]);
+
+    const GMlib::DMatrix<GMlib::Vector<float,3>>& p = local->evaluateParent((u - _u[i]) * su, (v - _v[j]) * sv, 1, 1);
+    s[0] = p[0][0];
+    s[1] = p[1][0] * su;
+    s[2] = p[0][1] * sv;
+    s[3] = p[1][1] * (su * sv);
+}
+
+// Evaluate the surface at (u, v): the tensor product blend of four local patches, differentiated
+// by the product rule
+inline void MyERBSSurf::eval(float u, float v, int d1, int d2, bool /*lu*/, bool /*lv*/) const {
+    const int spansU = _closedU ? _n1 : _n1 - 1;
+    const int spansV = _closedV ? _n2 : _n2 - 1;
+    const float du = _u[2] - _u[1], dv = _v[2] - _v[1];
+    const int i = std::min(std::max(int(std::floor((u - _u[1]) / du)), 0), spansU - 1);
+    const int j = std::min(std::max(int(std::floor((v - _v[1]) / dv)), 0), spansV - 1);
+
+    double Bu[2], Bv[2];
+    ERBSBlend::table().eval((u - _u[i + 1]) / du, 1, Bu);
+    ERBSBlend::table().eval((v - _v[j + 1]) / dv, 1, Bv);
+    const float wu[2] = { float(1.0 - Bu[0]), float(Bu[0]) }, dwu[2] = { float(-Bu[1] / du), float(Bu[1] / du) };
+    const float wv[2] = { float(1.0 - Bv[0]), float(Bv[0]) }, dwv[2] = { float(-Bv[1] / dv), float(Bv[1] / dv) };
+
+    GMlib::Vector<float,3> S(0.0f, 0.0f, 0.0f), Su(0.0f, 0.0f, 0.0f), Sv(0.0f, 0.0f, 0.0f), Suv(0.0f, 0.0f, 0.0f);
+    for (int a = 0; a < 2; ++a)
+        for (int b = 0; b < 2; ++b) {
+            // Closed: the last span blends into patch 0, one period back
+            const bool wrapU = i + a == _n1, wrapV = j + b == _n2;
+            GMlib::Vector<float,3> x[4];
+            evalLocal(wrapU ? 0 : i + a, wrapV ? 0 : j + b,
+                      wrapU ? u - getParDeltaU() : u, wrapV ? v - getParDeltaV() : v, x);
+
+            S += x[0] * (wu[a] * wv[b]);
+            Su += x[0] * (dwu[a] * wv[b]) + x[1] * (wu[a] * wv[b]);
+            Sv += x[0] * (wu[a] * dwv[b]) + x[2] * (wu[a] * wv[b]);
+            Suv += x[0] * (dwu[a] * dwv[b]) + x[1] * (wu[a] * dwv[b]) + x[2] * (dwu[a] * wv[b]) + x[3] * (wu[a] * wv[b]);
+        }
+
+    this->_p.setDim(d1 + 1, d2 + 1);
+    for (int a = 0; a <= d1; ++a)
+        for (int b = 0; b <= d2; ++b)
+            this->_p[a][b] = GMlib::Vector<float,3>(0.0f, 0.0f, 0.0f);
+    this->_p[0][0] = S;
+    if (d1 > 0) this->_p[1][0] = Su;
+    if (d2 > 0) this->_p[0][1] = Sv;
+    if (d1 > 0 && d2 > 0) this->_p[1][1] = Suv;
+}
+
+#endif // MY_ERBS_SURF_H
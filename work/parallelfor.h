@@ -0,0 +1,33 @@
+#ifndef PARALLEL_FOR_H
+#define PARALLEL_FOR_H
+
+#include "threadpool.h"
+
+#include <algorithm>
+
+/*!
+ *  parallelFor(begin, end, f, min_chunk)
+ *
+ *  - Splits [begin, end) into contiguous chunks, at most one per thread of the shared
+ *    ThreadPool plus the calling thread, and calls f(first, last) for each chunk.
+ *  - Chunks are at least min_chunk long; small ranges run on the calling thread only.
+ *  - Runs on the pool's persistent workers; no thread is created per call, so passes of
+ *    a few milliseconds each stay cheap. May be called from a pool task.
+ *  - Returns when all chunks are done. f must not throw.
+ */
+template <typename F>
+void parallelFor(int begin, int end, F f, int min_chunk = 1) {
+
+  const int size = end - begin;
+  if(size <= 0) return;
+
+  ThreadPool& pool  = ThreadPool::shared();
+  const int  chunks = std::max(std::min(pool.size() + 1, size / std::max(min_chunk, 1)), 1);
+  if(chunks == 1) { f(begin, end); return; }
+
+  pool.run(chunks, [&f, begin, size, chunks](int c) {
+    f(begin + int(long(size) * c / chunks), begin + int(long(size) * (c + 1) / chunks));
+  });
+}
+
+#endif // PARALLEL_FOR_H
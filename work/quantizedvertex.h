@@ -0,0 +1,143 @@
+#ifndef QUANTIZED_VERTEX_H
+#define QUANTIZED_VERTEX_H
+
+#include <core/types/gmpoint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/*!
+ *  Compressed vertex layout for sampled curves and surfaces, 12 bytes per vertex instead of
+ *  24 for float positions and normals.
+ *
+ *  - Positions are 3 x 16 bit unsigned normalized coordinates relative to a bounding box;
+ *    the error is at most extent / 131070 per axis. The box is known before evaluation
+ *    where the geometry lies in the convex hull of its control points (Bezier, ERBS).
+ *  - Normals (surfaces) or tangents (curves) are unit vectors octahedral encoded into
+ *    2 x 16 bit signed normalized values; the angular error is below 0.05 degree.
+ *  - GL attributes (stride 12): position, 3 x GL_UNSIGNED_SHORT normalized at offset 0;
+ *    direction, 2 x GL_SHORT normalized at offset 8. The vertex shader computes
+ *    box.offset + position * box.extent (or the box is folded into the model matrix) and
+ *    decodes the direction as octDecode() does.
+ */
+namespace quantized {
+
+  using Vec = GMlib::Vector<float,3>;
+
+  struct Box {
+    float offset[3] {0.0f, 0.0f, 0.0f};
+    float extent[3] {1.0f, 1.0f, 1.0f};   // Never 0
+
+    static Box fromBounds(const Vec& lo, const Vec& hi) {
+
+      Box b;
+      for(int a = 0; a < 3; ++a) {
+        b.offset[a] = lo(a);
+        b.extent[a] = std::max(hi(a) - lo(a), 1e-30f);
+      }
+      return b;
+    }
+
+    // Bounding box of the points [first, last)
+    template <typename It>
+    static Box fromPoints(It first, It last) {
+
+      if(first == last) return Box();
+      Vec lo = *first, hi = lo;
+      for(; first != last; ++first)
+        for(int a = 0; a < 3; ++a) {
+          lo[a] = std::min(lo[a], (*first)(a));
+          hi[a] = std::max(hi[a], (*first)(a));
+        }
+      return fromBounds(lo, hi);
+    }
+  };
+
+  struct Vertex {
+    std::uint16_t  position[4];    // x, y, z, padding (0)
+    std::int16_t   direction[2];   // Octahedral normal or tangent
+  };
+
+  struct Mesh {
+    Box                        box;
+    std::vector<Vertex>        vertices;
+    std::vector<unsigned int>  indices;
+  };
+
+  inline std::uint16_t unorm16(float x) {
+
+    return std::uint16_t(std::lround(std::min(std::max(x, 0.0f), 1.0f) * 65535.0f));
+  }
+
+  inline std::int16_t snorm16(float x) {
+
+    return std::int16_t(std::lround(std::min(std::max(x, -1.0f), 1.0f) * 32767.0f));
+  }
+
+  inline void encodePosition(const Box& box, const Vec& p, std::uint16_t* out) {
+
+    for(int a = 0; a < 3; ++a) out[a] = unorm16((p(a) - box.offset[a]) / box.extent[a]);
+    out[3] = 0;
+  }
+
+  inline Vec decodePosition(const Box& box, const std::uint16_t* in) {
+
+    Vec p;
+    for(int a = 0; a < 3; ++a) p[a] = box.offset[a] + in[a] / 65535.0f * box.extent[a];
+    return p;
+  }
+
+  // Unit (or zero) vector onto the octahedron |x| + |y| + |z| = 1, the lower half folded out
+  inline void octEncode(const Vec& d, std::int16_t* out) {
+
+    const float l1 = std::abs(d(0)) + std::abs(d(1)) + std::abs(d(2));
+    if(l1 <= 0.0f) { out[0] = out[1] = 0; return; }
+
+    float x = d(0) / l1, y = d(1) / l1;
+    if(d(2) < 0.0f) {
+      const float fx = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+      const float fy = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+      x = fx;
+      y = fy;
+    }
+    out[0] = snorm16(x);
+    out[1] = snorm16(y);
+  }
+
+  inline Vec octDecode(const std::int16_t* in) {
+
+    const float x = std::max(in[0] / 32767.0f, -1.0f), y = std::max(in[1] / 32767.0f, -1.0f);
+    Vec d(x, y, 1.0f - std::abs(x) - std::abs(y));
+    if(d(2) < 0.0f) {
+      d[0] = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+      d[1] = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+    }
+    const float l = std::sqrt(d(0) * d(0) + d(1) * d(1) + d(2) * d(2));
+    return l > 0.0f ? d * (1.0f / l) : d;
+  }
+
+  inline Vertex encode(const Box& box, const Vec& p, const Vec& direction) {
+
+    Vertex v;
+    encodePosition(box, p, v.position);
+    octEncode(direction, v.direction);
+    return v;
+  }
+
+  // Two triangles per cell of an m1 x m2 grid of vertices, vertex (i, j) at i m2 + j
+  inline void gridIndices(int m1, int m2, std::vector<unsigned int>& indices) {
+
+    indices.clear();
+    indices.reserve(size_t(std::max(m1 - 1, 0)) * size_t(std::max(m2 - 1, 0)) * 6);
+    for(int i = 0; i + 1 < m1; ++i)
+      for(int j = 0; j + 1 < m2; ++j) {
+        const unsigned int a = unsigned(i * m2 + j), b = a + unsigned(m2);
+        indices.insert(indices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+      }
+  }
+
+} // END namespace quantized
+
+#endif // QUANTIZED_VERTEX_H
@@ -0,0 +1,384 @@
+#ifndef QUANTIZED_VISUALIZERS_H
+#define QUANTIZED_VISUALIZERS_H
+
+#include "quantizedvertex.h"
+#include "streamring.h"
+
+// gmlib
+#include <parametrics/visualizers/gmpcurvevisualizer.h>
+#include <parametrics/visualizers/gmpsurfvisualizer.h>
+#include <opengl/gmprogram.h>
+#include <opengl/shaders/gmvertexshader.h>
+#include <opengl/shaders/gmfragmentshader.h>
+#include <opengl/bufferobjects/gmvertexbufferobject.h>
+#include <opengl/bufferobjects/gmindexbufferobject.h>
+#include <core/types/gmmatrix.h>
+#include <scene/render/gmdefaultrenderer.h>
+#include <scene/camera/gmcamera.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*!
+ *  Visualizers drawing from the compressed vertex layout of quantizedvertex.h; 12 bytes
+ *  per vertex in the VBO, decoded in the vertex shader.
+ *
+ *  - Attributes (stride 12): in_position, 3 x GL_UNSIGNED_SHORT normalized at offset 0,
+ *    moved into the box (u_box_offset, u_box_extent); in_direction, 2 x GL_SHORT
+ *    normalized at offset 8, octahedral decoded.
+ *  - QuantizedSurfaceVisualizer draws indexed triangles lit by the decoded normal; it takes
+ *    a quantized::Mesh as is (MyERBSSurf::sampleQuantized, BezierTriangles), or encodes the
+ *    float samples of any PSurf on replot.
+ *  - QuantizedCurveVisualizer draws a line strip shaded by the decoded tangent; it takes
+ *    vertices encoded as the curve is evaluated (MyERBSCurve::sampleQuantized), or encodes
+ *    the float samples of any PCurve on replot.
+ *  - Directions go to eye space by u_dmat: the normal matrix (inverse transpose of the
+ *    model view) for surface normals, the model view itself for curve tangents; both stay
+ *    right under non-uniform scaling.
+ *  - Vertices are encoded (or copied) straight into the shared StreamRing and copied into
+ *    the VBO on the GPU; without a ring, or when it is full, they go through bufferSubData.
+ *    The VBO is only reallocated when the vertex count grows.
+ */
+namespace quantized {
+
+  namespace detail {
+
+    // The vertex shader of both; the direction is handed on in eye space
+    constexpr const char* vs =
+      "#version 150 core\n"
+      "uniform mat4 u_mvpmat;\n"
+      "uniform mat3 u_dmat;\n"
+      "uniform vec3 u_box_offset, u_box_extent;\n"
+      "in vec3 in_position;\n"
+      "in vec2 in_direction;\n"
+      "out vec3 ex_direction;\n"
+      "vec3 octDecode(vec2 e) {\n"
+      "  e = max(e, vec2(-1.0));\n"
+      "  vec3 d = vec3(e, 1.0 - abs(e.x) - abs(e.y));\n"
+      "  if(d.z < 0.0) d.xy = (1.0 - abs(e.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);\n"
+      "  return normalize(d);\n"
+      "}\n"
+      "void main() {\n"
+      "  ex_direction = u_dmat * octDecode(in_direction);\n"
+      "  gl_Position  = u_mvpmat * vec4(u_box_offset + in_position * u_box_extent, 1.0);\n"
+      "}\n";
+
+    // Surfaces; two sided headlight on the normal
+    constexpr const char* surface_fs =
+      "#version 150 core\n"
+      "uniform vec4 u_color;\n"
+      "uniform float u_shade;\n"
+      "in vec3 ex_direction;\n"
+      "out vec4 out_color;\n"
+      "void main() {\n"
+      "  float l = 0.25 + 0.75 * abs(normalize(ex_direction).z);\n"
+      "  out_color = vec4(u_color.rgb * mix(1.0, l, u_shade), u_color.a);\n"
+      "}\n";
+
+    // Curves; darker where the tangent points along the view axis
+    constexpr const char* curve_fs =
+      "#version 150 core\n"
+      "uniform vec4 u_color;\n"
+      "uniform float u_shade;\n"
+      "in vec3 ex_direction;\n"
+      "out vec4 out_color;\n"
+      "void main() {\n"
+      "  float l = 1.0 - 0.5 * abs(normalize(ex_direction).z);\n"
+      "  out_color = vec4(u_color.rgb * mix(1.0, l, u_shade), u_color.a);\n"
+      "}\n";
+
+    // The program of the given name; built on first use, shared by name after that
+    inline void acquireProgram(GMlib::GL::Program& prog, const std::string& name, const char* fs_src) {
+
+      if(prog.acquire(name)) return;
+
+      GMlib::GL::VertexShader vshader;
+      vshader.create();
+      vshader.setSource(vs);
+      if(!vshader.compile()) std::cerr << name << " vertex shader: " << vshader.getCompilerLog() << std::endl;
+
+      GMlib::GL::FragmentShader fshader;
+      fshader.create();
+      fshader.setSource(fs_src);
+      if(!fshader.compile()) std::cerr << name << " fragment shader: " << fshader.getCompilerLog() << std::endl;
+
+      prog.create(name);
+      prog.attachShader(vshader);
+      prog.attachShader(fshader);
+      if(!prog.link()) std::cerr << name << " program: " << prog.getLinkerLog() << std::endl;
+    }
+
+    // VBO storage for count vertices; reallocated only when count grows
+    inline void reserve(GMlib::GL::VertexBufferObject& vbo, int& capacity, int count) {
+
+      if(count <= capacity) return;
+      vbo.bufferData(size_t(count) * sizeof(Vertex), nullptr, GL_DYNAMIC_DRAW);
+      capacity = count;
+    }
+
+    // Vertices [0, count) of vbo, written by fill into the shared StreamRing and copied on the
+    // GPU; false if there is no ring or no room in this frame's region
+    template <typename Fill>
+    bool stream(const GMlib::GL::VertexBufferObject& vbo, int count, Fill fill) {
+
+      StreamRing* ring = StreamRing::shared();
+      const StreamRing::Allocation a = ring ? ring->allocate(size_t(count) * sizeof(Vertex)) : StreamRing::Allocation();
+      if(!a) return false;
+
+      fill(static_cast<Vertex*>(a.data));
+      ring->commit(a);
+      return ring->copy(a, vbo.getId(), 0);
+    }
+
+    // Linear part of the model view; for normals its inverse transpose, the cofactors over
+    // the determinant
+    inline GMlib::SqMatrix<float,3> directionMatrix(const GMlib::HqMatrix<float,3>& mv, bool normals) {
+
+      GMlib::SqMatrix<float,3> m;
+      auto a = [&mv](int r, int c) { return double(mv(r % 3)(c % 3)); };
+      if(!normals) {
+        for(int r = 0; r < 3; ++r)
+          for(int c = 0; c < 3; ++c) m[r][c] = float(a(r, c));
+        return m;
+      }
+
+      double cof[3][3];
+      for(int r = 0; r < 3; ++r)
+        for(int c = 0; c < 3; ++c) cof[r][c] = a(r + 1, c + 1) * a(r + 2, c + 2) - a(r + 1, c + 2) * a(r + 2, c + 1);
+      const double det = a(0, 0) * cof[0][0] + a(0, 1) * cof[0][1] + a(0, 2) * cof[0][2];
+      const double s   = std::abs(det) > 1e-30 ? 1.0 / det : 1.0;
+      for(int r = 0; r < 3; ++r)
+        for(int c = 0; c < 3; ++c) m[r][c] = float(cof[r][c] * s);
+      return m;
+    }
+
+    // Binds the program with its uniforms and the VBO with the attribute layout, runs draw;
+    // normals tells whether the directions are normals or tangents
+    template <typename Draw>
+    void render(const GMlib::GL::Program& prog, const GMlib::GL::VertexBufferObject& vbo, const Box& box,
+                const GMlib::SceneObject* obj, const GMlib::Camera* cam,
+                const GMlib::Color& color, bool shade, bool normals, Draw draw) {
+
+      prog.bind(); {
+
+        prog.uniform("u_dmat", directionMatrix(obj->getModelViewMatrix(cam), normals));
+        prog.uniform("u_mvpmat", obj->getModelViewProjectionMatrix(cam));
+        prog.uniform("u_box_offset", Vec(box.offset[0], box.offset[1], box.offset[2]));
+        prog.uniform("u_box_extent", Vec(box.extent[0], box.extent[1], box.extent[2]));
+        prog.uniform("u_color", color);
+        prog.uniform("u_shade", shade ? 1.0f : 0.0f);
+
+        GMlib::GL::AttributeLocation pos_loc = prog.getAttributeLocation("in_position");
+        GMlib::GL::AttributeLocation dir_loc = prog.getAttributeLocation("in_direction");
+
+        vbo.bind();
+        vbo.enable(pos_loc, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(Vertex), reinterpret_cast<const GLvoid*>(0x0));
+        vbo.enable(dir_loc, 2, GL_SHORT, GL_TRUE, sizeof(Vertex), reinterpret_cast<const GLvoid*>(offsetof(Vertex, direction)));
+
+        draw();
+
+        vbo.disable(dir_loc);
+        vbo.disable(pos_loc);
+        vbo.unbind();
+
+      } prog.unbind();
+    }
+
+  } // END namespace detail
+
+} // END namespace quantized
+
+
+
+class QuantizedSurfaceVisualizer : public GMlib::PSurfVisualizer<float,3> {
+  GM_VISUALIZER(QuantizedSurfaceVisualizer)
+public:
+  QuantizedSurfaceVisualizer() {
+
+    quantized::detail::acquireProgram(_prog, "quantized_surface", quantized::detail::surface_fs);
+    _vbo.create();
+    _ibo.create();
+  }
+
+  void setColor(const GMlib::Color& color) { _color = color; }
+
+  // A mesh whose index layout is identified by m1 x m2: a grid of m1 x m2 vertices (as from
+  // MyERBSSurf::sampleQuantized), or m1 segments per edge of m2 Bezier triangles
+  // (BezierTriangles); the indices are only uploaded when the layout changes. GL thread.
+  void upload(const quantized::Mesh& mesh, int m1, int m2) {
+
+    const int n = int(mesh.vertices.size());
+
+    _box = mesh.box;
+    quantized::detail::reserve(_vbo, _capacity, n);
+    if(!quantized::detail::stream(_vbo, n, [&mesh](quantized::Vertex* v) { std::copy(mesh.vertices.begin(), mesh.vertices.end(), v); }))
+      _vbo.bufferSubData(0, size_t(n) * sizeof(quantized::Vertex), mesh.vertices.data());
+
+    uploadIndices(mesh.indices, m1, m2);
+  }
+
+  // Float samples of any PSurf; encoded in the bounding box of the positions
+  void replot(const GMlib::DMatrix<GMlib::DMatrix<GMlib::Vector<float,3>>>& p,
+              const GMlib::DMatrix<GMlib::Vector<float,3>>& normals,
+              int m1, int m2, int /*d1*/, int /*d2*/,
+              bool /*closed_u*/, bool /*closed_v*/) override {
+
+    _points.clear();
+    for(int i = 0; i < m1; ++i)
+      for(int j = 0; j < m2; ++j) _points.push_back(p[i][j][0][0]);
+
+    _box = quantized::Box::fromPoints(_points.begin(), _points.end());
+    const auto encode = [this, &normals, m1, m2](quantized::Vertex* v) {
+      for(int i = 0; i < m1; ++i)
+        for(int j = 0; j < m2; ++j) {
+          const size_t k = size_t(i) * size_t(m2) + size_t(j);
+          v[k] = quantized::encode(_box, _points[k], normals[i][j]);
+        }
+    };
+
+    const int n = m1 * m2;
+    quantized::detail::reserve(_vbo, _capacity, n);
+    if(!quantized::detail::stream(_vbo, n, encode)) {
+      _vertices.resize(size_t(n));
+      encode(_vertices.data());
+      _vbo.bufferSubData(0, size_t(n) * sizeof(quantized::Vertex), _vertices.data());
+    }
+
+    if(m1 != _m1 || m2 != _m2) quantized::gridIndices(m1, m2, _indices);
+    uploadIndices(_indices, m1, m2);
+  }
+
+  void render(const GMlib::SceneObject* obj, const GMlib::DefaultRenderer* renderer) const override {
+
+    draw(obj, renderer->getCamera(), _color, true);
+  }
+
+  void renderGeometry(const GMlib::SceneObject* obj, const GMlib::Renderer* renderer, const GMlib::Color& color) const override {
+
+    draw(obj, renderer->getCamera(), color, false);
+  }
+
+private:
+  GMlib::GL::Program              _prog;
+  GMlib::GL::VertexBufferObject   _vbo;
+  GMlib::GL::IndexBufferObject    _ibo;
+  GMlib::Color                    _color {GMlib::GMcolor::lightGrey()};
+
+  quantized::Box                  _box;
+  int                             _capacity {0};  // Vertices the VBO has room for
+  int                             _m1 {0}, _m2 {0};
+  GLsizei                         _no_indices {0};
+
+  // Scratch of replot()
+  std::vector<quantized::Vec>     _points;
+  std::vector<quantized::Vertex>  _vertices;      // Without a stream ring
+  std::vector<unsigned int>       _indices;
+
+  // The indices only change with the grid
+  void uploadIndices(const std::vector<unsigned int>& indices, int m1, int m2) {
+
+    if(m1 == _m1 && m2 == _m2 && GLsizei(indices.size()) == _no_indices) return;
+    _m1 = m1;
+    _m2 = m2;
+    _no_indices = GLsizei(indices.size());
+    _ibo.bufferData(indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+  }
+
+  void draw(const GMlib::SceneObject* obj, const GMlib::Camera* cam, const GMlib::Color& color, bool shade) const {
+
+    if(_no_indices == 0) return;
+
+    quantized::detail::render(_prog, _vbo, _box, obj, cam, color, shade, true, [this] {
+      _ibo.bind();
+      GL_CHECK(::glDrawElements(GL_TRIANGLES, _no_indices, GL_UNSIGNED_INT, reinterpret_cast<const GLvoid*>(0x0)));
+      _ibo.unbind();
+    });
+  }
+};
+
+
+
+class QuantizedCurveVisualizer : public GMlib::PCurveVisualizer<float,3> {
+  GM_VISUALIZER(QuantizedCurveVisualizer)
+public:
+  QuantizedCurveVisualizer() {
+
+    quantized::detail::acquireProgram(_prog, "quantized_curve", quantized::detail::curve_fs);
+    _vbo.create();
+  }
+
+  void setColor(const GMlib::Color& color) { _color = color; }
+
+  // n vertices written as the curve is evaluated: eval(i) evaluates sample i and returns it
+  // encoded in box, straight into the StreamRing; no float samples. GL thread.
+  template <typename Eval>
+  void upload(const quantized::Box& box, int n, Eval eval) {
+
+    n = std::max(n, 0);
+    _box = box;
+    const auto encode = [n, &eval](quantized::Vertex* v) {
+      for(int i = 0; i < n; ++i) v[i] = eval(i);
+    };
+
+    quantized::detail::reserve(_vbo, _capacity, n);
+    if(!quantized::detail::stream(_vbo, n, encode)) {
+      _vertices.resize(size_t(n));
+      encode(_vertices.data());
+      _vbo.bufferSubData(0, size_t(n) * sizeof(quantized::Vertex), _vertices.data());
+    }
+    _no_vertices = GLsizei(n);
+  }
+
+  // Float samples of any PCurve: positions and, with d >= 1, tangents; encoded in the
+  // bounding box of the positions
+  void replot(const GMlib::DVector<GMlib::DVector<GMlib::Vector<float,3>>>& p,
+              int m, int d, bool /*closed*/) override {
+
+    const int n = std::max(m, 0);
+
+    _points.resize(size_t(n));
+    for(int i = 0; i < n; ++i) _points[size_t(i)] = p(i)(0);
+
+    const quantized::Box box = quantized::Box::fromPoints(_points.begin(), _points.end());
+    upload(box, n, [this, &p, &box, d](int i) {
+      return quantized::encode(box, _points[size_t(i)], d >= 1 ? p(i)(1) : quantized::Vec(0.0f, 0.0f, 0.0f));
+    });
+  }
+
+  void render(const GMlib::SceneObject* obj, const GMlib::DefaultRenderer* renderer) const override {
+
+    draw(obj, renderer->getCamera(), _color, true);
+  }
+
+  void renderGeometry(const GMlib::SceneObject* obj, const GMlib::Renderer* renderer, const GMlib::Color& color) const override {
+
+    draw(obj, renderer->getCamera(), color, false);
+  }
+
+private:
+  GMlib::GL::Program              _prog;
+  GMlib::GL::VertexBufferObject   _vbo;
+  GMlib::Color                    _color {GMlib::GMcolor::lightGrey()};
+
+  quantized::Box                  _box;
+  int                             _capacity {0};  // Vertices the VBO has room for
+  GLsizei                         _no_vertices {0};
+
+  // Scratch of replot()
+  std::vector<quantized::Vec>     _points;
+  std::vector<quantized::Vertex>  _vertices;      // Without a stream ring
+
+  void draw(const GMlib::SceneObject* obj, const GMlib::Camera* cam, const GMlib::Color& color, bool shade) const {
+
+    if(_no_vertices < 2) return;
+
+    quantized::detail::render(_prog, _vbo, _box, obj, cam, color, shade, false, [this] {
+      GL_CHECK(::glDrawArrays(GL_LINE_STRIP, 0, _no_vertices));
+    });
+  }
+};
+
+#endif // QUANTIZED_VISUALIZERS_H
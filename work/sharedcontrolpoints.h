@@ -0,0 +1,172 @@
+#ifndef SHARED_CONTROL_POINTS_H
+#define SHARED_CONTROL_POINTS_H
+
+#include <core/containers/gmdvector.h>
+#include <core/types/gmpoint.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*!
+ *  SharedControlPoints<T,n>
+ *
+ *  Reference counted, copy-on-write control point buffer for curves that are built from
+ *  the same data set (a spline, a subdivision curve, a fitted variant, ...).
+ *
+ *  - Copies share the buffer; reads never copy.
+ *  - Writes go through set(), setDim() or assign(); a shared buffer is copied first
+ *    (detached), a buffer owned by one object alone is written in place.
+ *  - Buffers created from a DVector or assign() are interned: a process wide cache, keyed
+ *    by a hash of the coordinates, hands out the live buffer with bitwise identical
+ *    contents, so identical inputs cost one allocation. The cache holds weak references;
+ *    a buffer is freed with its last owner.
+ *  - The first write to an interned buffer removes it from the cache (under the cache
+ *    mutex) before the owner count is checked, so no other thread can pick up a buffer
+ *    that is being written, and no entry is left with a stale key.
+ *  - The reference count is atomic, but an object must not be written while it is read
+ *    from another thread (as for DVector).
+ */
+template <typename T, int n>
+class SharedControlPoints {
+public:
+  using Point  = GMlib::Vector<T,n>;
+  using Buffer = std::vector<Point>;
+
+  SharedControlPoints() : _data(empty()) {}
+
+  explicit SharedControlPoints(const GMlib::DVector<Point>& p) { *this = p; }
+
+  SharedControlPoints& operator=(const GMlib::DVector<Point>& p) {
+
+    Buffer b(static_cast<size_t>(p.getDim()));
+    for(int i = 0; i < p.getDim(); ++i) b[size_t(i)] = p(i);
+    assign(std::move(b));
+    return *this;
+  }
+
+  // Take over b, or share a live buffer with the same contents
+  void assign(Buffer&& b) {
+
+    _key      = hash(b);
+    _data     = intern(std::move(b), _key);
+    _interned = true;
+  }
+
+  int getDim() const { return int(_data->size()); }
+
+  const Point& operator[](int i) const { return (*_data)[size_t(i)]; }
+  const Point& operator()(int i) const { return (*_data)[size_t(i)]; }
+  const Point* getPtr() const { return _data->data(); }
+
+  void set(int i, const Point& p) { detach()[size_t(i)] = p; }
+
+  // Resize; new points are zero
+  void setDim(int size) {
+
+    if(size == getDim()) return;
+    detach().resize(size_t(size), Point(T(0)));
+  }
+
+  GMlib::DVector<Point> toDVector() const {
+
+    GMlib::DVector<Point> p(getDim());
+    for(int i = 0; i < getDim(); ++i) p[i] = (*_data)[size_t(i)];
+    return p;
+  }
+
+  bool isShared() const { return _data.use_count() > 1; }
+  bool sharesWith(const SharedControlPoints& other) const { return _data == other._data; }
+  long useCount() const { return _data.use_count(); }
+
+private:
+  using Cache = std::unordered_multimap<std::uint64_t, std::weak_ptr<Buffer>>;
+
+  std::shared_ptr<Buffer> _data;
+  std::uint64_t           _key {0};           // Cache key of _data while interned
+  bool                    _interned {false};
+
+  // Unique, writable buffer; out of the cache first, after that the count can only drop
+  Buffer& detach() {
+
+    if(_interned) {
+      release(_data, _key);
+      _interned = false;
+    }
+    if(_data.use_count() > 1) _data = std::make_shared<Buffer>(*_data);
+    return *_data;
+  }
+
+  static std::mutex& cacheMutex() { static std::mutex mutex; return mutex; }
+  static Cache&      cache()      { static Cache cache; return cache; }
+
+  static std::shared_ptr<Buffer> empty() { return std::make_shared<Buffer>(); }
+
+  static std::uint64_t hash(const Buffer& b) {
+
+    std::uint64_t h = 1469598103934665603ull;   // FNV-1a over the coordinate bits
+    for(const Point& p : b)
+      for(int k = 0; k < n; ++k) {
+        const T c = p(k);
+        unsigned char bytes[sizeof(T)];
+        std::memcpy(bytes, &c, sizeof(T));
+        for(unsigned char x : bytes) h = (h ^ x) * 1099511628211ull;
+      }
+    return h;
+  }
+
+  static bool equal(const Buffer& a, const Buffer& b) {
+
+    if(a.size() != b.size()) return false;
+    for(size_t i = 0; i < a.size(); ++i)
+      for(int k = 0; k < n; ++k) {
+        const T x = a[i](k), y = b[i](k);
+        if(std::memcmp(&x, &y, sizeof(T)) != 0) return false;
+      }
+    return true;
+  }
+
+  static std::shared_ptr<Buffer> intern(Buffer&& b, std::uint64_t h) {
+
+    static size_t prune_at {64};
+
+    std::lock_guard<std::mutex> lk(cacheMutex());
+    Cache& cache = SharedControlPoints::cache();
+    auto range = cache.equal_range(h);
+    for(auto it = range.first; it != range.second; ++it)
+      if(auto live = it->second.lock())
+        if(equal(*live, b)) return live;
+
+    auto buffer = std::make_shared<Buffer>(std::move(b));
+    cache.emplace(h, buffer);
+
+    // Drop the entries of freed buffers once the cache has doubled
+    if(cache.size() >= prune_at) {
+      for(auto it = cache.begin(); it != cache.end();)
+        it = it->second.expired() ? cache.erase(it) : std::next(it);
+      prune_at = std::max<size_t>(64, 2 * cache.size());
+    }
+    return buffer;
+  }
+
+  // Remove the entry of buffer, keyed h, from the cache
+  static void release(const std::shared_ptr<Buffer>& buffer, std::uint64_t h) {
+
+    std::lock_guard<std::mutex> lk(cacheMutex());
+    Cache& cache = SharedControlPoints::cache();
+    auto range = cache.equal_range(h);
+    for(auto it = range.first; it != range.second; ++it)
+      if(!it->second.owner_before(buffer) && !buffer.owner_before(it->second)) {
+        cache.erase(it);
+        return;
+      }
+  }
+};
+
+#endif // SHARED_CONTROL_POINTS_H
@@ -0,0 +1,220 @@
+#ifndef STREAMING_FITTER_H
+#define STREAMING_FITTER_H
+
+#include "mybspline.h"
+#include "bandedlu.h"
+#include "bsplinebasis.h"
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+/*!
+ *  StreamingFitter
+ *
+ *  Online least squares fitting of a MyB_spline to a stream of points (e.g. a digitizer).
+ *
+ *  - Points are parametrized by accumulated chord length; the knots are uniform with a given
+ *    span length, clamped at the start and open at the end, so appending a span leaves the
+ *    existing basis functions untouched.
+ *  - Only the last window_spans spans are active. Their control points are solved from banded
+ *    normal equations; control points leaving the window are frozen, and their couplings move
+ *    to the right hand side.
+ *  - Recursive least squares with a forgetting factor: M <- lambda M + N N^T, r <- lambda r + N q.
+ *    Old points fade out of the active spans, so the curve follows the latest input.
+ *  - Constant cost per point: each point updates p+1 rows and re-solves the active band. The
+ *    normal equations live in a ring of window_spans + p + 1 rows, allocated once; the fitter's
+ *    memory is fixed by the window. Appending a span adds one control point; the control
+ *    points and the knots grow geometrically, amortized constant per span.
+ *  - The changed parameter interval, the active spans, is handed to MyB_spline::invalidate()
+ *    and reported by the callback. Sampled with a fixed spacing (a sample count growing with
+ *    the domain, sampleCount()), a replot re-evaluates only the active and the new spans.
+ *  - The curve's uniform speed mode is switched off; its arc length table is global.
+ */
+class StreamingFitter {
+public:
+  using SpansChanged = std::function<void(float t0, float t1)>;
+
+  StreamingFitter(MyB_spline* curve, float span_length, int window_spans = 4, double forgetting = 0.98)
+    : _curve(curve), _knots{curve->_degree, double(span_length)},
+      _window(std::max(window_spans, 1)), _lambda(forgetting),
+      _rows(_window + _knots.p + 1),
+      _M(size_t(_rows) * size_t(2 * _knots.p + 1), 0.0),
+      _r(size_t(_rows), GMlib::Vector<double,3>(0.0, 0.0, 0.0)) {}
+
+  void setSpansChanged(SpansChanged callback) { _spans_changed = std::move(callback); }
+
+  int  pointCount() const { return _no_points; }
+  int  spanCount() const { return controlCount() - _knots.p; }
+
+  // Samples over the curve's domain at samples_per_span per span; a fixed spacing
+  int  sampleCount(int samples_per_span) const { return spanCount() * samples_per_span + 1; }
+
+  void addPoint(const GMlib::Vector<float,3>& q) {
+
+    const int p = _knots.p;
+
+    if(_no_points++ == 0) start(q);
+    else                  _u += double((q - _last).getLength());
+    _last = q;
+
+    // Extend the curve until its domain covers the new point
+    while(_u > _knots[controlCount()]) appendSpan();
+
+    // Rank one update of the normal equations of the active control points
+    const int n    = controlCount();
+    const int span = bspline::findSpan(_knots, n, p, _u);
+    double N[bspline::MaxDegree + 1];
+    bspline::basisFuns(_knots, span, p, _u, N);
+
+    for(int i = _base; i < n; ++i) {
+      double* row = this->row(i);
+      for(int k = 0; k <= 2 * p; ++k) row[k] *= _lambda;
+      rhs(i) = rhs(i) * _lambda;
+    }
+
+    const GMlib::Vector<double,3> qd(q(0), q(1), q(2));
+    for(int a = 0; a <= p; ++a) {
+      const int i = span - p + a;
+      rhs(i) += qd * N[a];
+      for(int b = 0; b <= p; ++b) row(i)[b - a + p] += N[a] * N[b];
+    }
+
+    solve();
+
+    // Spans using active control points; span s uses control points s-p, ..., s
+    const auto t0 = float(_knots[std::max(_base, p)]);
+    const auto t1 = float(_knots[n]);
+    _curve->invalidate(t0, t1);
+    if(_spans_changed) _spans_changed(t0, t1);
+  }
+
+private:
+  // Uniform knots, p+1 fold at the start; knot j = max(j - p, 0) * h
+  struct UniformKnots {
+    int     p;
+    double  h;
+    double  operator[](int j) const { return j <= p ? 0.0 : (j - p) * h; }
+  };
+
+  MyB_spline*                          _curve;
+  UniformKnots                         _knots;
+  int                                  _window;
+  double                               _lambda;
+  SpansChanged                         _spans_changed;
+
+  int                                  _no_points {0};
+  double                               _u {0.0};           // Chord length of the latest point
+  GMlib::Vector<float,3>               _last;
+  int                                  _base {0};          // First active control point
+
+  // Normal equations of the active control points, a ring; control point i at row i % _rows,
+  // band offsets -p..p. Rows are zero when they enter the ring.
+  int                                  _rows;
+  std::vector<double>                  _M;
+  std::vector<GMlib::Vector<double,3>> _r;                 // Right hand sides
+
+  BandedLU<double>                     _S;                 // Scratch of solve()
+  std::vector<GMlib::Vector<double,3>> _b;
+
+  int controlCount() const { return _curve->_controlPoints.getDim(); }
+
+  double*                  row(int i) { return _M.data() + size_t(i % _rows) * size_t(2 * _knots.p + 1); }
+  GMlib::Vector<double,3>& rhs(int i) { return _r[size_t(i % _rows)]; }
+
+  void clearRow(int i) {
+
+    std::fill(row(i), row(i) + 2 * _knots.p + 1, 0.0);
+    rhs(i) = GMlib::Vector<double,3>(0.0, 0.0, 0.0);
+  }
+
+  // Knots [0, size) valid; the knot vector grows by doubling, and is written whole then
+  // (setDim may reallocate), amortized constant per span
+  void reserveKnots(int size, bool rewrite = false) {
+
+    GMlib::DVector<float>& knots = _curve->_knotVector;
+    if(size <= knots.getDim() && !rewrite) return;
+
+    const int capacity = std::max(size, 2 * knots.getDim());
+    knots.setDim(capacity);
+    for(int j = 0; j < capacity; ++j) knots[j] = float(_knots[j]);
+  }
+
+  // First point; one span, all control points at q
+  void start(const GMlib::Vector<float,3>& q) {
+
+    const int p = _knots.p;
+
+    _u = 0.0;
+    _base = 0;
+    _curve->setUniformSpeed(false);
+    _curve->_controlPoints.setDim(p + 1);
+    for(int i = 0; i <= p; ++i) _curve->_controlPoints.set(i, q);
+    reserveKnots(2 * p + 2, true);
+
+    std::fill(_M.begin(), _M.end(), 0.0);
+    std::fill(_r.begin(), _r.end(), GMlib::Vector<double,3>(0.0, 0.0, 0.0));
+  }
+
+  // One more span and control point (a copy of the last one); slides the window if full
+  void appendSpan() {
+
+    const int n = controlCount();
+    _curve->_controlPoints.setDim(n + 1);   // In place unless shared; the buffer grows geometrically
+    _curve->_controlPoints.set(n, _curve->_controlPoints[n - 1]);
+    reserveKnots(n + 1 + _knots.p + 1);
+
+    if(n + 1 - _base > _window + _knots.p) freezeFirst();
+  }
+
+  // Freeze the first active control point; its couplings move to the right hand side
+  void freezeFirst() {
+
+    const int p = _knots.p;
+    const int n = controlCount();
+    const auto& cf = _curve->_controlPoints[_base];
+    const GMlib::Vector<double,3> c(cf(0), cf(1), cf(2));
+
+    for(int k = 1; k <= p && _base + k < n; ++k) {
+      double& m = row(_base + k)[-k + p];   // Row base+k, column base
+      rhs(_base + k) -= c * m;
+      m = 0.0;
+    }
+
+    clearRow(_base);
+    ++_base;
+  }
+
+  // Solve the active band; damped towards the current control points where data is missing
+  void solve() {
+
+    const int p = _knots.p;
+    const int a = controlCount() - _base;
+
+    double trace = 0.0;
+    for(int i = 0; i < a; ++i) trace += row(_base + i)[p];
+    const double mu = 1e-6 * trace / a + 1e-12;
+
+    _S.resize(a, p, p);
+    _b.resize(size_t(a));
+    for(int i = 0; i < a; ++i) {
+
+      const double* m = row(_base + i);
+      for(int j = std::max(0, i - p); j <= std::min(a - 1, i + p); ++j)
+        _S(i, j) = m[j - i + p];
+      _S(i, i) += mu;
+
+      const auto& ci = _curve->_controlPoints[_base + i];
+      _b[size_t(i)] = rhs(_base + i) + GMlib::Vector<double,3>(ci(0), ci(1), ci(2)) * mu;
+    }
+
+    if(!_S.factorize()) return;
+    _S.solve(_b.data());
+
+    for(int i = 0; i < a; ++i)
+      _curve->_controlPoints.set(_base + i,
+          GMlib::Vector<float,3>(float(_b[size_t(i)](0)), float(_b[size_t(i)](1)), float(_b[size_t(i)](2))));
+  }
+};
+
+#endif // STREAMING_FITTER_H
@@ -0,0 +1,194 @@
+#ifndef STREAM_RING_H
+#define STREAM_RING_H
+
+// gmlib
+#include <opengl/gmopengl.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/*!
+ *  StreamRing
+ *
+ *  Upload ring for streaming vertex data; producers write straight into GPU visible memory
+ *  from any thread, the render thread only issues copies into the destination buffers.
+ *
+ *  - One buffer of frames x frame_bytes, created with glBufferStorage and mapped once,
+ *    persistent and coherent (GL 4.4 or ARB_buffer_storage). Without it the ring is plain
+ *    memory and copy() is a glBufferSubData from it; same interface, one driver copy.
+ *  - Each frame allocates from its own region: allocate() is a lock free bump of one atomic
+ *    cursor (frame number, offset); it returns an empty allocation when the region is full,
+ *    and the producer falls back or retries next frame. Nothing is allocated per frame.
+ *  - A producer writes, then calls commit(); the allocation must be consumed (copy()) in
+ *    the frame it was made in or the next one, afterwards copy() refuses it as stale.
+ *  - endFrame(), on the render thread after the frame's commands, fences the frame and
+ *    moves on to the next region; before a region is reused its fence is waited for (the
+ *    GPU runs at most frames - 2 frames behind) and so are its uncommitted writers.
+ *  - shared() is the ring of the application's context, created by initShared() and
+ *    deleted by releaseShared(), both with the context current; nullptr without one.
+ *  - Producers in this tree: CurvatureCombVisualizer, ControlNetSelector and the quantized
+ *    visualizers (every replot of the curves and surfaces drawn with them). GMlib's own
+ *    visualizers upload by themselves and do not go through the ring.
+ */
+class StreamRing {
+public:
+  struct Allocation {
+    void*          data {nullptr};
+    std::size_t    offset {0};      // In the ring buffer
+    std::size_t    size {0};
+    std::uint32_t  frame {0};
+
+    explicit operator bool() const { return data != nullptr; }
+  };
+
+  StreamRing(std::size_t frame_bytes, int frames = 4)
+    : _frames(frames < 3 ? 3 : frames), _frame_bytes(frame_bytes),
+      _fences(std::size_t(_frames), nullptr), _writers(new std::atomic<int>[std::size_t(_frames)]) {
+
+    for(int r = 0; r < _frames; ++r) _writers[r] = 0;
+
+    const std::size_t bytes = _frame_bytes * std::size_t(_frames);
+    if(GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) {
+      const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+      GL_CHECK(::glGenBuffers(1, &_buffer));
+      GL_CHECK(::glBindBuffer(GL_COPY_READ_BUFFER, _buffer));
+      GL_CHECK(::glBufferStorage(GL_COPY_READ_BUFFER, GLsizeiptr(bytes), nullptr, flags));
+      _memory = static_cast<char*>(::glMapBufferRange(GL_COPY_READ_BUFFER, 0, GLsizeiptr(bytes), flags));
+      GL_CHECK(::glBindBuffer(GL_COPY_READ_BUFFER, 0));
+      if(!_memory) {
+        GL_CHECK(::glDeleteBuffers(1, &_buffer));
+        _buffer = 0;
+      }
+    }
+    if(!_memory) {
+      _staging.resize(bytes);
+      _memory = _staging.data();
+    }
+  }
+
+  ~StreamRing() {
+
+    for(GLsync& f : _fences)
+      if(f) ::glDeleteSync(f);
+    if(_buffer) {
+      GL_CHECK(::glBindBuffer(GL_COPY_READ_BUFFER, _buffer));
+      ::glUnmapBuffer(GL_COPY_READ_BUFFER);
+      GL_CHECK(::glBindBuffer(GL_COPY_READ_BUFFER, 0));
+      GL_CHECK(::glDeleteBuffers(1, &_buffer));
+    }
+  }
+
+  StreamRing(const StreamRing&) = delete;
+  StreamRing& operator=(const StreamRing&) = delete;
+
+  static StreamRing* shared() { return sharedRing().get(); }
+  static void initShared(std::size_t frame_bytes, int frames = 4) { sharedRing().reset(new StreamRing(frame_bytes, frames)); }
+  static void releaseShared() { sharedRing().reset(); }
+
+  bool isPersistent() const { return _buffer != 0; }
+  std::size_t frameBytes() const { return _frame_bytes; }
+
+  // Any thread; bytes in the current frame's region, or an empty allocation
+  Allocation allocate(std::size_t bytes, std::size_t alignment = 16) {
+
+    std::uint64_t c = _cursor.load(std::memory_order_acquire);
+    for(;;) {
+      const std::uint32_t frame  = std::uint32_t(c >> 32);
+      const int           region = int(frame % std::uint32_t(_frames));
+      const std::size_t   offset = (std::size_t(c & 0xffffffffu) + alignment - 1) / alignment * alignment;
+      if(offset + bytes > _frame_bytes) return Allocation();
+
+      _writers[region].fetch_add(1, std::memory_order_acq_rel);
+      const std::uint64_t next = (std::uint64_t(frame) << 32) | std::uint64_t(offset + bytes);
+      if(_cursor.compare_exchange_weak(c, next, std::memory_order_acq_rel)) {
+        Allocation a;
+        a.offset = std::size_t(region) * _frame_bytes + offset;
+        a.data   = _memory + a.offset;
+        a.size   = bytes;
+        a.frame  = frame;
+        return a;
+      }
+      _writers[region].fetch_sub(1, std::memory_order_acq_rel);   // c was reloaded; retry
+    }
+  }
+
+  // The producer is done writing a
+  void commit(const Allocation& a) {
+
+    if(a) _writers[a.frame % std::uint32_t(_frames)].fetch_sub(1, std::memory_order_release);
+  }
+
+  // Render thread; copy a into dst at dst_offset. False if a is stale (older than the last frame)
+  bool copy(const Allocation& a, GLuint dst, std::size_t dst_offset) {
+
+    if(!a || frame() - a.frame > 1) return false;
+
+    if(_buffer) {
+      GL_CHECK(::glBindBuffer(GL_COPY_READ_BUFFER, _buffer));
+      GL_CHECK(::glBindBuffer(GL_COPY_WRITE_BUFFER, dst));
+      GL_CHECK(::glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                                     GLintptr(a.offset), GLintptr(dst_offset), GLsizeiptr(a.size)));
+      GL_CHECK(::glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+      GL_CHECK(::glBindBuffer(GL_COPY_READ_BUFFER, 0));
+    }
+    else {
+      GL_CHECK(::glBindBuffer(GL_COPY_WRITE_BUFFER, dst));
+      GL_CHECK(::glBufferSubData(GL_COPY_WRITE_BUFFER, GLintptr(dst_offset), GLsizeiptr(a.size), a.data));
+      GL_CHECK(::glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+    }
+    return true;
+  }
+
+  // Render thread, after the frame's commands
+  void endFrame() {
+
+    const std::uint32_t f = frame();
+    const int           r = int(f % std::uint32_t(_frames));
+
+    if(_buffer) {
+      if(_fences[std::size_t(r)]) ::glDeleteSync(_fences[std::size_t(r)]);
+      _fences[std::size_t(r)] = ::glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    // The next region was last allocated from frames - 1 frames ago and consumed by the frame
+    // after that; wait for that frame's fence and for the region's writers
+    const std::uint32_t next = f + 1;
+    const int           n    = int(next % std::uint32_t(_frames));
+    const int           last = int((next + 1) % std::uint32_t(_frames));
+    if(_buffer && next >= std::uint32_t(_frames) - 1) wait(_fences[std::size_t(last)]);
+    while(_writers[n].load(std::memory_order_acquire) > 0) std::this_thread::yield();
+
+    _cursor.store(std::uint64_t(next) << 32, std::memory_order_release);
+  }
+
+private:
+  const int                          _frames;
+  const std::size_t                  _frame_bytes;
+  GLuint                             _buffer {0};
+  char*                              _memory {nullptr};
+  std::vector<char>                  _staging;          // Without buffer storage
+  std::vector<GLsync>                _fences;           // Per region; the frame that used it last
+  std::unique_ptr<std::atomic<int>[]> _writers;          // Uncommitted allocations per region
+  std::atomic<std::uint64_t>         _cursor {0};       // frame << 32 | offset in the frame's region
+
+  std::uint32_t frame() const { return std::uint32_t(_cursor.load(std::memory_order_acquire) >> 32); }
+
+  static void wait(GLsync fence) {
+
+    if(!fence) return;
+    GLbitfield flags = 0;
+    while(::glClientWaitSync(fence, flags, 1000000) == GL_TIMEOUT_EXPIRED)
+      flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+  }
+
+  static std::unique_ptr<StreamRing>& sharedRing() {
+    static std::unique_ptr<StreamRing> ring;
+    return ring;
+  }
+};
+
+#endif // STREAM_RING_H
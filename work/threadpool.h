@@ -0,0 +1,118 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*!
+ *  ThreadPool
+ *
+ *  Persistent worker threads for background work (tessellation and the like), so no
+ *  thread is created per job.
+ *
+ *  - enqueue(task) runs task on a worker, fire and forget.
+ *  - run(count, f) calls f(i) for i in [0, count) on the workers and the calling thread
+ *    and returns when all are done. The caller takes items itself, so run() may be called
+ *    from a task, even with every worker busy.
+ *  - shared() is a pool with one worker per hardware thread, created on first use; the
+ *    destructor finishes the queued tasks.
+ */
+class ThreadPool {
+public:
+  explicit ThreadPool(int threads = 0) {
+
+    const int n = threads > 0 ? threads : std::max(int(std::thread::hardware_concurrency()), 1);
+    for(int i = 0; i < n; ++i) _workers.emplace_back([this] { work(); });
+  }
+
+  ~ThreadPool() {
+
+    {
+      std::lock_guard<std::mutex> lk(_mutex);
+      _stop = true;
+    }
+    _cv.notify_all();
+    for(auto& w : _workers) w.join();
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  static ThreadPool& shared() {
+    static ThreadPool pool;
+    return pool;
+  }
+
+  int size() const { return int(_workers.size()); }
+
+  void enqueue(std::function<void()> task) {
+
+    {
+      std::lock_guard<std::mutex> lk(_mutex);
+      _tasks.push_back(std::move(task));
+    }
+    _cv.notify_one();
+  }
+
+  template <typename F>
+  void run(int count, F f) {
+
+    if(count <= 0) return;
+
+    struct Batch {
+      std::atomic<int>        next {0};
+      std::atomic<int>        done {0};
+      std::mutex              mutex;
+      std::condition_variable cv;
+    };
+    auto batch = std::make_shared<Batch>();
+
+    auto take = [batch, count, f] {
+      for(int i; (i = batch->next++) < count; ) {
+        f(i);
+        if(++batch->done == count) {
+          std::lock_guard<std::mutex> lk(batch->mutex);
+          batch->cv.notify_all();
+        }
+      }
+    };
+
+    const int helpers = std::min(count - 1, size());
+    for(int h = 0; h < helpers; ++h) enqueue(take);
+    take();
+
+    std::unique_lock<std::mutex> lk(batch->mutex);
+    batch->cv.wait(lk, [&] { return batch->done.load() == count; });
+  }
+
+private:
+  std::vector<std::thread>            _workers;
+  std::deque<std::function<void()>>   _tasks;
+  std::mutex                          _mutex;
+  std::condition_variable             _cv;
+  bool                                _stop {false};
+
+  void work() {
+
+    for(;;) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lk(_mutex);
+        _cv.wait(lk, [this] { return _stop || !_tasks.empty(); });
+        if(_tasks.empty()) return;   // Stopped and drained
+        task = std::move(_tasks.front());
+        _tasks.pop_front();
+      }
+      task();
+    }
+  }
+};
+
+#endif // THREAD_POOL_H
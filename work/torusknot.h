@@ -4,6 +4,8 @@
 #include <parametrics/gmpcurve.h>
 #include <cmath>
 
+#include "arclength.h"
+
 // TorusKnot class definition inheriting from GMlib::PCurve
 class TorusKnot : public GMlib::PCurve<float,3> {
     GM_SCENEOBJECT(TorusKnot)
@@ -12,15 +14,48 @@ class TorusKnot : public GMlib::PCurve<float,3> {
     // Default constructor (no parameters needed)
     TorusKnot() {}
 
+    /*!
+     *  setUniformSpeed(state):
+     *  - Reparametrizes the knot by (normalized) arc length, keeping the domain [0, 6π].
+     *  - Sampling then spaces vertices equally along the knot, instead of bunching
+     *    them on the outer loops; the same fidelity needs fewer samples.
+     */
+    void setUniformSpeed(bool state) {
+
+      _uniform_speed = state;
+      if(_uniform_speed && !_arc_length.isValid())
+        _arc_length.build( [this](float t) { return speed(t); }, getStartP(), getEndP(), 6 * 8 );
+    }
+
+    bool isUniformSpeed() const { return _uniform_speed; }
+
   protected:
     /*!
      *  eval(t, d, left):
      *  - Evaluates the torus knot at parameter `t`.
-     *  - Computes position, first derivative, and second derivative.
-     *  - Uses exact mathematical derivatives (no numerical approximation).
+     *  - In uniform speed mode t is (scaled) arc length; mapped to the knot
+     *    parameter and the derivatives converted by the chain rule.
      */
     void eval(float t, int d, bool /*left*/ = true) const override {
 
+      if(!_uniform_speed) {
+        evalKnot(t, d);
+        return;
+      }
+
+      const float domain = getEndP() - getStartP();
+      evalKnot( _arc_length.parameter( (t - getStartP()) / domain * _arc_length.length() ), d );
+      ArcLength<float>::toUniformSpeed<3>( this->_p, _arc_length.length() / domain, std::min(d, 3) );
+    }
+
+    /*!
+     *  evalKnot(t, d):
+     *  - Evaluates the torus knot at parameter `t`.
+     *  - Computes position and the first, second and third derivatives.
+     *  - Uses exact mathematical derivatives (no numerical approximation).
+     */
+    void evalKnot(float t, int d) const {
+
       // Ensure _p has room for up to d derivatives (0 => just position)
       this->_p.setDim(d + 1);
 
@@ -81,6 +116,24 @@ class TorusKnot : public GMlib::PCurve<float,3> {
         // Assign the calculated values to the _p array
         this->_p[2] = {xpp, ypp, zpp};
       }
+
+      // 4. Compute the Third Derivative, if requested (torsion, curvature combs)
+      if(d > 2) {
+        // x = r(t) cos(pt), y = r(t) sin(pt) with r(t) = R + cos(qt); by the Leibniz rule
+        // (r f)''' = r''' f + 3 r'' f' + 3 r' f'' + r f'''
+        float r  = R + std::cos(q * t);
+        float r1 = -q * std::sin(q * t);
+        float r2 = -q * q * std::cos(q * t);
+        float r3 =  q * q * q * std::sin(q * t);
+        float c  = std::cos(p * t);
+        float s  = std::sin(p * t);
+
+        float xppp = r3 * c - 3 * r2 * p * s - 3 * r1 * p * p * c + r * p * p * p * s;
+        float yppp = r3 * s + 3 * r2 * p * c - 3 * r1 * p * p * s - r * p * p * p * c;
+        float zppp = -q * q * q * std::cos(q * t);
+
+        this->_p[3] = {xppp, yppp, zppp};
+      }
     }
 
     /*!
@@ -108,6 +161,23 @@ class TorusKnot : public GMlib::PCurve<float,3> {
     bool isClosed() const override {
       return true;
     }
+
+  private:
+    bool              _uniform_speed {false};
+    ArcLength<float>  _arc_length;
+
+    // |c'(t)|; the analytic speed, used by the arc length quadrature
+    float speed(float t) const {
+
+      const float R = 2.0f;
+      const int   p = 2;
+      const int   q = 3;
+
+      const float r  = R + std::cos(q * t);
+      const float dr = -q * std::sin(q * t);
+      const float dz =  q * std::cos(q * t);
+      return std::sqrt( dr * dr + p * p * r * r + dz * dz );
+    }
 };
 
 #endif // TORUS_KNOT_H